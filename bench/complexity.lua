@@ -0,0 +1,272 @@
+--
+-- worst-case complexity suite of the parser and the codec
+--
+-- usage: lua bench/complexity.lua [options]
+--
+--   -f <pattern>   run the cases whose name matches the lua pattern
+--   -s <bytes>     largest input size (default: 262144)
+--   -t <seconds>   minimum duration of each measurement (default: 0.02)
+--
+-- every case generates an adversarial input at 4 sizes that grow by 4x, and
+-- measures the time and the allocated bytes per call. the growth exponent
+-- is estimated from the second and the largest sizes (1.0 is linear, 2.0 is
+-- quadratic), and the suite exits with the status 1 if any exponent exceeds
+-- the limit. the smallest size warms up the caches and the reusable buffers.
+--
+-- the url module must be installed (e.g. luarocks make) before running.
+--
+local clock = os.clock
+local format = string.format
+local rep = string.rep
+local log = math.log
+
+local url = require('url')
+
+-- limits of the growth exponent. the time limit leaves room for the timer
+-- noise and the cache effects of the larger inputs.
+local MAX_TIME_EXP = 1.5
+local MAX_ALLOC_EXP = 1.15
+-- the allocations below this size per call are treated as constant
+local MIN_ALLOC = 4096
+
+--- parse_args
+--- @return table opts
+local function parse_args()
+    local opts = {
+        size = 256 * 1024,
+        duration = 0.02,
+    }
+    local i = 1
+    while arg and arg[i] do
+        local opt, val = arg[i], arg[i + 1]
+        if opt == '-f' then
+            opts.filter = val
+        elseif opt == '-s' then
+            opts.size = assert(tonumber(val), 'invalid size')
+        elseif opt == '-t' then
+            opts.duration = assert(tonumber(val), 'invalid duration')
+        else
+            error(format('unknown option %q', opt))
+        end
+        i = i + 2
+    end
+    return opts
+end
+
+--- fill repeats the pattern to the size
+--- @param pattern string
+--- @param size integer
+--- @return string
+local function fill(pattern, size)
+    return rep(pattern, math.ceil(size / #pattern)):sub(1, size)
+end
+
+-- list of cases: { name, gen, fn }
+local CASES = {}
+
+--- add a case
+--- @param name string
+--- @param gen function generates the input of the size
+--- @param fn function called with the input
+local function add(name, gen, fn)
+    CASES[#CASES + 1] = {
+        name = name,
+        gen = gen,
+        fn = fn,
+    }
+end
+
+-- runs of '%' and '&'
+add('decode/percent_run', function(n)
+    return fill('%', n)
+end, url.decode)
+add('decode/escaped', function(n)
+    return fill('%41', n)
+end, url.decode)
+add('decode/truncated_tail', function(n)
+    return fill('a', n - 2) .. '%4'
+end, url.decode)
+add('parse/amp_run', function(n)
+    return '?' .. fill('&', n)
+end, function(s)
+    return url.parse(s, true)
+end)
+add('parse/same_key', function(n)
+    return fill('a&', n)
+end, function(s)
+    return url.parse(s, true, 0, true)
+end)
+add('parse/distinct_keys', function(n)
+    local t = {}
+    for i = 1, n / 8 do
+        t[i] = format('k%06x', i)
+    end
+    return table.concat(t, '&')
+end, function(s)
+    return url.parse(s, true, 0, true)
+end)
+add('parse/limits', function(n)
+    return fill('a&', n)
+end, function(s)
+    return url.parse(s, {
+        max_values = 16,
+    }, 0, true)
+end)
+
+-- repeated '@' and ':' in the authority (CHECK_USERINFO / PARSE_PASSWORD)
+add('parse/userinfo_colons', function(n)
+    return 'http://' .. fill('a:', n) .. '@host/'
+end, url.parse)
+add('parse/password', function(n)
+    return 'http://user:' .. fill('p', n) .. '@host/'
+end, url.parse)
+add('parse/at_run', function(n)
+    return 'http://' .. fill('a@', n)
+end, url.parse)
+add('parse/colon_run', function(n)
+    return 'http://' .. fill(':', n)
+end, url.parse)
+add('authority/userinfo_colons', function(n)
+    return 'http://' .. fill('a:', n) .. '@host/'
+end, url.authority)
+
+-- IPv6 "::" patterns
+add('parse/ipv6_colons', function(n)
+    return 'http://[' .. fill('::', n) .. ']/'
+end, url.parse)
+add('parse/ipv6_groups', function(n)
+    return 'http://[' .. fill('ffff:', n) .. ':1]/'
+end, url.parse)
+
+-- surrogate-heavy "%u" sequences
+add('decode/surrogate_pairs', function(n)
+    return fill('%uD83D%uDE00', n)
+end, url.decode)
+add('decode/lone_surrogates', function(n)
+    return fill('%uD83D', n)
+end, url.decode)
+add('decode/surrogate_pairs+strict', function(n)
+    return fill('%uD83D%uDE00', n)
+end, function(s)
+    return url.decode(s, true)
+end)
+
+-- other entry points that scan the whole input
+add('encode3986/binary', function(n)
+    return fill('\255', n)
+end, url.encode3986)
+add('split_path/slash_run', function(n)
+    return fill('/', n)
+end, url.split_path)
+add('host_to_ascii/labels', function(n)
+    return fill('b\195\188cher.', n)
+end, url.host_to_ascii)
+add('query_edit/same_key', function(n)
+    return '/?' .. fill('a&', n)
+end, function(s)
+    return url.query_edit(s, {
+        a = 1,
+    })
+end)
+add('decode_data/base64_spaces', function(n)
+    return 'data:;base64,' .. fill('QQ ', n)
+end, url.decode_data)
+add('decode_data/params', function(n)
+    return 'data:text/plain' .. fill(';a=b', n) .. ','
+end, url.decode_data)
+add('cache_key/distinct_keys', function(n)
+    local t = {}
+    for i = 1, n / 8 do
+        t[i] = format('k%06x', (i * 7919) % 0x1000000)
+    end
+    return '/?' .. table.concat(t, '&')
+end, url.cache_key)
+
+--- measure returns the seconds and the allocated bytes per call
+--- @param fn function
+--- @param s string
+--- @param duration number
+--- @return number sec
+--- @return number bytes
+local function measure(fn, s, duration)
+    -- the best of 3 runs
+    local best = math.huge
+    for _ = 1, 3 do
+        local n = 0
+        collectgarbage('collect')
+        local t = clock()
+        repeat
+            fn(s)
+            n = n + 1
+        until clock() - t >= duration
+        local sec = (clock() - t) / n
+        if sec < best then
+            best = sec
+        end
+    end
+
+    -- allocated bytes of a single call while the garbage collector is
+    -- stopped. it is measured after the warm-up so that the growth of the
+    -- reusable buffers is not counted.
+    collectgarbage('collect')
+    collectgarbage('stop')
+    local mem = collectgarbage('count')
+    fn(s)
+    mem = (collectgarbage('count') - mem) * 1024
+    collectgarbage('restart')
+    return best, mem
+end
+
+--- exponent returns the growth exponent between the two measurements
+--- @param v1 number
+--- @param v2 number
+--- @param n1 integer
+--- @param n2 integer
+--- @return number
+local function exponent(v1, v2, n1, n2)
+    if v1 <= 0 or v2 <= 0 then
+        return 0
+    end
+    return log(v2 / v1) / log(n2 / n1)
+end
+
+local opts = parse_args()
+local sizes = {}
+for i = 4, 1, -1 do
+    sizes[i] = math.floor(opts.size / 4 ^ (4 - i))
+end
+local nfail = 0
+
+print(format('%-32s %10s %12s %8s %12s %8s', 'name', 'bytes', 'ns/byte',
+             'time^', 'alloc/byte', 'alloc^'))
+for _, c in ipairs(CASES) do
+    if not opts.filter or c.name:find(opts.filter) then
+        local ns, alloc = {}, {}
+        for i, n in ipairs(sizes) do
+            local sec, mem = measure(c.fn, c.gen(n), opts.duration)
+            ns[i] = sec * 1e9
+            alloc[i] = mem
+        end
+
+        local n1, n2 = sizes[2], sizes[4]
+        local texp = exponent(ns[2], ns[4], n1, n2)
+        local aexp = 0
+        if alloc[4] >= MIN_ALLOC then
+            aexp = exponent(math.max(alloc[2], 1), alloc[4], n1, n2)
+        end
+        local fail = texp > MAX_TIME_EXP or aexp > MAX_ALLOC_EXP
+        if fail then
+            nfail = nfail + 1
+        end
+        print(format('%-32s %10d %12.2f %8.2f %12.2f %8.2f%s', c.name, n2,
+                     ns[4] / n2, texp, alloc[4] / n2, aexp,
+                     fail and '  FAIL' or ''))
+    end
+end
+
+if nfail > 0 then
+    print(format('%d cases exceed the limits (time^ <= %.2f, alloc^ <= %.2f)',
+                 nfail, MAX_TIME_EXP, MAX_ALLOC_EXP))
+    os.exit(1)
+end
+print('all cases scale linearly')
@@ -0,0 +1,657 @@
+--
+-- benchmark suite of the url module
+--
+-- usage: lua bench/run.lua [options]
+--
+--   -o <file>      write the results to the JSON file
+--                  (default: bench/result.json)
+--   -c <file>      compare the results with the previous JSON file
+--   -f <pattern>   run the benchmarks whose name matches the lua pattern
+--   -t <seconds>   target duration of each benchmark (default: 0.2)
+--
+-- the url module must be installed (e.g. luarocks make) before running.
+--
+local clock = os.clock
+local concat = table.concat
+local format = string.format
+local sort = table.sort
+
+local DIR = arg and arg[0] and arg[0]:match('^(.*)[/\\]') or '.'
+local CORPUS = dofile(DIR .. '/corpus.lua')
+local url = require('url')
+
+--- parse_args
+--- @return table opts
+local function parse_args()
+    local opts = {
+        output = DIR .. '/result.json',
+        duration = 0.2,
+    }
+    local i = 1
+    while arg and arg[i] do
+        local opt, val = arg[i], arg[i + 1]
+        if opt == '-o' then
+            opts.output = val
+        elseif opt == '-c' then
+            opts.compare = val
+        elseif opt == '-f' then
+            opts.filter = val
+        elseif opt == '-t' then
+            opts.duration = assert(tonumber(val), 'invalid duration')
+        else
+            error(format('unknown option %q', opt))
+        end
+        i = i + 2
+    end
+    return opts
+end
+
+-- list of benchmarks: { name, export, input, func }
+local BENCHMARKS = {}
+
+--- add a benchmark of the url export
+--- @param export string
+--- @param name string
+--- @param input string
+--- @param fn function
+local function add(export, name, input, fn)
+    BENCHMARKS[#BENCHMARKS + 1] = {
+        name = export .. '/' .. name,
+        export = export,
+        input = input,
+        fn = fn,
+    }
+end
+
+-- encoders
+for _, export in ipairs({
+    'encode_uri',
+    'encode_form',
+    'encode2396',
+    'encode3986',
+}) do
+    local encode = url[export]
+    for _, name in ipairs({
+        'short_url',
+        'long_url',
+        'plain_64k',
+        'utf8_64k',
+        'binary_64k',
+    }) do
+        local s = CORPUS[name]
+        add(export, name, s, function()
+            return encode(s)
+        end)
+        add(export, name .. '+preserve', s, function()
+            return encode(s, true)
+        end)
+    end
+end
+
+-- decoders
+for _, export in ipairs({
+    'decode_uri',
+    'decode_form',
+    'decode',
+}) do
+    local decode = url[export]
+    for _, name in ipairs({
+        'long_url',
+        'plain_64k',
+        'escaped_64k',
+        'unicode_64k',
+        'form_4m',
+    }) do
+        local s = CORPUS[name]
+        add(export, name, s, function()
+            return assert(decode(s))
+        end)
+        add(export, name .. '+strict', s, function()
+            return assert(decode(s, true))
+        end)
+        add(export, name .. '+lenient', s, function()
+            return assert(decode(s, false, true))
+        end)
+    end
+end
+
+-- data URL
+do
+    local decode_data = url.decode_data
+    for _, name in ipairs({
+        'data_base64_64k',
+        'data_escaped_64k',
+    }) do
+        local s = CORPUS[name]
+        add('decode_data', name, s, function()
+            return assert(decode_data(s))
+        end)
+    end
+end
+
+-- IDNA
+do
+    local host_to_ascii = url.host_to_ascii
+    local host_to_unicode = url.host_to_unicode
+    local idn, puny = CORPUS.idn_host, CORPUS.puny_host
+    add('host_to_ascii', 'idn_host', idn, function()
+        return assert(host_to_ascii(idn))
+    end)
+    add('host_to_unicode', 'puny_host', puny, function()
+        return assert(host_to_unicode(puny))
+    end)
+end
+
+-- parser
+do
+    local parse = url.parse
+    -- the limits that are not exceeded by the corpus
+    local limits = {
+        max_params = 1e6,
+        max_key_len = 1024,
+        max_value_len = 64 * 1024,
+        max_values = 1e6,
+        max_bytes = 64 * 1024 * 1024,
+    }
+    for _, name in ipairs({
+        'short_url',
+        'long_url',
+        'ipv4_url',
+        'ipv6_url',
+        'rest_path',
+    }) do
+        local s = CORPUS[name]
+        add('parse', name, s, function()
+            return parse(s)
+        end)
+        add('parse', name .. '+params', s, function()
+            return parse(s, true)
+        end)
+    end
+    for _, name in ipairs({
+        'query_1',
+        'query_10',
+        'query_100',
+        'query_1k',
+        'query_10k',
+        'form_4m',
+    }) do
+        local s = CORPUS[name]
+        add('parse', name, s, function()
+            return parse(s, false, 0, true)
+        end)
+        add('parse', name .. '+params', s, function()
+            return parse(s, true, 0, true)
+        end)
+        add('parse', name .. '+limits', s, function()
+            return parse(s, limits, 0, true)
+        end)
+    end
+end
+
+-- authority
+do
+    local authority = url.authority
+    for _, name in ipairs({
+        'short_url',
+        'long_url',
+        'ipv6_url',
+    }) do
+        local s = CORPUS[name]
+        add('authority', name, s, function()
+            return authority(s)
+        end)
+    end
+end
+
+-- request-target
+do
+    local parse_target = url.parse_target
+    for _, name in ipairs({
+        'origin_line',
+        'absolute_line',
+        'connect_line',
+    }) do
+        local s = CORPUS[name]
+        add('parse_target', name, s, function()
+            return parse_target(s)
+        end)
+    end
+    local s = CORPUS.origin_line
+    add('parse_target', 'origin_line+host', s, function()
+        return parse_target(s, 0, 'www.example.com:8080', 'https')
+    end)
+end
+
+-- path splitter
+do
+    local split_path = url.split_path
+    local segs = {}
+    for _, name in ipairs({
+        'short_url',
+        'long_url',
+        'rest_path',
+        'route_path',
+    }) do
+        local s = CORPUS[name]
+        add('split_path', name, s, function()
+            return split_path(s)
+        end)
+        add('split_path', name .. '+decode', s, function()
+            return assert(split_path(s, true, true))
+        end)
+        add('split_path', name .. '+reuse', s, function()
+            return assert(split_path(s, true, true, segs))
+        end)
+    end
+end
+
+-- cache key
+do
+    local cache_key = url.cache_key
+    local opts = {
+        deny = {
+            'utm_*',
+            'sid',
+        },
+    }
+    local hash = {
+        deny = opts.deny,
+        hash = true,
+    }
+    for _, name in ipairs({
+        'short_url',
+        'long_url',
+    }) do
+        local s = CORPUS[name]
+        add('cache_key', name, s, function()
+            return assert(cache_key(s))
+        end)
+        add('cache_key', name .. '+deny', s, function()
+            return assert(cache_key(s, opts))
+        end)
+        add('cache_key', name .. '+hash', s, function()
+            return assert(cache_key(s, hash))
+        end)
+    end
+end
+
+-- seen set
+do
+    local seen_set = url.seen_set
+    for _, name in ipairs({
+        'short_url',
+        'long_url',
+    }) do
+        local s = CORPUS[name]
+        local set = seen_set()
+        set:add(s)
+        add('seen_set', name .. '+seen', s, function()
+            return set:add(s)
+        end)
+    end
+    -- 1000 distinct urls are added to the new set
+    local urls = {}
+    for i = 1, 1000 do
+        urls[i] = 'https://www.example.com/items/' .. i .. '?ref=' .. i % 97
+    end
+    add('seen_set', 'batch_1k', table.concat(urls), function()
+        return seen_set(#urls):add_batch(urls)
+    end)
+end
+
+-- public suffix list
+do
+    -- the wildcard and exception rules are looked up in the same way as the
+    -- other rules, so that the host names of each form are measured
+    local pathname = os.tmpname()
+    local f = assert(io.open(pathname, 'w'))
+    for _, rule in ipairs({
+        'com',
+        'jp',
+        'co.jp',
+        '*.kobe.jp',
+        '!city.kobe.jp',
+        'uk',
+        'co.uk',
+        'github.io',
+    }) do
+        f:write(rule, '\n')
+    end
+    -- filler rules to make the table as large as the real list
+    for i = 1, 10000 do
+        f:write('r', i, '.example\n')
+    end
+    f:close()
+    local psl = assert(url.psl_load(pathname))
+    os.remove(pathname)
+    for name, host in pairs({
+        short_host = 'www.example.com',
+        long_host = 'a.b.c.d.e.f.www.example.co.uk',
+        wildcard_host = 'www.example.foo.kobe.jp',
+    }) do
+        add('psl_load', name, host, function()
+            return psl:registrable_domain(host)
+        end)
+    end
+end
+
+-- query editor
+do
+    local query_edit = url.query_edit
+    local edits = {
+        page = 2,
+        utm_source = false,
+        sort = 'name asc',
+    }
+    for _, name in ipairs({
+        'short_url',
+        'long_url',
+    }) do
+        local s = CORPUS[name]
+        add('query_edit', name, s, function()
+            return assert(query_edit(s, edits))
+        end)
+    end
+    for _, name in ipairs({
+        'query_10',
+        'query_1k',
+    }) do
+        local s = CORPUS[name]
+        add('query_edit', name, s, function()
+            return assert(query_edit(s, edits, true))
+        end)
+    end
+end
+
+-- matcher
+do
+    for _, nrule in ipairs({
+        100,
+        100000,
+    }) do
+        local rules = {}
+        for i = 1, nrule do
+            rules[i] = format('host%d.example%d.com/path/%d/', i, i % 97, i)
+        end
+        local m = url.matcher(rules)
+        local s = format('https://www.host%d.example%d.com/path/%d/index.html',
+                         nrule, nrule % 97, nrule)
+        add('matcher', format('match_%d_rules', nrule), s, function()
+            return m:match(s)
+        end)
+    end
+end
+
+-- parse cache
+do
+    local c = url.cache(1024)
+    for _, name in ipairs({
+        'short_url',
+        'long_url',
+    }) do
+        local s = CORPUS[name]
+        add('cache', name .. '+hit', s, function()
+            return c:parse(s, true)
+        end)
+    end
+
+    -- 20% of the calls miss the cache
+    local urls = {}
+    for i = 1, 100 do
+        urls[i] = format('https://example.com/items/%d?ref=%d', i, i % 7)
+    end
+    local skewed = url.cache(64)
+    local i = 0
+    add('cache', 'skewed', urls[1], function()
+        i = i + 1
+        if i % 5 == 0 then
+            return skewed:parse(urls[i % 100 + 1], true)
+        end
+        return skewed:parse(urls[i % 4 + 1], true)
+    end)
+end
+
+-- reusable buffer
+do
+    local b = url.buffer()
+    for _, name in ipairs({
+        'utf8_64k',
+        'binary_64k',
+    }) do
+        local s = CORPUS[name]
+        add('buffer', 'encode_form/' .. name, s, function()
+            b:reset()
+            return b:encode_form(s)
+        end)
+    end
+    for _, name in ipairs({
+        'escaped_64k',
+        'form_4m',
+    }) do
+        local s = CORPUS[name]
+        add('buffer', 'decode_form/' .. name, s, function()
+            b:reset()
+            return assert(b:decode_form(s))
+        end)
+    end
+end
+
+-- url builder
+do
+    local b = url.builder('https://api.example.com/v1')
+    local base = b:tostring()
+    local id = 'user name/42'
+    local q = 'caf\195\169 & cr\195\168me'
+    local s = base .. id .. q
+    add('builder', 'api_url', s, function()
+        return b:reset():segment('users', id, 'posts'):param('q', q):param(
+                   'page', 2):tostring()
+    end)
+    -- the same url by the concatenation of the encoded strings
+    local encode3986 = url.encode3986
+    add('builder', 'api_url+concat', s, function()
+        return base .. '/users/' .. encode3986(id) .. '/posts?q=' ..
+                   encode3986(q) .. '&page=2'
+    end)
+
+    -- the parameters are appended in the loop
+    local keys = {}
+    local vals = {}
+    for i = 1, 20 do
+        keys[i] = 'key' .. i
+        vals[i] = q .. i
+    end
+    s = base .. concat(keys) .. concat(vals)
+    add('builder', 'params_20', s, function()
+        b:reset()
+        for i = 1, #keys do
+            b:param(keys[i], vals[i])
+        end
+        return b:tostring()
+    end)
+    add('builder', 'params_20+concat', s, function()
+        local list = {}
+        for i = 1, #keys do
+            list[i] = encode3986(keys[i]) .. '=' .. encode3986(vals[i])
+        end
+        return base .. '?' .. concat(list, '&')
+    end)
+end
+
+-- step-wise codec and parser
+do
+    local step = url.step
+    local opts = {
+        yield = false,
+    }
+    local form, utf8, query = CORPUS.form_4m, CORPUS.utf8_64k, CORPUS.query_10k
+    add('step', 'decode_form/form_4m', form, function()
+        return assert(step.decode_form(form, nil, opts))
+    end)
+    add('step', 'encode_form/utf8_64k', utf8, function()
+        return step.encode_form(utf8, opts)
+    end)
+    add('step', 'parse/query_10k+params', query, function()
+        return step.parse(query, true, 0, true, false, opts)
+    end)
+end
+
+--- measure runs fn n times and returns the elapsed seconds
+--- @param fn function
+--- @param n integer
+--- @return number sec
+local function measure(fn, n)
+    collectgarbage('collect')
+    local t = clock()
+    for _ = 1, n do
+        fn()
+    end
+    return clock() - t
+end
+
+--- measure_alloc runs fn n times while the garbage collector is stopped and
+--- returns the allocated bytes per call
+--- @param fn function
+--- @param n integer
+--- @return number bytes
+local function measure_alloc(fn, n)
+    collectgarbage('collect')
+    collectgarbage('stop')
+    local mem = collectgarbage('count')
+    for _ = 1, n do
+        fn()
+    end
+    mem = collectgarbage('count') - mem
+    collectgarbage('restart')
+    return mem * 1024 / n
+end
+
+--- run the benchmark
+--- @param b table
+--- @param duration number
+--- @return table result
+local function run(b, duration)
+    -- warm up and calibrate the number of iterations
+    local n = 1
+    local sec = measure(b.fn, n)
+    while sec < duration / 10 do
+        n = n * 2
+        sec = measure(b.fn, n)
+    end
+    n = math.max(1, math.floor(n * duration / sec))
+
+    sec = measure(b.fn, n)
+    local ns = sec * 1e9 / n
+    return {
+        name = b.name,
+        export = b.export,
+        bytes = #b.input,
+        iterations = n,
+        ns_per_op = ns,
+        mb_per_sec = #b.input / (1024 * 1024) / (ns / 1e9),
+        -- the garbage collector is stopped while measuring, so limit the
+        -- number of calls
+        alloc_bytes_per_op = measure_alloc(b.fn, math.min(n, 16)),
+    }
+end
+
+--- encode_json encodes the value as JSON
+--- @param v any
+--- @param indent string?
+--- @return string
+local function encode_json(v, indent)
+    indent = indent or ''
+    local t = type(v)
+    if t == 'string' then
+        return format('%q', v)
+    elseif t == 'number' then
+        if v % 1 == 0 then
+            return format('%d', v)
+        end
+        return format('%.3f', v)
+    elseif t ~= 'table' then
+        return tostring(v)
+    end
+
+    local nested = indent .. '  '
+    local list = {}
+    if #v > 0 then
+        for i, item in ipairs(v) do
+            list[i] = nested .. encode_json(item, nested)
+        end
+        return '[\n' .. concat(list, ',\n') .. '\n' .. indent .. ']'
+    end
+
+    local keys = {}
+    for k in pairs(v) do
+        keys[#keys + 1] = k
+    end
+    sort(keys)
+    for i, k in ipairs(keys) do
+        list[i] = format('%s%q: %s', nested, k, encode_json(v[k], nested))
+    end
+    return '{\n' .. concat(list, ',\n') .. '\n' .. indent .. '}'
+end
+
+--- load_results reads the ns_per_op of the previous results
+--- @param pathname string
+--- @return table<string, number>
+local function load_results(pathname)
+    local f = assert(io.open(pathname))
+    local src = f:read('*a')
+    f:close()
+
+    local res = {}
+    for item in src:gmatch('{[^{}]*}') do
+        local name = item:match('"name":%s*"([^"]+)"')
+        local ns = item:match('"ns_per_op":%s*([%d%.]+)')
+        if name and ns then
+            res[name] = tonumber(ns)
+        end
+    end
+    return res
+end
+
+local opts = parse_args()
+local prev = opts.compare and load_results(opts.compare)
+local results = {}
+local covered = {}
+
+print(format('%-32s %10s %14s %10s %14s%s', 'name', 'bytes', 'ns/op', 'MB/s',
+             'alloc B/op', prev and '      delta' or ''))
+for _, b in ipairs(BENCHMARKS) do
+    covered[b.export] = true
+    if not opts.filter or b.name:find(opts.filter) then
+        local r = run(b, opts.duration)
+        local delta = ''
+        if prev and prev[r.name] then
+            delta = format(' %+9.1f%%', (r.ns_per_op / prev[r.name] - 1) * 100)
+        end
+        print(format('%-32s %10d %14.1f %10.2f %14.1f%s', r.name, r.bytes,
+                     r.ns_per_op, r.mb_per_sec, r.alloc_bytes_per_op, delta))
+        results[#results + 1] = r
+    end
+end
+
+-- every export of the url module must be benchmarked except the counters
+local UNTIMED = {
+    stats = true,
+    stats_reset = true,
+}
+for k, v in pairs(url) do
+    if type(v) == 'function' and not covered[k] and not UNTIMED[k] then
+        print(format('WARNING: %q is not benchmarked', k))
+    end
+end
+
+local f = assert(io.open(opts.output, 'w'))
+f:write(encode_json({
+    version = _VERSION,
+    jit = jit and jit.version or nil,
+    date = os.date('!%Y-%m-%dT%H:%M:%SZ'),
+    duration = opts.duration,
+    results = results,
+}), '\n')
+f:close()
+print('results are written to ' .. opts.output)
@@ -0,0 +1,86 @@
+/**
+ *  Copyright (C) 2017 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *
+ *  src/authority.c
+ *  lua-url
+ *
+ *  extract the scheme, the hostname and the port of the url without parsing
+ *  the path, the query and the fragment.
+ */
+
+// depend
+#include "lauxhlib.h"
+// lua
+#include <lauxlib.h>
+// lua-url
+#include "url.h"
+
+static inline void push_span(lua_State *L, const char *src, url_t *u,
+                             url_field_e field)
+{
+    if (u->fields & (1 << field)) {
+        lua_pushlstring(L, src + u->span[field].head, u->span[field].len);
+    } else {
+        lua_pushnil(L);
+    }
+}
+
+static int authority_lua(lua_State *L)
+{
+    size_t len      = 0;
+    const char *src = lauxh_checklstring(L, 1, &len);
+    size_t cur      = lauxh_optuint64(L, 2, 0);
+    url_t u         = {0};
+
+    if (cur > len) {
+        cur = len;
+    }
+    if (url_parse_authority(&u, (const unsigned char *)src, len, cur)) {
+        // illegal byte sequence
+        lua_pushnil(L);
+        lua_pushnil(L);
+        lua_pushnil(L);
+        lua_pushinteger(L, u.cur + 1);
+        return 4;
+    }
+
+    push_span(L, src, &u, URL_SCHEME);
+    push_span(L, src, &u, URL_HOSTNAME);
+    if (u.fields & (1 << URL_PORT)) {
+        // the port is validated by the parser
+        const char *p = src + u.span[URL_PORT].head;
+        lua_Integer n = 0;
+        for (size_t i = 0; i < u.span[URL_PORT].len; i++) {
+            n = n * 10 + (p[i] - '0');
+        }
+        lua_pushinteger(L, n);
+    } else {
+        lua_pushnil(L);
+    }
+    return 3;
+}
+
+LUALIB_API int luaopen_url_authority(lua_State *L)
+{
+    lua_pushcfunction(L, authority_lua);
+    return 1;
+}
@@ -0,0 +1,375 @@
+/**
+ *  Copyright (C) 2017 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *
+ *  src/buffer.c
+ *  lua-url
+ *
+ *  growable byte buffer that the codec appends into, so that the encoded or
+ *  decoded data does not have to be interned as a lua string.
+ */
+
+// depend
+#include "lauxhlib.h"
+// lua
+#include <lauxlib.h>
+// lua-url
+#include "url.h"
+// system
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MODULE_MT "url.buffer"
+
+// maximum number of bytes that the decoder reads beyond the stop position:
+// the "%uXXXX%uXXXX" sequence (11 bytes) and the rest of the UTF-8 sequence
+// (3 bytes of "%XX")
+#define MAX_OVERRUN 20
+
+typedef struct {
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+} buffer_t;
+
+// returns the pointer to the tail of the data that has room for size bytes
+static unsigned char *reserve(lua_State *L, buffer_t *b, size_t size)
+{
+    unsigned char *p = url_reserve(&b->data, b->len, &b->cap, size);
+
+    if (!p) {
+        luaL_error(L, "failed to reserve buffer: %s", strerror(errno));
+    }
+    return p;
+}
+
+static int encode_lua(lua_State *L, url_encode_type_e type)
+{
+    buffer_t *b        = luaL_checkudata(L, 1, MODULE_MT);
+    size_t len         = 0;
+    unsigned char *src = (unsigned char *)lauxh_checklstring(L, 2, &len);
+    unsigned char *dst = NULL;
+
+    if (len > SIZE_MAX / 3) {
+        return luaL_error(L, "failed to reserve buffer: %s", strerror(ENOMEM));
+    }
+    // keep the valid percent-encoded sequences
+    if (lauxh_optboolean(L, 3, 0)) {
+        type |= URL_ENCODE_PRESERVE;
+    }
+    dst = reserve(L, b, URL_ENCODE_MAXLEN(len));
+    b->len += url_encode(dst, src, len, type);
+    lua_pushinteger(L, b->len);
+    return 1;
+}
+
+static int encode_uri_lua(lua_State *L)
+{
+    return encode_lua(L, URL_ENCODE_URI);
+}
+
+static int encode_form_lua(lua_State *L)
+{
+    return encode_lua(L, URL_ENCODE_FORM);
+}
+
+static int encode2396_lua(lua_State *L)
+{
+    return encode_lua(L, URL_ENCODE_2396);
+}
+
+static int encode3986_lua(lua_State *L)
+{
+    return encode_lua(L, URL_ENCODE_3986);
+}
+
+static int decode_lua(lua_State *L, url_decode_type_e type)
+{
+    buffer_t *b        = luaL_checkudata(L, 1, MODULE_MT);
+    size_t len         = 0;
+    unsigned char *src = (unsigned char *)lauxh_checklstring(L, 2, &len);
+    unsigned char *dst = NULL;
+    size_t epos        = 0;
+    ssize_t rv         = 0;
+
+    // validate the decoded bytes as UTF-8
+    if (lauxh_optboolean(L, 3, 0)) {
+        type |= URL_DECODE_UTF8;
+    }
+    // copy the invalid '%' as it is
+    if (lauxh_optboolean(L, 4, 0)) {
+        type |= URL_DECODE_LENIENT;
+    }
+    dst = reserve(L, b, URL_DECODE_MAXLEN(len));
+    rv  = url_decode(dst, src, len, type, &epos);
+    if (rv < 0) {
+        // the data of the buffer is not changed
+        lua_pushnil(L);
+        lua_pushinteger(L, epos + 1);
+        return 2;
+    }
+    b->len += rv;
+    lua_pushinteger(L, b->len);
+    if (type & URL_DECODE_LENIENT) {
+        // number of the invalid '%'
+        lua_pushinteger(L, epos);
+        return 2;
+    }
+    return 1;
+}
+
+static int decode_uri_lua(lua_State *L)
+{
+    return decode_lua(L, URL_DECODE_URI);
+}
+
+static int decode_form_lua(lua_State *L)
+{
+    return decode_lua(L, URL_DECODE_FORM);
+}
+
+static int decode_all_lua(lua_State *L)
+{
+    return decode_lua(L, URL_DECODE_ALL);
+}
+
+/**
+ *  cur, err = b:step(op, s, init, size [, strict])
+ *  process about size bytes of s from the 0-based init position, append the
+ *  result and return the next position.
+ */
+static int step_lua(lua_State *L)
+{
+    static const char *const OPS[] = {
+        "encode_uri", "encode_form", "encode2396", "encode3986",
+        "decode_uri", "decode_form", "decode",     NULL,
+    };
+    static const int TYPES[] = {
+        URL_ENCODE_URI, URL_ENCODE_FORM, URL_ENCODE_2396, URL_ENCODE_3986,
+        URL_DECODE_URI, URL_DECODE_FORM, URL_DECODE_ALL,
+    };
+    buffer_t *b        = luaL_checkudata(L, 1, MODULE_MT);
+    int op             = luaL_checkoption(L, 2, NULL, OPS);
+    size_t len         = 0;
+    unsigned char *src = (unsigned char *)lauxh_checklstring(L, 3, &len);
+    uint64_t cur       = lauxh_checkuint64(L, 4);
+    uint64_t size      = lauxh_checkuint64(L, 5);
+    int strict         = lauxh_optboolean(L, 6, 0);
+    size_t stop        = 0;
+    unsigned char *dst = NULL;
+
+    if (cur > len) {
+        return lauxh_argerror(L, 4, "position out of range");
+    } else if (!size) {
+        return lauxh_argerror(L, 5, "size must be greater than 0");
+    }
+    stop = (size < len - cur) ? cur + size : len;
+
+    if (op < 4) {
+        size_t n = stop - cur;
+        dst      = reserve(L, b, URL_ENCODE_MAXLEN(n));
+        b->len += url_encode(dst, src + cur, n, TYPES[op]);
+    } else {
+        size_t epos = 0;
+        size_t pos  = cur;
+        ssize_t rv  = 0;
+        int type    = TYPES[op] | (strict ? URL_DECODE_UTF8 : 0);
+
+        dst = reserve(L, b,
+                      URL_DECODE_MAXLEN(len - stop < MAX_OVERRUN ?
+                                            len - cur :
+                                            stop - cur + MAX_OVERRUN));
+        rv  = url_decode_step(dst, src, len, type, &pos, stop, &epos);
+        if (rv < 0) {
+            // the data of the buffer is not changed
+            lua_pushnil(L);
+            lua_pushinteger(L, epos + 1);
+            return 2;
+        }
+        b->len += rv;
+        stop = pos;
+    }
+    lua_pushinteger(L, stop);
+    return 1;
+}
+
+static int append_lua(lua_State *L)
+{
+    buffer_t *b     = luaL_checkudata(L, 1, MODULE_MT);
+    size_t len      = 0;
+    const char *src = lauxh_checklstring(L, 2, &len);
+
+    memcpy(reserve(L, b, len), src, len);
+    b->len += len;
+    lua_pushinteger(L, b->len);
+    return 1;
+}
+
+static int sub_lua(lua_State *L)
+{
+    buffer_t *b    = luaL_checkudata(L, 1, MODULE_MT);
+    lua_Integer i  = lauxh_checkinteger(L, 2);
+    lua_Integer j  = lauxh_optinteger(L, 3, -1);
+    lua_Integer sz = b->len;
+
+    // same as string.sub
+    if (i < 0) {
+        i = (-i > sz) ? 1 : sz + i + 1;
+    } else if (i == 0) {
+        i = 1;
+    }
+    if (j < 0) {
+        j = (-j > sz) ? 0 : sz + j + 1;
+    } else if (j > sz) {
+        j = sz;
+    }
+    if (i > j) {
+        lua_pushliteral(L, "");
+    } else {
+        lua_pushlstring(L, (char *)b->data + i - 1, j - i + 1);
+    }
+    return 1;
+}
+
+static int tostring_lua(lua_State *L)
+{
+    buffer_t *b = luaL_checkudata(L, 1, MODULE_MT);
+
+    lua_pushlstring(L, (char *)b->data, b->len);
+    return 1;
+}
+
+static int ptr_lua(lua_State *L)
+{
+    buffer_t *b = luaL_checkudata(L, 1, MODULE_MT);
+
+    // NOTE: the pointer is invalidated when the buffer grows
+    lua_pushlightuserdata(L, b->data);
+    return 1;
+}
+
+static int cap_lua(lua_State *L)
+{
+    buffer_t *b = luaL_checkudata(L, 1, MODULE_MT);
+
+    lua_pushinteger(L, b->cap);
+    return 1;
+}
+
+static int len_lua(lua_State *L)
+{
+    buffer_t *b = luaL_checkudata(L, 1, MODULE_MT);
+
+    lua_pushinteger(L, b->len);
+    return 1;
+}
+
+static int reset_lua(lua_State *L)
+{
+    buffer_t *b = luaL_checkudata(L, 1, MODULE_MT);
+
+    // keep the capacity for reuse
+    b->len = 0;
+    return 0;
+}
+
+static int mt_tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, MODULE_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int gc_lua(lua_State *L)
+{
+    buffer_t *b = lua_touserdata(L, 1);
+
+    free(b->data);
+    b->data = NULL;
+    b->len = b->cap = 0;
+    return 0;
+}
+
+static int new_lua(lua_State *L)
+{
+    uint64_t cap = lauxh_optuint64(L, 1, 0);
+    buffer_t *b  = NULL;
+
+    lua_settop(L, 0);
+    b  = lua_newuserdata(L, sizeof(buffer_t));
+    *b = (buffer_t){0};
+    lauxh_setmetatable(L, MODULE_MT);
+    if (cap) {
+        reserve(L, b, cap);
+    }
+    return 1;
+}
+
+LUALIB_API int luaopen_url_buffer(lua_State *L)
+{
+    struct luaL_Reg mmethod[] = {
+        {"__gc",       gc_lua         },
+        {"__len",      len_lua        },
+        {"__tostring", mt_tostring_lua},
+        {NULL,         NULL           }
+    };
+    struct luaL_Reg method[] = {
+        {"encode_uri",  encode_uri_lua },
+        {"encode_form", encode_form_lua},
+        {"encode2396",  encode2396_lua },
+        {"encode3986",  encode3986_lua },
+        {"decode_uri",  decode_uri_lua },
+        {"decode_form", decode_form_lua},
+        {"decode",      decode_all_lua },
+        {"step",        step_lua       },
+        {"append",      append_lua     },
+        {"sub",         sub_lua        },
+        {"tostring",    tostring_lua   },
+        {"ptr",         ptr_lua        },
+        {"cap",         cap_lua        },
+        {"len",         len_lua        },
+        {"reset",       reset_lua      },
+        {NULL,          NULL           }
+    };
+    int i;
+
+    // create metatable
+    luaL_newmetatable(L, MODULE_MT);
+    // metamethods
+    i = 0;
+    while (mmethod[i].name) {
+        lauxh_pushfn2tbl(L, mmethod[i].name, mmethod[i].func);
+        i++;
+    }
+    // methods
+    lua_pushstring(L, "__index");
+    lua_newtable(L);
+    i = 0;
+    while (method[i].name) {
+        lauxh_pushfn2tbl(L, method[i].name, method[i].func);
+        i++;
+    }
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+
+    lua_pushcfunction(L, new_lua);
+    return 1;
+}
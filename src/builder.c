@@ -0,0 +1,359 @@
+/**
+ *  Copyright (C) 2017 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *
+ *
+ *  src/builder.c
+ *  lua-url
+ *
+ *  url builder that appends the encoded path segments, query parameters and
+ *  fragment to the base url in a single growable buffer.
+ */
+
+// depend
+#include "lauxhlib.h"
+// lua
+#include <lauxlib.h>
+// lua-url
+#include "url.h"
+// system
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MODULE_MT "url.builder"
+
+// component of the url that the builder is appending to
+typedef enum {
+    STAGE_PATH = 0,
+    STAGE_QUERY,
+    STAGE_FRAGMENT,
+} stage_e;
+
+typedef struct {
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+    // length and stage of the base url that is restored by reset
+    size_t base;
+    stage_e base_stage;
+    stage_e stage;
+    url_encode_type_e param_type;
+} builder_t;
+
+// returns the pointer to the tail of the data that has room for size bytes
+static unsigned char *reserve(lua_State *L, builder_t *b, size_t size)
+{
+    unsigned char *p = url_reserve(&b->data, b->len, &b->cap, size);
+
+    if (!p) {
+        luaL_error(L, "failed to reserve buffer: %s", strerror(errno));
+    }
+    return p;
+}
+
+static inline void append_byte(lua_State *L, builder_t *b, unsigned char c)
+{
+    *reserve(L, b, 1) = c;
+    b->len++;
+}
+
+/**
+ *  returns 1 if the number at idx is formatted as the integer by tostring.
+ */
+static inline int is_integer(lua_State *L, int idx)
+{
+#if LUA_VERSION_NUM >= 503
+    return lua_isinteger(L, idx);
+#else
+    // the number is formatted with "%.14g"
+    lua_Number n = lua_tonumber(L, idx);
+    return n > -1e14 && n < 1e14 && n == (lua_Number)(lua_Integer)n &&
+           !(n == 0 && signbit(n));
+#endif
+}
+
+/**
+ *  append the decimal digits of the integer without converting it to the
+ *  lua string. the digits and the '-' are never encoded.
+ */
+static void append_integer(lua_State *L, builder_t *b, lua_Integer v)
+{
+    unsigned char digits[24];
+    unsigned char *p = digits + sizeof(digits);
+    // negate in unsigned to handle the minimum value
+    uint64_t n       = (v < 0) ? -(uint64_t)v : (uint64_t)v;
+    size_t len       = 0;
+
+    do {
+        *--p = '0' + n % 10;
+        n /= 10;
+    } while (n);
+    if (v < 0) {
+        *--p = '-';
+    }
+    len = digits + sizeof(digits) - p;
+    memcpy(reserve(L, b, len), p, len);
+    b->len += len;
+}
+
+/**
+ *  encode the string or number at idx and append it.
+ */
+static void append_encoded(lua_State *L, builder_t *b, int idx,
+                           url_encode_type_e type)
+{
+    size_t len         = 0;
+    unsigned char *src = NULL;
+    unsigned char *dst = NULL;
+
+    switch (lua_type(L, idx)) {
+    case LUA_TNUMBER:
+        if (is_integer(L, idx)) {
+            append_integer(L, b, lua_tointeger(L, idx));
+            return;
+        }
+        // fallthrough
+    case LUA_TSTRING:
+        src = (unsigned char *)lua_tolstring(L, idx, &len);
+        break;
+
+    default:
+        lauxh_argerror(L, idx, "string or number expected, got %s",
+                       luaL_typename(L, idx));
+    }
+    if (len > SIZE_MAX / 3) {
+        luaL_error(L, "failed to reserve buffer: %s", strerror(ENOMEM));
+    }
+    dst = reserve(L, b, URL_ENCODE_MAXLEN(len));
+    b->len += url_encode(dst, src, len, type);
+}
+
+/**
+ *  set the base url and the stage that is determined by the last '?' or '#'
+ *  of the base url.
+ */
+static void set_base(lua_State *L, builder_t *b, int idx)
+{
+    size_t len       = 0;
+    const char *base = lauxh_optlstring(L, idx, "", &len);
+
+    b->len        = 0;
+    b->base_stage = STAGE_PATH;
+    if (memchr(base, '#', len)) {
+        b->base_stage = STAGE_FRAGMENT;
+    } else if (memchr(base, '?', len)) {
+        b->base_stage = STAGE_QUERY;
+    }
+    memcpy(reserve(L, b, len), base, len);
+    b->len = b->base = len;
+    b->stage         = b->base_stage;
+}
+
+/**
+ *  b = b:segment(s, ...)
+ *  append the path segments that are separated by '/'. the segment is
+ *  encoded by the RFC 3986 unreserved characters, so that the '/' in the
+ *  segment is encoded as well.
+ */
+static int segment_lua(lua_State *L)
+{
+    builder_t *b = luaL_checkudata(L, 1, MODULE_MT);
+    int narg     = lua_gettop(L);
+
+    if (b->stage != STAGE_PATH) {
+        return luaL_error(L, "cannot append the path segment after the "
+                             "query or fragment");
+    }
+    for (int i = 2; i <= narg; i++) {
+        // the trailing '/' of the base url is shared with the first segment
+        if (b->len != b->base || !b->len || b->data[b->len - 1] != '/') {
+            append_byte(L, b, '/');
+        }
+        append_encoded(L, b, i, URL_ENCODE_3986);
+    }
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ *  b = b:param(k [, v])
+ *  append the query parameter. the '=' is omitted if v is nil.
+ */
+static int param_lua(lua_State *L)
+{
+    builder_t *b = luaL_checkudata(L, 1, MODULE_MT);
+
+    lauxh_checklstring(L, 2, NULL);
+    if (b->stage == STAGE_FRAGMENT) {
+        return luaL_error(L, "cannot append the query parameter after the "
+                             "fragment");
+    } else if (b->stage == STAGE_PATH) {
+        append_byte(L, b, '?');
+        b->stage = STAGE_QUERY;
+    } else if (b->data[b->len - 1] != '?' && b->data[b->len - 1] != '&') {
+        append_byte(L, b, '&');
+    }
+    append_encoded(L, b, 2, b->param_type);
+    if (!lauxh_isnil(L, 3)) {
+        append_byte(L, b, '=');
+        append_encoded(L, b, 3, b->param_type);
+    }
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ *  b = b:fragment(s)
+ */
+static int fragment_lua(lua_State *L)
+{
+    builder_t *b = luaL_checkudata(L, 1, MODULE_MT);
+
+    lauxh_checklstring(L, 2, NULL);
+    if (b->stage == STAGE_FRAGMENT) {
+        return luaL_error(L, "the fragment has already been appended");
+    }
+    append_byte(L, b, '#');
+    append_encoded(L, b, 2, URL_ENCODE_3986);
+    b->stage = STAGE_FRAGMENT;
+    lua_settop(L, 1);
+    return 1;
+}
+
+/**
+ *  b = b:reset([base])
+ *  restore the base url, or replace it if the base is specified.
+ */
+static int reset_lua(lua_State *L)
+{
+    builder_t *b = luaL_checkudata(L, 1, MODULE_MT);
+
+    // keep the capacity for reuse
+    if (lauxh_isnil(L, 2)) {
+        b->len   = b->base;
+        b->stage = b->base_stage;
+    } else {
+        set_base(L, b, 2);
+    }
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int tostring_lua(lua_State *L)
+{
+    builder_t *b = luaL_checkudata(L, 1, MODULE_MT);
+
+    lua_pushlstring(L, (char *)b->data, b->len);
+    return 1;
+}
+
+static int cap_lua(lua_State *L)
+{
+    builder_t *b = luaL_checkudata(L, 1, MODULE_MT);
+
+    lua_pushinteger(L, b->cap);
+    return 1;
+}
+
+static int len_lua(lua_State *L)
+{
+    builder_t *b = luaL_checkudata(L, 1, MODULE_MT);
+
+    lua_pushinteger(L, b->len);
+    return 1;
+}
+
+static int mt_tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, MODULE_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int gc_lua(lua_State *L)
+{
+    builder_t *b = lua_touserdata(L, 1);
+
+    free(b->data);
+    b->data = NULL;
+    b->len = b->cap = 0;
+    return 0;
+}
+
+static int new_lua(lua_State *L)
+{
+    int form     = lauxh_optboolean(L, 2, 0);
+    builder_t *b = NULL;
+
+    lauxh_optlstring(L, 1, "", NULL);
+    lua_settop(L, 1);
+    b  = lua_newuserdata(L, sizeof(builder_t));
+    *b = (builder_t){
+        .param_type = form ? URL_ENCODE_FORM : URL_ENCODE_3986,
+    };
+    lauxh_setmetatable(L, MODULE_MT);
+    set_base(L, b, 1);
+    return 1;
+}
+
+LUALIB_API int luaopen_url_builder(lua_State *L)
+{
+    struct luaL_Reg mmethod[] = {
+        {"__gc",       gc_lua         },
+        {"__len",      len_lua        },
+        {"__tostring", mt_tostring_lua},
+        {NULL,         NULL           }
+    };
+    struct luaL_Reg method[] = {
+        {"segment",  segment_lua  },
+        {"param",    param_lua    },
+        {"fragment", fragment_lua },
+        {"reset",    reset_lua    },
+        {"tostring", tostring_lua },
+        {"cap",      cap_lua      },
+        {"len",      len_lua      },
+        {NULL,       NULL         }
+    };
+    int i;
+
+    // create metatable
+    luaL_newmetatable(L, MODULE_MT);
+    // metamethods
+    i = 0;
+    while (mmethod[i].name) {
+        lauxh_pushfn2tbl(L, mmethod[i].name, mmethod[i].func);
+        i++;
+    }
+    // methods
+    lua_pushstring(L, "__index");
+    lua_newtable(L);
+    i = 0;
+    while (method[i].name) {
+        lauxh_pushfn2tbl(L, method[i].name, method[i].func);
+        i++;
+    }
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+
+    lua_pushcfunction(L, new_lua);
+    return 1;
+}
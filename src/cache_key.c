@@ -0,0 +1,356 @@
+/**
+ *  Copyright (C) 2017 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *
+ *  src/cache_key.c
+ *  lua-url
+ *
+ *  canonical cache key of the url: the scheme and the host are lowercased,
+ *  the userinfo and the fragment are removed, and the query parameters are
+ *  filtered and sorted by the raw key.
+ */
+
+// depend
+#include "lauxhlib.h"
+// lua
+#include <lauxlib.h>
+// lua-url
+#include "url.h"
+// system
+#include <stdlib.h>
+#include <string.h>
+
+#define REGISTRY_KEY "url.cache_key"
+
+// number of the query parameters that are sorted on the stack
+#define NSTACK_PARAM 64
+
+typedef struct {
+    const char *str;
+    size_t len;
+    // the rule ends with '*'
+    int is_prefix;
+} rule_t;
+
+typedef struct {
+    // the allow list is specified
+    int has_allow;
+    size_t nallow;
+    rule_t *allow;
+    size_t ndeny;
+    rule_t *deny;
+    // return the hash instead of the key
+    int hash;
+} rules_t;
+
+typedef struct {
+    const unsigned char *key;
+    size_t klen;
+    // raw "key=val" pair
+    size_t head;
+    size_t len;
+    // index to keep the order of the same keys
+    size_t idx;
+} param_t;
+
+typedef struct {
+    luaL_Buffer b;
+    int hash;
+    // FNV-1a 64
+    uint64_t h;
+} emitter_t;
+
+static inline void emit(emitter_t *e, const unsigned char *s, size_t len,
+                        int lower)
+{
+    if (e->hash) {
+        for (size_t i = 0; i < len; i++) {
+            unsigned char c = s[i];
+            if (lower && c >= 'A' && c <= 'Z') {
+                c |= 0x20;
+            }
+            e->h = (e->h ^ c) * 0x100000001b3ULL;
+        }
+    } else if (lower) {
+        for (size_t i = 0; i < len; i++) {
+            unsigned char c = s[i];
+            luaL_addchar(&e->b, (c >= 'A' && c <= 'Z') ? c | 0x20 : c);
+        }
+    } else {
+        luaL_addlstring(&e->b, (const char *)s, len);
+    }
+}
+
+static inline int match_rules(const rule_t *rules, size_t nrule,
+                              const unsigned char *key, size_t klen)
+{
+    for (size_t i = 0; i < nrule; i++) {
+        const rule_t *r = rules + i;
+        if ((r->is_prefix ? klen >= r->len : klen == r->len) &&
+            memcmp(r->str, key, r->len) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int cmp_param(const void *a, const void *b)
+{
+    const param_t *x = a;
+    const param_t *y = b;
+    int rv = memcmp(x->key, y->key, x->klen < y->klen ? x->klen : y->klen);
+
+    if (rv) {
+        return rv;
+    } else if (x->klen != y->klen) {
+        return x->klen < y->klen ? -1 : 1;
+    }
+    return x->idx < y->idx ? -1 : 1;
+}
+
+/**
+ *  count the rules of the opts[field] list and the bytes of the rules.
+ */
+static size_t count_rules(lua_State *L, int idx, const char *field,
+                          size_t *nbyte)
+{
+    size_t n = 0;
+
+    lua_getfield(L, idx, field);
+    if (lauxh_isnil(L, -1)) {
+        lua_pop(L, 1);
+        return 0;
+    } else if (!lua_istable(L, -1)) {
+        return lauxh_argerror(L, 2, "opts.%s must be table", field);
+    }
+    n = lauxh_rawlen(L, -1);
+    for (size_t i = 1; i <= n; i++) {
+        lua_rawgeti(L, -1, i);
+        if (!lauxh_isstring(L, -1)) {
+            return lauxh_argerror(L, 2, "opts.%s#%d must be string", field,
+                                  (int)i);
+        }
+        *nbyte += lauxh_rawlen(L, -1);
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+    return n;
+}
+
+static char *copy_rules(lua_State *L, int idx, const char *field,
+                        rule_t *rules, size_t nrule, char *p)
+{
+    lua_getfield(L, idx, field);
+    for (size_t i = 0; i < nrule; i++) {
+        size_t len      = 0;
+        const char *str = NULL;
+
+        lua_rawgeti(L, -1, i + 1);
+        str = lua_tolstring(L, -1, &len);
+        memcpy(p, str, len);
+        rules[i].str       = p;
+        rules[i].is_prefix = len && str[len - 1] == '*';
+        rules[i].len       = len - rules[i].is_prefix;
+        p += len;
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+    return p;
+}
+
+/**
+ *  compile the options into a userdata and push it onto the stack.
+ */
+static rules_t *compile_rules(lua_State *L, int idx)
+{
+    size_t nbyte  = 0;
+    size_t nallow = count_rules(L, idx, "allow", &nbyte);
+    size_t ndeny  = count_rules(L, idx, "deny", &nbyte);
+    rules_t *r    = NULL;
+    char *p       = NULL;
+
+    lua_getfield(L, idx, "allow");
+    r = lua_newuserdata(L, sizeof(rules_t) +
+                               sizeof(rule_t) * (nallow + ndeny) + nbyte);
+    *r = (rules_t){
+        .has_allow = !lauxh_isnil(L, -2),
+        .nallow    = nallow,
+        .allow     = (rule_t *)(r + 1),
+        .ndeny     = ndeny,
+        .deny      = (rule_t *)(r + 1) + nallow,
+    };
+    lua_replace(L, -2);
+
+    lua_getfield(L, idx, "hash");
+    if (!lauxh_isnil(L, -1)) {
+        if (!lua_isboolean(L, -1)) {
+            lauxh_argerror(L, 2, "opts.hash must be boolean");
+        }
+        r->hash = lua_toboolean(L, -1);
+    }
+    lua_pop(L, 1);
+
+    p = (char *)(r->deny + ndeny);
+    p = copy_rules(L, idx, "allow", r->allow, nallow, p);
+    copy_rules(L, idx, "deny", r->deny, ndeny, p);
+    return r;
+}
+
+/**
+ *  returns the compiled options of the table at idx. the options are
+ *  compiled at the first call and cached while the table is alive.
+ */
+static const rules_t *get_rules(lua_State *L, int idx)
+{
+    rules_t *r = NULL;
+
+    lua_getfield(L, LUA_REGISTRYINDEX, REGISTRY_KEY);
+    lua_pushvalue(L, idx);
+    lua_rawget(L, -2);
+    if ((r = lua_touserdata(L, -1))) {
+        lua_pop(L, 2);
+        return r;
+    }
+    lua_pop(L, 1);
+
+    r = compile_rules(L, idx);
+    lua_pushvalue(L, idx);
+    lua_pushvalue(L, -2);
+    lua_rawset(L, -4);
+    lua_pop(L, 2);
+    return r;
+}
+
+static int cache_key_lua(lua_State *L)
+{
+    static const rules_t NORULES = {0};
+    size_t len                   = 0;
+    const char *src              = lauxh_checklstring(L, 1, &len);
+    const unsigned char *url     = (const unsigned char *)src;
+    const rules_t *r             = &NORULES;
+    param_t sparams[NSTACK_PARAM];
+    param_t *params = sparams;
+    size_t nparam   = 0;
+    emitter_t e     = {.h = 0xcbf29ce484222325ULL};
+    url_t u         = {0};
+
+    if (!lauxh_isnil(L, 2)) {
+        lauxh_checktable(L, 2);
+        r = get_rules(L, 2);
+    }
+    lua_settop(L, 2);
+
+    if (url_parse(&u, url, len, 0, 0)) {
+        // illegal byte sequence
+        lua_pushnil(L);
+        lua_pushinteger(L, u.cur + 1);
+        return 2;
+    }
+
+    // collect the query parameters
+    if (u.fields & (1 << URL_QUERY)) {
+        url_span_t *query = &u.span[URL_QUERY];
+        size_t tail       = query->head + query->len;
+        size_t max        = 1;
+        url_param_t p     = {0};
+
+        // number of the pairs never exceeds the number of the delimiters + 1
+        for (size_t i = query->head; i < tail; i++) {
+            max += url[i] == '&';
+        }
+        if (max > NSTACK_PARAM) {
+            params = lua_newuserdata(L, sizeof(param_t) * max);
+        }
+        url_param_init(&p, url, query);
+        for (;;) {
+            size_t head = p.cur;
+            while (head < tail && url[head] == '&') {
+                head++;
+            }
+            if (!url_param_next(&p, url, tail)) {
+                break;
+            } else if ((r->has_allow &&
+                        !match_rules(r->allow, r->nallow, url + p.key.head,
+                                     p.key.len)) ||
+                       match_rules(r->deny, r->ndeny, url + p.key.head,
+                                   p.key.len)) {
+                continue;
+            }
+            params[nparam] = (param_t){
+                .key  = url + p.key.head,
+                .klen = p.key.len,
+                .head = head,
+                .len  = p.val.head + p.val.len - head,
+                .idx  = nparam,
+            };
+            nparam++;
+        }
+        qsort(params, nparam, sizeof(param_t), cmp_param);
+    }
+
+    e.hash = r->hash;
+    if (!e.hash) {
+        luaL_buffinit(L, &e.b);
+    }
+    if (u.fields & (1 << URL_SCHEME)) {
+        emit(&e, url + u.span[URL_SCHEME].head, u.span[URL_SCHEME].len, 1);
+        emit(&e, (const unsigned char *)":", 1, 0);
+    }
+    if (u.fields & (1 << URL_HOST)) {
+        emit(&e, (const unsigned char *)"//", 2, 0);
+        emit(&e, url + u.span[URL_HOST].head, u.span[URL_HOST].len, 1);
+    }
+    if (u.fields & (1 << URL_PATH)) {
+        emit(&e, url + u.span[URL_PATH].head, u.span[URL_PATH].len, 0);
+    } else if (u.fields & (1 << URL_HOST)) {
+        emit(&e, (const unsigned char *)"/", 1, 0);
+    }
+    for (size_t i = 0; i < nparam; i++) {
+        emit(&e, (const unsigned char *)(i ? "&" : "?"), 1, 0);
+        emit(&e, url + params[i].head, params[i].len, 0);
+    }
+
+    if (e.hash) {
+        static const char HEX[] = "0123456789abcdef";
+        char hex[16];
+        for (int i = 15; i >= 0; i--, e.h >>= 4) {
+            hex[i] = HEX[e.h & 0xf];
+        }
+        lua_pushlstring(L, hex, 16);
+    } else {
+        luaL_pushresult(&e.b);
+    }
+    return 1;
+}
+
+LUALIB_API int luaopen_url_cache_key(lua_State *L)
+{
+    // compiled options: weak-keyed table of { [opts] = rules }
+    lua_newtable(L);
+    lua_newtable(L);
+    lua_pushliteral(L, "k");
+    lua_setfield(L, -2, "__mode");
+    lua_setmetatable(L, -2);
+    lua_setfield(L, LUA_REGISTRYINDEX, REGISTRY_KEY);
+
+    lua_pushcfunction(L, cache_key_lua);
+    return 1;
+}
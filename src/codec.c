@@ -30,543 +30,417 @@
 #include "lauxhlib.h"
 // lua
 #include <lauxlib.h>
+// lua-url
+#include "url.h"
+#include "url_stats.h"
+// system
+#include <string.h>
 
-/*
-    encodeURI   : 0-9 a-zA-Z !#$&'()*+,-./:;=?@_~
-
-    uric        = reserved | unreserved | escaped
-    reserved    = ";" | "," | "/" | "?" | ":" | "@" | "&" | "=" | "+" | "$"
-    unreserved  = alphanum | mark
-    mark        = "-" | "_" | "." | "!" | "~" | "*" | "'" | "(" | ")"
-
-    escaped     = "%" hex hex
-
-    hex         = digit | "A" | "B" | "C" | "D" | "E" | "F" |
-                          "a" | "b" | "c" | "d" | "e" | "f"
-
-    digit       = "0" | "1" | "2" | "3" | "4" | "5" | "6" | "7" | "8" | "9"
-
-    alphanum    = alpha | digit
-    alpha       = lowalpha | upalpha
-
-    lowalpha    = "a" | "b" | "c" | "d" | "e" | "f" | "g" | "h" | "i" |
-                  "j" | "k" | "l" | "m" | "n" | "o" | "p" | "q" | "r" |
-                  "s" | "t" | "u" | "v" | "w" | "x" | "y" | "z"
-    upalpha     = "A" | "B" | "C" | "D" | "E" | "F" | "G" | "H" | "I" |
-                  "J" | "K" | "L" | "M" | "N" | "O" | "P" | "Q" | "R" |
-                  "S" | "T" | "U" | "V" | "W" | "X" | "Y" | "Z"
-*/
-static const unsigned char UNRESERVED_URI[256] = {
-    //  ctrl-code: 0-31
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0,
-
-    // SP      "            %
-    0, 0, '!', 0, '#', '$', 0, '&', '\'', '(', ')', '*', '+', ',', '-', '.',
-    '/',
-
-    // digit
-    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9',
-
-    //        <       >
-    ':', ';', 0, '=', 0, '?', '@',
-
-    // alpha-upper
-    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O',
-    'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y',
-    //   [  \  ]  ^       `
-    'Z', 0, 0, 0, 0, '_', 0,
-
-    // alpha-lower
-    'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
-    'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y',
-    //   {  |  }
-    'z', 0, 0, 0, '~'};
-
-/*
-    encode_form  : 0-9 a-zA-Z *-._~
-    https://url.spec.whatwg.org/#application-x-www-form-urlencoded-percent-encode-set
-
-    application/x-www-form-urlencoded = percent-encode
-                                        except: alpha | digit | "*" | "-" |
-                                                "." | "_"
-
-    parcent-encode              = component-percent-encode |
-                                  "!" | "'" | "(" | ")" | "~"
-
-    component-percent-encode    = userinfo-percent-encode |
-                                  "$" | "%" | "&" | "+" | ","
-
-    userinfo-percent-encode     = path-percent-encode |
-                                  "/" | ":" | ";" | "=" | "@" | "[" | "\" |
-                                  "]" | "^" | "|"
-
-    path-percent-encode         = query-percent-encode |
-                                  "?" | "`" | "{" | "}"
-
-    query-percent-encode        = c0-control-percent-encode |
-                                  code-points-gt-7e-encode |
-                                  " " | '"' | "#" | "<" | ">"
-
-    c0-control-percent-encode   = 0x0 to 0x1F
-
-    code-points-gt-7e-encode    = greater than "~"
-
-
-    unreserved  = alpha | digit | mark
-
-    alpha       = "a" | "b" | "c" | "d" | "e" | "f" | "g" | "h" | "i" |
-                  "j" | "k" | "l" | "m" | "n" | "o" | "p" | "q" | "r" |
-                  "s" | "t" | "u" | "v" | "w" | "x" | "y" | "z"
-                  "A" | "B" | "C" | "D" | "E" | "F" | "G" | "H" | "I" |
-                  "J" | "K" | "L" | "M" | "N" | "O" | "P" | "Q" | "R" |
-                  "S" | "T" | "U" | "V" | "W" | "X" | "Y" | "Z"
-
-    digit       = "0" | "1" | "2" | "3" | "4" | "5" | "6" | "7" | "8" | "9"
-
-    mark        = *-._~
-*/
-static const unsigned char UNRESERVED_FORM[256] = {
-    //  ctrl-code: 0-31
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0,
-
-    // SP   !  "  #  $  %  &  \  (  )       +  ,            /
-    0, '+', 0, 0, 0, 0, 0, 0, 0, 0, 0, '*', 0, 0, '-', '.', 0,
-
-    // digit                                          :  ;  <  =  >  ?  @
-    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 0, 0, 0, 0, 0, 0, 0,
-
-    // alpha-upper
-    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O',
-    'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y',
-    //   [  \  ]  ^       `
-    'Z', 0, 0, 0, 0, '_', 0,
-
-    // alpha-lower
-    'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
-    'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y',
-    //   {  |  }
-    'z', 0, 0, 0, '~'};
-
-/*
-    RFC 2396    : 0-9 a-zA-Z !'()*-._~
-
-    unreserved  = alphanum | mark
-
-    mark        = "-" | "_" | "." | "!" | "~" | "*" | "'" | "(" | ")"
-
-    alphanum    = alpha | digit
-
-    alpha       = lowalpha | upalpha
-
-    lowalpha    = "a" | "b" | "c" | "d" | "e" | "f" | "g" | "h" | "i" |
-                  "j" | "k" | "l" | "m" | "n" | "o" | "p" | "q" | "r" |
-                  "s" | "t" | "u" | "v" | "w" | "x" | "y" | "z"
-
-    upalpha     = "A" | "B" | "C" | "D" | "E" | "F" | "G" | "H" | "I" |
-                  "J" | "K" | "L" | "M" | "N" | "O" | "P" | "Q" | "R" |
-                  "S" | "T" | "U" | "V" | "W" | "X" | "Y" | "Z"
-
-    digit       = "0" | "1" | "2" | "3" | "4" | "5" | "6" | "7" | "8" | "9"
-*/
-static const unsigned char UNRESERVED_2396[256] = {
-    //  ctrl-code: 0-31
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0,
-
-    // SP      "  #  $  %  &                       +  ,            /
-    0, 0, '!', 0, 0, 0, 0, 0, '\'', '(', ')', '*', 0, 0, '-', '.', 0,
-
-    // digit                                          :  ;  <  =  >  ?  @
-    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 0, 0, 0, 0, 0, 0, 0,
-
-    // alpha-upper
-    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O',
-    'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y',
-    //   [  \  ]  ^       `
-    'Z', 0, 0, 0, 0, '_', 0,
-
-    // alpha-lower
-    'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
-    'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y',
-    //   {  |  }
-    'z', 0, 0, 0, '~'};
-
-/*
-    RFC 3986    : 0-9 a-zA-Z -._~
-
-    unreserved  = alpha | digit | "-" | "." | "_" | "~"
-
-    alpha       = lowalpha | upalpha
-
-    lowalpha    = "a" | "b" | "c" | "d" | "e" | "f" | "g" | "h" | "i" |
-                  "j" | "k" | "l" | "m" | "n" | "o" | "p" | "q" | "r" |
-                  "s" | "t" | "u" | "v" | "w" | "x" | "y" | "z"
-
-    upalpha     = "A" | "B" | "C" | "D" | "E" | "F" | "G" | "H" | "I" |
-                  "J" | "K" | "L" | "M" | "N" | "O" | "P" | "Q" | "R" |
-                  "S" | "T" | "U" | "V" | "W" | "X" | "Y" | "Z"
-
-    digit       = "0" | "1" | "2" | "3" | "4" | "5" | "6" | "7" | "8" | "9"
-*/
-static const unsigned char UNRESERVED_3986[256] = {
-    //  ctrl-code: 0-31
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0,
-
-    // SP !  "  #  $  %  &  '  (  )  *  +  ,            /
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '-', '.', 0,
-
-    // digit
-    //                                                :  ;  <  =  >  ?  @
-    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 0, 0, 0, 0, 0, 0, 0,
-
-    // alpha-upper
-    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O',
-    'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y',
-    //   [  \  ]  ^       `
-    'Z', 0, 0, 0, 0, '_', 0,
-
-    // alpha-lower
-    'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
-    'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y',
-    //   {  |  }
-    'z', 0, 0, 0, '~'};
-
-/*
-    hex = 0-16
-    '0' = 48
-    '7' = 55
-    'A' = 65
-    'W' = 87
-    'a' = 97
-    uppercase:
-        '7' = 'A' - 10
-    lowercase:
-        'W' = 'a' - 10
-*/
-static const unsigned char DEC2HEX[16] = "0123456789ABCDEF";
-
-static const char HEX2DEC[256] = {
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    //  0  1  2  3  4  5  6  7  8  9
-    1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 0, 0, 0, 0, 0, 0, 0,
-    //  A   B   C   D   E   F
-    11, 12, 13, 14, 15, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    0, 0, 0, 0, 0, 0, 0, 0, 0,
-    //  a   b   c   d   e   f
-    11, 12, 13, 14, 15, 16};
-
-// %[hex][hex]*4
-#define CODEC_UTF8ENC_LEN 12
-#define CODEC_UTF8DEC_LEN 4
-
-static int encode_lua(lua_State *L, const unsigned char *tbl)
+/**
+ *  returns a scratch buffer that has at least size bytes.
+ *  the stack buffer is used for short strings, otherwise a userdata that is
+ *  released by the garbage collector is pushed onto the stack.
+ */
+static inline unsigned char *getbuf(lua_State *L, unsigned char *sbuf,
+                                    size_t size)
 {
-    size_t len            = 0;
-    unsigned char *src    = (unsigned char *)lauxh_checklstring(L, 1, &len);
-    unsigned char dest[3] = {'%', 0};
-    luaL_Buffer b         = {0};
+    if (size <= LUAL_BUFFERSIZE) {
+        return sbuf;
+    }
+    return lua_newuserdata(L, size);
+}
 
+static int encode_lua(lua_State *L, url_encode_type_e type,
+                      url_stats_func_e fn)
+{
+    size_t len         = 0;
+    unsigned char *src = (unsigned char *)lauxh_checklstring(L, 1, &len);
+    unsigned char sbuf[LUAL_BUFFERSIZE];
+    unsigned char *dest = NULL;
+    size_t n            = 0;
+    URL_STATS_START(t0);
+
+    // keep the valid percent-encoded sequences
+    if (lauxh_optboolean(L, 2, 0)) {
+        type |= URL_ENCODE_PRESERVE;
+    }
     lua_settop(L, 1);
-    luaL_buffinit(L, &b);
-    for (size_t i = 0; i < len; i++) {
-        unsigned char c          = *src;
-        unsigned char unreserved = tbl[c];
-        if (unreserved) {
-            luaL_addchar(&b, unreserved);
-        } else {
-            // *src >> 4 = *src / 16
-            dest[1] = DEC2HEX[c >> 4];
-            // *src & 0xf = *src % 16
-            dest[2] = DEC2HEX[c & 0xf];
-            luaL_addlstring(&b, (char *)dest, 3);
-        }
-        src++;
+    dest = getbuf(L, sbuf, URL_ENCODE_MAXLEN(len));
+    n    = url_encode(dest, src, len, type);
+    if (n == len && memcmp(dest, src, len) == 0) {
+        // returns the argument string that has no bytes to encode
+        lua_pushvalue(L, 1);
+    } else {
+        lua_pushlstring(L, (char *)dest, n);
     }
-
-    luaL_pushresult(&b);
+    URL_STATS_ADD(L, fn, t0, len, n, 0);
     return 1;
 }
 
 static int encode_uri_lua(lua_State *L)
 {
-    return encode_lua(L, UNRESERVED_URI);
+    return encode_lua(L, URL_ENCODE_URI, URL_STATS_ENCODE_URI);
 }
 static int encode_form_lua(lua_State *L)
 {
-    return encode_lua(L, UNRESERVED_FORM);
+    return encode_lua(L, URL_ENCODE_FORM, URL_STATS_ENCODE_FORM);
 }
 static int encode2396_lua(lua_State *L)
 {
-    return encode_lua(L, UNRESERVED_2396);
+    return encode_lua(L, URL_ENCODE_2396, URL_STATS_ENCODE_2396);
 }
 static int encode3986_lua(lua_State *L)
 {
-    return encode_lua(L, UNRESERVED_3986);
+    return encode_lua(L, URL_ENCODE_3986, URL_STATS_ENCODE_3986);
 }
 
-/*
-                hex: 0xf                 = 0-15      = 4bit
-    utf8 code-point: u+0000 ... u+10ffff = 0-1114111 = 21bit
-              ascii: u+0000 ... u+007f   = 0-127     = 7bit
-*/
-static int unicode_pt2utf8(luaL_Buffer *b, uint32_t cp)
+static int decode_lua(lua_State *L, url_decode_type_e type,
+                      url_stats_func_e fn)
 {
-    unsigned char dest[4] = {0};
-
-    // range: u+0000 ... u+007f
-    //   bit: 0xxx xxxx
-    if (cp < 0x80) {
-        luaL_addchar(b, cp);
+    size_t len         = 0;
+    unsigned char *src = (unsigned char *)lauxh_checklstring(L, 1, &len);
+    unsigned char sbuf[LUAL_BUFFERSIZE];
+    unsigned char *dest = NULL;
+    size_t epos         = 0;
+    ssize_t rv          = 0;
+    URL_STATS_START(t0);
+
+    // validate the decoded bytes as UTF-8
+    if (lauxh_optboolean(L, 2, 0)) {
+        type |= URL_DECODE_UTF8;
     }
-    // range: u+0080 ... u+07ff
-    //   bit: [110y yyyx]:0xc0
-    //        [10xx xxxx]:0x80
-    else if (cp < 0x800) {
-        dest[0] = 0xc0 | (cp >> 6);
-        dest[1] = 0x80 | (cp & 0x3f);
-        luaL_addlstring(b, (char *)dest, 2);
+    // copy the invalid '%' as it is
+    if (lauxh_optboolean(L, 3, 0)) {
+        type |= URL_DECODE_LENIENT;
     }
-    // range: u+d800 ... u+dfff use for surrogate pairs
-    else if (cp > 0xD7FF && cp < 0xE000) {
-        return -2;
+    lua_settop(L, 1);
+    dest = getbuf(L, sbuf, URL_DECODE_MAXLEN(len));
+    rv   = url_decode(dest, src, len, type, &epos);
+    if (rv < 0) {
+        lua_pushnil(L);
+        lua_pushinteger(L, epos + 1);
+        URL_STATS_ADD(L, fn, t0, len, 0, 1);
+        return 2;
     }
-    // range: u+0800 ... u+ffff
-    //   bit: [1110 yyyy]:0xe0
-    //        [10yx xxxx]:0x80
-    //        [10xx xxxx]:0x80
-    else if (cp < 0x10000) {
-        dest[0] = 0xe0 | (cp >> 12);
-        dest[1] = 0x80 | ((cp >> 6) & 0x3f);
-        dest[2] = 0x80 | (cp & 0x3f);
-        luaL_addlstring(b, (char *)dest, 3);
+    lua_pushlstring(L, (char *)dest, rv);
+    URL_STATS_ADD(L, fn, t0, len, rv, 0);
+    if (type & URL_DECODE_LENIENT) {
+        // number of the invalid '%'
+        lua_pushinteger(L, epos);
+        return 2;
     }
-    // range: u+10000 ... u+1FFFFF
-    //   bit: [1111 0yyy]:0xf0
-    //        [10yy xxxx]:0x80
-    //        [10xx xxxx]:0x80
-    //        [10xx xxxx]:0x80
-    //
-    // RFC 3629: UTF-8, characters from the U+0000..U+10FFFF
-    // else if( cp < 0x200000 ){
-    else if (cp < 0x110000) {
-        dest[0] = 0xf0 | (cp >> 18);
-        dest[1] = 0x80 | ((cp >> 12) & 0x3f);
-        dest[2] = 0x80 | ((cp >> 6) & 0x3f);
-        dest[3] = 0x80 | (cp & 0x3f);
-        luaL_addlstring(b, (char *)dest, 4);
+    return 1;
+}
+
+static int decode_uri_lua(lua_State *L)
+{
+    return decode_lua(L, URL_DECODE_URI, URL_STATS_DECODE_URI);
+}
+
+static int decode_form_lua(lua_State *L)
+{
+    return decode_lua(L, URL_DECODE_FORM, URL_STATS_DECODE_FORM);
+}
+
+static int decode_all_lua(lua_State *L)
+{
+    return decode_lua(L, URL_DECODE_ALL, URL_STATS_DECODE);
+}
+
+static int host_lua(lua_State *L, int to_ascii)
+{
+    size_t len         = 0;
+    unsigned char *src = (unsigned char *)lauxh_checklstring(L, 1, &len);
+    unsigned char sbuf[LUAL_BUFFERSIZE];
+    unsigned char *dest = NULL;
+    size_t epos         = 0;
+    ssize_t rv          = 0;
+    URL_STATS_START(t0);
+
+    lua_settop(L, 1);
+    if (to_ascii) {
+        dest = getbuf(L, sbuf, URL_HOST_ASCII_MAXLEN(len));
+        rv   = url_host_to_ascii(dest, src, len, &epos);
+    } else {
+        dest = getbuf(L, sbuf, URL_HOST_UNICODE_MAXLEN(len));
+        rv   = url_host_to_unicode(dest, src, len, &epos);
     }
-    /* UTF-8 now max 4 bytes
-    // range: u+200000 ... u+3FFFFFF
-    //   bit: [1111 10yy]:0xf8
-    //        [10yy xxxx]:0x80
-    //        [10xx xxxx]:0x80
-    //        [10xx xxxx]:0x80
-    //        [10xx xxxx]:0x80
-    else if( cp < 0x400000 ){
-        dest[0] = 0xf8 | ( cp >> 24 );
-        dest[1] = 0x80 | ( ( cp >> 18 ) & 0x3f );
-        dest[2] = 0x80 | ( ( cp >> 12 ) & 0x3f );
-        dest[3] = 0x80 | ( ( cp >> 6 ) & 0x3f );
-        dest[4] = 0x80 | ( cp & 0x3f );
-        luaL_addlstring(b, (char *)dest, 5);
+    if (rv < 0) {
+        lua_pushnil(L);
+        lua_pushinteger(L, epos + 1);
+        URL_STATS_ADD(L,
+                      to_ascii ? URL_STATS_HOST_TO_ASCII :
+                                 URL_STATS_HOST_TO_UNICODE,
+                      t0, len, 0, 1);
+        return 2;
     }
-    // range: u+4000000 ... u+7FFFFFFF
-    //   bit: [1111 110y]:0xfc
-    //        [10yy xxxx]:0x80
-    //        [10yy xxxx]:0x80
-    //        [10yy xxxx]:0x80
-    //        [10xx xxxx]:0x80
-    //        [10xx xxxx]:0x80
-    else if( cp < 0x800000 ){
-        dest[0] = 0xfc | ( cp >> 30 );
-        dest[1] = 0x80 | ( ( cp >> 24 ) & 0x3f );
-        dest[2] = 0x80 | ( ( cp >> 18 ) & 0x3f );
-        dest[3] = 0x80 | ( ( cp >> 12 ) & 0x3f );
-        dest[4] = 0x80 | ( ( cp >> 6 ) & 0x3f );
-        dest[5] = 0x80 | ( cp & 0x3f );
-        luaL_addlstring(b, (char *)dest, 6);
+    lua_pushlstring(L, (char *)dest, rv);
+    URL_STATS_ADD(L,
+                  to_ascii ? URL_STATS_HOST_TO_ASCII :
+                             URL_STATS_HOST_TO_UNICODE,
+                  t0, len, rv, 0);
+    return 1;
+}
+
+static int host_to_ascii_lua(lua_State *L)
+{
+    return host_lua(L, 1);
+}
+
+static int host_to_unicode_lua(lua_State *L)
+{
+    return host_lua(L, 0);
+}
+
+/**
+ *  data URL (RFC 2397)
+ *
+ *  dataurl    := "data:" [ mediatype ] [ ";base64" ] "," data
+ *  mediatype  := [ type "/" subtype ] *( ";" parameter )
+ */
+
+#define is_space(c) ((c) == ' ' || (c) == '\t')
+
+/**
+ *  trim the spaces of the token [*head, *tail)
+ */
+static inline void trim(const unsigned char *s, size_t *head, size_t *tail)
+{
+    while (*head < *tail && is_space(s[*head])) {
+        (*head)++;
     }
-    //*/
-    // invalid: code-point > 0x7FFFFFFF
-    else {
-        errno = ERANGE;
-        return -1;
+    while (*tail > *head && is_space(s[*tail - 1])) {
+        (*tail)--;
     }
+}
 
-    return 0;
+static inline void lowercase(unsigned char *s, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] >= 'A' && s[i] <= 'Z') {
+            s[i] |= 0x20;
+        }
+    }
 }
 
-typedef enum {
-    DECODE_ALL  = 0,
-    DECODE_URI  = 1,
-    DECODE_FORM = 2
-} decode_type_e;
-
-/*
-                   hex: 0xf                 = 0-15  = 4bit
-    unicode code-point: u+0000 ... u+10ffff = 21bit
-                 ascii: u+0000 ... u+007f   = 0-127 = 7bit
-*/
-static int decode(lua_State *L, char *str, size_t slen, decode_type_e dectype)
+/**
+ *  returns 1 if the token [head, tail) equals to the lowercase word
+ *  case-insensitively
+ */
+static inline int token_eq(const unsigned char *s, size_t head, size_t tail,
+                           const char *word, size_t len)
 {
-    luaL_Buffer b = {0};
+    trim(s, &head, &tail);
+    if (tail - head != len) {
+        return 0;
+    }
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = s[head + i];
 
-    luaL_buffinit(L, &b);
+        if (c >= 'A' && c <= 'Z') {
+            c |= 0x20;
+        }
+        if (c != word[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
 
-    for (size_t i = 0; i < slen; i++) {
-        unsigned char *src = (unsigned char *)str + i;
-        if (*src != '%') {
-            if (dectype == DECODE_FORM && *src == '+') {
-                luaL_addchar(&b, ' ');
-            } else {
-                luaL_addchar(&b, *src);
-            }
-            continue;
+/**
+ *  push the mediatype and the parameters table (or nil) of the decoded
+ *  header
+ */
+static void push_mediatype(lua_State *L, unsigned char *hdr, size_t len)
+{
+    size_t cur  = 0;
+    size_t head = 0;
+    size_t tail = 0;
+    int omitted = 0;
+    int nparam  = 0;
+
+    // mediatype
+    while (cur < len && hdr[cur] != ';') {
+        cur++;
+    }
+    tail = cur;
+    trim(hdr, &head, &tail);
+    lowercase(hdr + head, tail - head);
+    if (head == tail) {
+        omitted = 1;
+        lua_pushliteral(L, "text/plain");
+    } else {
+        lua_pushlstring(L, (char *)hdr + head, tail - head);
+    }
+
+    // parameters: *( ";" attribute "=" value )
+    lua_pushnil(L);
+    while (cur < len) {
+        size_t eq    = 0;
+        size_t vhead = 0;
+        size_t vtail = 0;
+
+        // skip ';'
+        head = ++cur;
+        while (cur < len && hdr[cur] != ';') {
+            cur++;
         }
-        // percent-encoding(%hex) must have more than 2 byte strings after '%'.
-        else if (slen < i + 2) {
-            lua_pushnil(L);
-            lua_pushinteger(L, i + 1);
-            return 2;
+        for (eq = head; eq < cur && hdr[eq] != '='; eq++) {
         }
-        /*
-            hex(8bit) to decimal
-            e.g.
-                hex:'%41'
-                '4' to hex:0x04[0000 0100]
-                '1' to hex:0x01[0000 0001]
-                0x04[0000 0100] << 4bit
-                0x40[0100 0000] | 0x01[0000 0001]
-                0x41[0100 0001]
-                0x41 = 65 = 'A'
-
-                hex:'%7a'
-                '7' to hex:0x07[0000 0111]
-                'a' to hex:0x0a[0000 1010]
-                0x07[0000 0111] << 4bit
-                0x70[0111 0000] | 0x0a[0000 1010]
-                0x7a[0111 1010]
-                0x7a:122 = 'z'
-
-                hex:'%7a4'
-                '7' to hex:0x07[0000 0111]
-                'a' to hex:0x0a[0000 1010]
-                '4' to hex:0x04[0000 0100]
-                0x007[0000 0000 0111] << 8bit
-                0x00a[0000 0000 1010] << 4bit
-                0x70[0111 0000 0000] | [0000 1010 0000] | 0x04[0000 0100]
-                0x7a4[0111 1010 0100] = 1956
-        */
-        // %[hex]*2
-        else if (HEX2DEC[src[1]] && HEX2DEC[src[2]]) {
-            /*
-                hi = HEX2DEC( src[1] )-1  << 4;
-                lo = HEX2DEC( src[2] )-1;
-                hl = hi | lo;
-            */
-            uint32_t hl = ((HEX2DEC[src[1]] - 1) << 4) | (HEX2DEC[src[2]] - 1);
-
-            // decodeURI did not decode the following characters: '#$&+,/:;=?@'
-            if (dectype == DECODE_URI) {
-                switch (hl) {
-                case '#':
-                case '$':
-                case '&':
-                case '+':
-                case ',':
-                case '/':
-                case ':':
-                case ';':
-                case '=':
-                case '?':
-                case '@':
-                    luaL_addlstring(&b, (char *)src, 3);
-                    i += 2;
-                    continue;
-                }
-            }
-            luaL_addchar(&b, hl);
-            i += 2;
+        // ignore the parameter without value or name
+        if (eq == cur) {
             continue;
         }
-        // %u[hex]*4
-        else if (src[1] == 'u' && HEX2DEC[src[2]] && HEX2DEC[src[3]] &&
-                 HEX2DEC[src[4]] && HEX2DEC[src[5]]) {
-            uint32_t hi = (HEX2DEC[src[2]] - 1) << 4 | (HEX2DEC[src[3]] - 1);
-            uint32_t lo = (HEX2DEC[src[4]] - 1) << 4 | (HEX2DEC[src[5]] - 1);
-            uint32_t hl = (hi << 8) | lo;
-
-            switch (unicode_pt2utf8(&b, hl)) {
-            case 0:
-                i += 5;
-                continue;
-            case -2:
-                // surrogate pairs
-                if (src[6] == '%' && src[7] == 'u' && HEX2DEC[src[8]] &&
-                    HEX2DEC[src[9]] && HEX2DEC[src[10]] && HEX2DEC[src[11]]) {
-                    size_t surp = 0x10000 + (hl - 0xD800) * 0x400;
-
-                    hi = (HEX2DEC[src[8]] - 1) << 4 | (HEX2DEC[src[9]] - 1);
-                    lo = (HEX2DEC[src[10]] - 1) << 4 | (HEX2DEC[src[11]] - 1);
-                    surp += ((hi << 8) | lo) - 0xDC00;
-                    if (unicode_pt2utf8(&b, surp) == 0) {
-                        i += 11;
-                        continue;
-                    }
-                }
-            }
+        vhead = eq + 1;
+        vtail = cur;
+        trim(hdr, &head, &eq);
+        trim(hdr, &vhead, &vtail);
+        if (head == eq) {
+            continue;
         }
-        lua_pushnil(L);
-        lua_pushinteger(L, i + 1);
-        return 2;
+        // unquote the quoted-string
+        if (vtail - vhead >= 2 && hdr[vhead] == '"' && hdr[vtail - 1] == '"') {
+            vhead++;
+            vtail--;
+        }
+        if (!nparam++) {
+            lua_createtable(L, 0, 1);
+            lua_replace(L, -2);
+        }
+        lowercase(hdr + head, eq - head);
+        // the first one is used if the attribute is duplicated
+        lua_pushlstring(L, (char *)hdr + head, eq - head);
+        lua_rawget(L, -2);
+        if (lua_isnil(L, -1)) {
+            lua_pushlstring(L, (char *)hdr + head, eq - head);
+            lua_pushlstring(L, (char *)hdr + vhead, vtail - vhead);
+            lua_rawset(L, -4);
+        }
+        lua_pop(L, 1);
     }
 
-    luaL_pushresult(&b);
-    return 1;
+    // the default of the omitted mediatype is "text/plain;charset=US-ASCII"
+    if (omitted && !nparam) {
+        lua_createtable(L, 0, 1);
+        lauxh_pushlstr2tbl(L, "charset", "US-ASCII", 8);
+        lua_replace(L, -2);
+    }
 }
 
-static int decode_uri_lua(lua_State *L)
+static int decode_data_lua(lua_State *L)
 {
-    size_t len      = 0;
-    const char *src = lauxh_checklstring(L, 1, &len);
+    size_t len         = 0;
+    unsigned char *src = (unsigned char *)lauxh_checklstring(L, 1, &len);
+    unsigned char sbuf[LUAL_BUFFERSIZE];
+    unsigned char hbuf[LUAL_BUFFERSIZE];
+    unsigned char *hdr  = NULL;
+    unsigned char *dest = NULL;
+    size_t head         = 5;
+    size_t tail         = 0;
+    size_t comma        = 0;
+    size_t epos         = 0;
+    size_t dlen         = 0;
+    ssize_t hlen        = 0;
+    ssize_t rv          = 0;
+    int is_base64       = 0;
+    URL_STATS_START(t0);
 
     lua_settop(L, 1);
-    return decode(L, (char *)src, len, DECODE_URI);
-}
-
-static int decode_form_lua(lua_State *L)
-{
-    size_t len      = 0;
-    const char *src = lauxh_checklstring(L, 1, &len);
+    // "data:" scheme
+    if (len < 5 || !token_eq(src, 0, 5, "data:", 5)) {
+        lua_pushnil(L);
+        lua_pushinteger(L, 1);
+        URL_STATS_ADD(L, URL_STATS_DECODE_DATA, t0, len, 0, 1);
+        return 2;
+    }
+    // drop the fragment
+    for (tail = head; tail < len && src[tail] != '#'; tail++) {
+    }
+    for (comma = head; comma < tail && src[comma] != ','; comma++) {
+    }
+    if (comma == tail) {
+        // no data
+        epos = tail;
+        goto FAIL;
+    }
 
-    lua_settop(L, 1);
-    return decode(L, (char *)src, len, DECODE_FORM);
-}
+    // ";base64" extension at the end of the header
+    for (size_t i = comma; i > head; i--) {
+        if (src[i - 1] == ';') {
+            if (token_eq(src, i, comma, "base64", 6)) {
+                is_base64 = 1;
+                comma     = i - 1;
+            }
+            break;
+        }
+    }
+    // percent-decoded header
+    hdr  = getbuf(L, hbuf, URL_DECODE_MAXLEN(comma - head));
+    hlen = url_decode(hdr, src + head, comma - head, URL_DECODE_ALL, &epos);
+    if (hlen < 0) {
+        epos += head;
+        goto FAIL;
+    }
+    if (is_base64) {
+        // skip ";base64"
+        while (src[comma] != ',') {
+            comma++;
+        }
+    }
 
-static int decode_lua(lua_State *L)
-{
-    size_t len      = 0;
-    const char *src = lauxh_checklstring(L, 1, &len);
+    // data
+    head = comma + 1;
+    dlen = tail - head;
+    dest = getbuf(L, sbuf, URL_DECODE_BASE64_MAXLEN(dlen));
+    if (!is_base64) {
+        rv = url_decode(dest, src + head, dlen, URL_DECODE_ALL, &epos);
+    } else if (!memchr(src + head, '%', dlen)) {
+        rv = url_decode_base64(dest, src + head, dlen, &epos);
+    } else if ((rv = url_decode(dest, src + head, dlen, URL_DECODE_ALL,
+                                &epos)) >= 0) {
+        // decode the percent-decoded base64 in place. the position of the
+        // error is the head of the data
+        rv   = url_decode_base64(dest, dest, rv, &epos);
+        epos = 0;
+    }
+    if (rv < 0) {
+        epos += head;
+        goto FAIL;
+    }
 
-    lua_settop(L, 1);
-    return decode(L, (char *)src, len, DECODE_ALL);
+    push_mediatype(L, hdr, hlen);
+    lua_pushlstring(L, (char *)dest, rv);
+    lua_insert(L, -3);
+    URL_STATS_ADD(L, URL_STATS_DECODE_DATA, t0, len, rv, 0);
+    return 3;
+
+FAIL:
+    lua_pushnil(L);
+    lua_pushinteger(L, epos + 1);
+    URL_STATS_ADD(L, URL_STATS_DECODE_DATA, t0, len, 0, 1);
+    return 2;
 }
 
+#undef is_space
+
 LUALIB_API int luaopen_url_codec(lua_State *L)
 {
     struct luaL_Reg method[] = {
-        {"encode_uri",  encode_uri_lua },
-        {"encode_form", encode_form_lua},
-        {"encode2396",  encode2396_lua },
-        {"encode3986",  encode3986_lua },
-        {"decode_uri",  decode_uri_lua },
-        {"decode_form", decode_form_lua},
-        {"decode",      decode_lua     },
-        {NULL,          NULL           }
+        {"encode_uri",      encode_uri_lua     },
+        {"encode_form",     encode_form_lua    },
+        {"encode2396",      encode2396_lua     },
+        {"encode3986",      encode3986_lua     },
+        {"decode_uri",      decode_uri_lua     },
+        {"decode_form",     decode_form_lua    },
+        {"decode",          decode_all_lua     },
+        {"host_to_ascii",   host_to_ascii_lua  },
+        {"host_to_unicode", host_to_unicode_lua},
+        {"decode_data",     decode_data_lua    },
+#ifdef URL_STATS
+        {"stats",           url_stats_lua      },
+        {"stats_reset",     url_stats_reset_lua},
+#endif
+        {NULL,              NULL               }
     };
     int i;
 
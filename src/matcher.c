@@ -0,0 +1,150 @@
+/**
+ *  Copyright (C) 2017 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *
+ *  src/matcher.c
+ *  lua-url
+ *
+ */
+
+// depend
+#include "lauxhlib.h"
+// lua
+#include <lauxlib.h>
+// lua-url
+#include "url.h"
+// system
+#include <errno.h>
+#include <string.h>
+
+#define MODULE_MT "url.matcher"
+
+typedef struct {
+    url_matcher_t *m;
+} matcher_t;
+
+static int match_lua(lua_State *L)
+{
+    matcher_t *m    = luaL_checkudata(L, 1, MODULE_MT);
+    size_t len      = 0;
+    const char *url = lauxh_checklstring(L, 2, &len);
+    uint32_t id = url_matcher_match(m->m, (const unsigned char *)url, len);
+
+    if (id) {
+        lua_pushinteger(L, id);
+    } else {
+        lua_pushnil(L);
+    }
+    return 1;
+}
+
+static int tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, MODULE_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int gc_lua(lua_State *L)
+{
+    matcher_t *m = lua_touserdata(L, 1);
+
+    url_matcher_free(m->m);
+    m->m = NULL;
+    return 0;
+}
+
+static int new_lua(lua_State *L)
+{
+    size_t nrule = 0;
+    matcher_t *m = NULL;
+
+    lauxh_checktable(L, 1);
+    nrule = lauxh_rawlen(L, 1);
+    if (nrule > UINT32_MAX) {
+        return lauxh_argerror(L, 1, "too many rules");
+    }
+
+    lua_settop(L, 1);
+    m = lua_newuserdata(L, sizeof(matcher_t));
+    if (!(m->m = url_matcher_new())) {
+        return luaL_error(L, "failed to create matcher: %s", strerror(errno));
+    }
+    lauxh_setmetatable(L, MODULE_MT);
+
+    // rule id is the index of the rules
+    for (size_t i = 1; i <= nrule; i++) {
+        size_t len       = 0;
+        const char *rule = NULL;
+
+        lua_rawgeti(L, 1, i);
+        if (!lauxh_isstring(L, -1)) {
+            return lauxh_argerror(L, 1, "rules#%d must be string", (int)i);
+        }
+        rule = lua_tolstring(L, -1, &len);
+        if (url_matcher_add(m->m, (const unsigned char *)rule, len, i)) {
+            if (errno == EINVAL) {
+                return lauxh_argerror(L, 1, "rules#%d is invalid: %s", (int)i,
+                                      rule);
+            }
+            return luaL_error(L, "failed to add rules#%d: %s", (int)i,
+                              strerror(errno));
+        }
+        lua_pop(L, 1);
+    }
+
+    return 1;
+}
+
+LUALIB_API int luaopen_url_matcher(lua_State *L)
+{
+    struct luaL_Reg mmethod[] = {
+        {"__gc",       gc_lua      },
+        {"__tostring", tostring_lua},
+        {NULL,         NULL        }
+    };
+    struct luaL_Reg method[] = {
+        {"match", match_lua},
+        {NULL,    NULL     }
+    };
+    int i;
+
+    // create metatable
+    luaL_newmetatable(L, MODULE_MT);
+    // metamethods
+    i = 0;
+    while (mmethod[i].name) {
+        lauxh_pushfn2tbl(L, mmethod[i].name, mmethod[i].func);
+        i++;
+    }
+    // methods
+    lua_pushstring(L, "__index");
+    lua_newtable(L);
+    i = 0;
+    while (method[i].name) {
+        lauxh_pushfn2tbl(L, method[i].name, method[i].func);
+        i++;
+    }
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+
+    lua_pushcfunction(L, new_lua);
+    return 1;
+}
@@ -0,0 +1,289 @@
+/**
+ *  Copyright (C) 2017 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *
+ *  src/parse_target.c
+ *  lua-url
+ *
+ *  parse the request-target of the HTTP request line in the origin-form,
+ *  the absolute-form, the authority-form and the asterisk-form of RFC 9112.
+ */
+
+// depend
+#include "lauxhlib.h"
+// lua
+#include <lauxlib.h>
+// lua-url
+#include "url.h"
+// system
+#include <string.h>
+
+typedef enum {
+    FORM_NONE      = 0,
+    FORM_ORIGIN    = 1,
+    FORM_ABSOLUTE  = 2,
+    FORM_AUTHORITY = 3,
+    FORM_ASTERISK  = 4,
+    NFORM          = 5
+} form_e;
+
+static const char *const FORMS[NFORM] = {
+    [FORM_ORIGIN]    = "origin",
+    [FORM_ABSOLUTE]  = "absolute",
+    [FORM_AUTHORITY] = "authority",
+    [FORM_ASTERISK]  = "asterisk",
+};
+
+// fields of the Host header value
+#define HOST_FIELDS                                                            \
+    ((1 << URL_HOST) | (1 << URL_HOSTNAME) | (1 << URL_PORT))
+
+/**
+ *  RFC 9110
+ *  tchar = "!" / "#" / "$" / "%" / "&" / "'" / "*" / "+" / "-" / "." /
+ *          "^" / "_" / "`" / "|" / "~" / DIGIT / ALPHA
+ */
+static const unsigned char TCHAR[256] = {
+    ['!'] = 1, ['#'] = 1, ['$'] = 1, ['%'] = 1, ['&'] = 1, ['\''] = 1,
+    ['*'] = 1, ['+'] = 1, ['-'] = 1, ['.'] = 1, ['^'] = 1, ['_'] = 1,
+    ['`'] = 1, ['|'] = 1, ['~'] = 1, ['0'] = 1, ['1'] = 1, ['2'] = 1,
+    ['3'] = 1, ['4'] = 1, ['5'] = 1, ['6'] = 1, ['7'] = 1, ['8'] = 1,
+    ['9'] = 1, ['A'] = 1, ['B'] = 1, ['C'] = 1, ['D'] = 1, ['E'] = 1,
+    ['F'] = 1, ['G'] = 1, ['H'] = 1, ['I'] = 1, ['J'] = 1, ['K'] = 1,
+    ['L'] = 1, ['M'] = 1, ['N'] = 1, ['O'] = 1, ['P'] = 1, ['Q'] = 1,
+    ['R'] = 1, ['S'] = 1, ['T'] = 1, ['U'] = 1, ['V'] = 1, ['W'] = 1,
+    ['X'] = 1, ['Y'] = 1, ['Z'] = 1, ['a'] = 1, ['b'] = 1, ['c'] = 1,
+    ['d'] = 1, ['e'] = 1, ['f'] = 1, ['g'] = 1, ['h'] = 1, ['i'] = 1,
+    ['j'] = 1, ['k'] = 1, ['l'] = 1, ['m'] = 1, ['n'] = 1, ['o'] = 1,
+    ['p'] = 1, ['q'] = 1, ['r'] = 1, ['s'] = 1, ['t'] = 1, ['u'] = 1,
+    ['v'] = 1, ['w'] = 1, ['x'] = 1, ['y'] = 1, ['z'] = 1,
+};
+
+static inline int is_digit(unsigned char c)
+{
+    return '0' <= c && c <= '9';
+}
+
+static inline int is_method(const char *str, size_t len, const char *method)
+{
+    return len == strlen(method) && memcmp(str, method, len) == 0;
+}
+
+static inline void push_fields(lua_State *L, const char *src, url_t *u,
+                               uint32_t mask)
+{
+    for (int i = 0; i < URL_NFIELD; i++) {
+        if (u->fields & mask & (1 << i)) {
+            lauxh_pushlstr2tbl(L, URL_FIELD_NAMES[i], src + u->span[i].head,
+                               u->span[i].len);
+        }
+    }
+}
+
+// push the illegal byte at the position, or "eof" if the request-target ends
+// unexpectedly
+static inline int push_error(lua_State *L, const char *src, size_t len,
+                             size_t pos)
+{
+    lua_pushinteger(L, pos);
+    if (pos < len) {
+        lua_pushlstring(L, src + pos, 1);
+    } else {
+        lua_pushliteral(L, "eof");
+    }
+    return 3;
+}
+
+/**
+ *  parse the authority-form "host:port" in url[head, tail).
+ *  returns 0 on success, or 1 and sets the position of the illegal byte to
+ *  u->cur. the userinfo is not allowed, and the port is required.
+ */
+static int parse_authority_form(url_t *u, const unsigned char *url,
+                                size_t head, size_t tail)
+{
+    if (url_parse_hostport(u, url, tail, head)) {
+        return 1;
+    } else if (u->fields & (1 << URL_USERINFO)) {
+        u->cur = head;
+        return 1;
+    } else if (u->cur != tail || !(u->fields & (1 << URL_HOSTNAME)) ||
+               !u->span[URL_HOSTNAME].len || !(u->fields & (1 << URL_PORT)) ||
+               !u->span[URL_PORT].len) {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ *  parse the origin-form or the absolute-form in url[head, tail).
+ *  returns 0 on success, or 1 and sets the position of the illegal byte to
+ *  u->cur. the fragment is not allowed in the request-target.
+ */
+static int parse_uri_form(url_t *u, const unsigned char *url, size_t head,
+                          size_t tail, int origin)
+{
+    if (origin && url[head + 1] == '/') {
+        // absolute-path = 1*( "/" segment ), and "//" is the authority
+        u->fields = 0;
+        u->cur    = head + 1;
+        return 1;
+    } else if (url_parse(u, url, tail, head, 0)) {
+        return 1;
+    } else if (u->fields & (1 << URL_FRAGMENT)) {
+        u->cur = u->span[URL_FRAGMENT].head - 1;
+        return 1;
+    } else if (!origin && !(u->fields & (1 << URL_SCHEME))) {
+        // absolute-form requires the scheme
+        u->cur = head;
+        return 1;
+    }
+    return 0;
+}
+
+static int parse_target_lua(lua_State *L)
+{
+    size_t len         = 0;
+    const char *src    = lauxh_checklstring(L, 1, &len);
+    size_t cur         = lauxh_optuint64(L, 2, 0);
+    size_t hlen        = 0;
+    const char *host   = lauxh_optlstring(L, 3, NULL, &hlen);
+    const char *scheme = lauxh_optstring(L, 4, "http");
+    const unsigned char *url = (const unsigned char *)src;
+    form_e form              = FORM_NONE;
+    size_t head              = 0;
+    size_t tail              = 0;
+    int has_method           = 0;
+    int is_connect           = 0;
+    int is_options           = 0;
+    int rv                   = 0;
+    url_t u                  = {0};
+
+    if (cur > len) {
+        cur = len;
+    }
+    lua_settop(L, 4);
+    lua_newtable(L);
+
+    // method SP
+    for (tail = cur; tail < len && TCHAR[url[tail]]; tail++) {
+    }
+    if (tail > cur && tail < len && url[tail] == ' ') {
+        is_connect = is_method(src + cur, tail - cur, "CONNECT");
+        is_options = is_method(src + cur, tail - cur, "OPTIONS");
+        has_method = 1;
+        lauxh_pushlstr2tbl(L, "method", src + cur, tail - cur);
+        cur = tail + 1;
+    }
+
+    // the request-target ends at the SP or the control character, that are
+    // not allowed in the target and stop the parser as the NUL byte
+    head = cur;
+    for (tail = head; tail < len && url[tail] > 0x20; tail++) {
+    }
+
+    if (head == tail) {
+        // empty request-target
+        rv    = 1;
+        u.cur = head;
+    } else if (url[head] == '/') {
+        form = FORM_ORIGIN;
+        rv   = parse_uri_form(&u, url, head, tail, 1);
+    } else if (tail - head == 1 && url[head] == '*') {
+        form  = FORM_ASTERISK;
+        u.cur = tail;
+        // asterisk-form is used only for the OPTIONS request
+        if (has_method && !is_options) {
+            rv    = 1;
+            u.cur = head;
+        }
+    } else if (is_connect) {
+        // authority-form is used only for the CONNECT request
+        form = FORM_AUTHORITY;
+        rv   = parse_authority_form(&u, url, head, tail);
+    } else if (!has_method && !parse_authority_form(&u, url, head, tail)) {
+        form = FORM_AUTHORITY;
+    } else {
+        form = FORM_ABSOLUTE;
+        rv   = parse_uri_form(&u, url, head, tail, 0);
+    }
+    if (!rv && is_connect && form != FORM_AUTHORITY) {
+        // CONNECT requires the authority-form
+        rv    = 1;
+        u.cur = head;
+    }
+    push_fields(L, src, &u, ~0);
+    if (form) {
+        lauxh_pushlstr2tbl(L, "form", FORMS[form], strlen(FORMS[form]));
+    }
+    if (rv) {
+        return push_error(L, src, len, u.cur);
+    }
+
+    // SP HTTP-version
+    cur = tail;
+    if (has_method && cur < len && url[cur] == ' ') {
+        // HTTP-version = "HTTP/" DIGIT "." DIGIT
+        if (len - cur < 9 || memcmp(src + cur + 1, "HTTP/", 5) != 0 ||
+            !is_digit(url[cur + 6]) || url[cur + 7] != '.' ||
+            !is_digit(url[cur + 8])) {
+            return push_error(L, src, len, cur + 1);
+        }
+        lauxh_pushlstr2tbl(L, "version", src + cur + 6, 3);
+        cur += 9;
+    }
+
+    // effective request URI of the origin-form and the asterisk-form
+    if (host && (form == FORM_ORIGIN || form == FORM_ASTERISK)) {
+        url_t h = {0};
+
+        if (url_parse_hostport(&h, (const unsigned char *)host, hlen, 0) ||
+            h.cur != hlen) {
+            // invalid Host header value
+            lua_pushinteger(L, h.cur);
+            lua_pushliteral(L, "host");
+            return 3;
+        } else if ((h.fields & (1 << URL_USERINFO)) ||
+                   !(h.fields & (1 << URL_HOSTNAME)) ||
+                   !h.span[URL_HOSTNAME].len) {
+            // Host = uri-host [ ":" port ]
+            lua_pushinteger(L, 0);
+            lua_pushliteral(L, "host");
+            return 3;
+        }
+        lauxh_pushlstr2tbl(L, "scheme", scheme, strlen(scheme));
+        push_fields(L, host, &h, HOST_FIELDS);
+    }
+
+    lua_pushinteger(L, cur);
+    if (cur < len) {
+        // the byte that follows the request-target (e.g. CR)
+        lua_pushlstring(L, src + cur, 1);
+        return 3;
+    }
+    return 2;
+}
+
+LUALIB_API int luaopen_url_parse_target(lua_State *L)
+{
+    lua_pushcfunction(L, parse_target_lua);
+    return 1;
+}
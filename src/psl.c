@@ -0,0 +1,191 @@
+/**
+ *  Copyright (C) 2017 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *
+ *  src/psl.c
+ *  lua-url
+ *
+ *  registrable domain extraction with the compiled Public Suffix List.
+ */
+
+
+// depend
+#include "lauxhlib.h"
+// lua
+#include <lauxlib.h>
+// lua-url
+#include "url.h"
+// system
+#include <errno.h>
+#include <string.h>
+
+#define MODULE_MT "url.psl"
+
+// the host names longer than this are converted in the heap
+#define HOST_BUFSIZ 253
+// every byte of the ASCII form is converted from at most 12 bytes of the
+// source (the percent-encoded 4-byte UTF-8 sequence), so that the longer
+// source (and the trailing dot) never fits in the host name of 253 bytes
+#define HOST_SRC_MAXLEN (HOST_BUFSIZ * 12 + 1)
+
+typedef struct {
+    url_psl_t *psl;
+} psl_t;
+
+/**
+ *  push the public suffix, or the registrable domain if domain is true, of
+ *  the host name in the ASCII form.
+ */
+static int lookup_lua(lua_State *L, int domain)
+{
+    psl_t *p         = luaL_checkudata(L, 1, MODULE_MT);
+    size_t len       = 0;
+    const char *host = lauxh_checklstring(L, 2, &len);
+    unsigned char sbuf[URL_HOST_ASCII_MAXLEN(HOST_BUFSIZ)];
+    unsigned char *buf = sbuf;
+    size_t suffix      = 0;
+    size_t head        = 0;
+    size_t epos        = 0;
+    ssize_t n          = 0;
+
+    lua_settop(L, 2);
+    if (len > HOST_SRC_MAXLEN) {
+        // too long host name
+        lua_pushnil(L);
+        return 1;
+    } else if (len > HOST_BUFSIZ) {
+        buf = lua_newuserdata(L, URL_HOST_ASCII_MAXLEN(len));
+    }
+    // the labels are lowercased and the internationalized labels are
+    // converted to the punycode as well as the rules
+    n = url_host_to_ascii(buf, (const unsigned char *)host, len, &epos);
+    if (n < 0) {
+        lua_pushnil(L);
+        lua_pushinteger(L, epos + 1);
+        return 2;
+    } else if ((n = url_psl_lookup(p->psl, buf, n, &suffix, &head)) < 0 ||
+               (domain && head == (size_t)n)) {
+        // IP address, empty label or the host itself is the public suffix
+        lua_pushnil(L);
+        return 1;
+    }
+    if (!domain) {
+        head = suffix;
+    }
+    lua_pushlstring(L, (const char *)buf + head, n - head);
+    return 1;
+}
+
+static int registrable_domain_lua(lua_State *L)
+{
+    return lookup_lua(L, 1);
+}
+
+static int public_suffix_lua(lua_State *L)
+{
+    return lookup_lua(L, 0);
+}
+
+static int len_lua(lua_State *L)
+{
+    psl_t *p = luaL_checkudata(L, 1, MODULE_MT);
+
+    lua_pushinteger(L, url_psl_len(p->psl));
+    return 1;
+}
+
+static int tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, MODULE_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int gc_lua(lua_State *L)
+{
+    psl_t *p = lua_touserdata(L, 1);
+
+    url_psl_free(p->psl);
+    p->psl = NULL;
+    return 0;
+}
+
+static int load_lua(lua_State *L)
+{
+    const char *pathname = lauxh_checkstring(L, 1);
+    psl_t *p             = NULL;
+    size_t eline         = 0;
+
+    lua_settop(L, 1);
+    p  = lua_newuserdata(L, sizeof(psl_t));
+    *p = (psl_t){0};
+    lauxh_setmetatable(L, MODULE_MT);
+    if (!(p->psl = url_psl_new())) {
+        return luaL_error(L, "failed to create psl: %s", strerror(errno));
+    } else if (url_psl_load(p->psl, pathname, &eline)) {
+        lua_pushnil(L);
+        if (eline) {
+            lua_pushfstring(L, "%s:%d: %s", pathname, (int)eline,
+                            strerror(errno));
+        } else {
+            lua_pushfstring(L, "%s: %s", pathname, strerror(errno));
+        }
+        return 2;
+    }
+    return 1;
+}
+
+LUALIB_API int luaopen_url_psl(lua_State *L)
+{
+    struct luaL_Reg mmethod[] = {
+        {"__gc",       gc_lua      },
+        {"__tostring", tostring_lua},
+        {NULL,         NULL        }
+    };
+    struct luaL_Reg method[] = {
+        {"registrable_domain", registrable_domain_lua},
+        {"public_suffix",      public_suffix_lua     },
+        {"len",                len_lua               },
+        {NULL,                 NULL                  }
+    };
+    int i;
+
+    // create metatable
+    luaL_newmetatable(L, MODULE_MT);
+    // metamethods
+    i = 0;
+    while (mmethod[i].name) {
+        lauxh_pushfn2tbl(L, mmethod[i].name, mmethod[i].func);
+        i++;
+    }
+    // methods
+    lua_pushstring(L, "__index");
+    lua_newtable(L);
+    i = 0;
+    while (method[i].name) {
+        lauxh_pushfn2tbl(L, method[i].name, method[i].func);
+        i++;
+    }
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+
+    lua_pushcfunction(L, load_lua);
+    return 1;
+}
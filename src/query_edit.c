@@ -0,0 +1,362 @@
+/**
+ *  Copyright (C) 2017 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *
+ *  src/query_edit.c
+ *  lua-url
+ *
+ *  remove, replace or append the query parameters of the url without the
+ *  parse/format round-trip. the untouched pairs are copied verbatim.
+ */
+
+// depend
+#include "lauxhlib.h"
+// lua
+#include <lauxlib.h>
+// lua-url
+#include "url.h"
+// system
+#include <stdlib.h>
+#include <string.h>
+
+// size of the scratch buffer on the stack for the edits and the pairs
+#define NSTACK_SCRATCH 2048
+
+typedef struct {
+    // decoded key
+    const char *key;
+    size_t klen;
+    // encoded "key=val&key=val" pairs, or empty to remove the key
+    const char *pairs;
+    size_t plen;
+    // the key was found in the query or appended
+    int done;
+} edit_t;
+
+/**
+ *  compare the raw key of the query with the decoded key of the edit
+ *  without decoding the raw key into the buffer.
+ */
+static int cmp_raw_key(const unsigned char *raw, size_t rlen, int encoded,
+                       const edit_t *e)
+{
+    const unsigned char *key = (const unsigned char *)e->key;
+    size_t i                 = 0;
+    size_t k                 = 0;
+
+    if (!encoded) {
+        int rv = memcmp(raw, key, rlen < e->klen ? rlen : e->klen);
+        if (rv || rlen == e->klen) {
+            return rv;
+        }
+        return rlen < e->klen ? -1 : 1;
+    }
+
+    for (; i < rlen && k < e->klen; i++, k++) {
+        unsigned char c = raw[i];
+        if (c == '+') {
+            c = ' ';
+        } else if (c == '%') {
+            c = (url_unhex(raw[i + 1]) << 4) | url_unhex(raw[i + 2]);
+            i += 2;
+        }
+        if (c != key[k]) {
+            return c < key[k] ? -1 : 1;
+        }
+    }
+    if (i < rlen) {
+        return 1;
+    } else if (k < e->klen) {
+        return -1;
+    }
+    return 0;
+}
+
+static int cmp_edit(const void *a, const void *b)
+{
+    const edit_t *x = a;
+    const edit_t *y = b;
+    int rv = memcmp(x->key, y->key, x->klen < y->klen ? x->klen : y->klen);
+
+    if (rv || x->klen == y->klen) {
+        return rv;
+    }
+    return x->klen < y->klen ? -1 : 1;
+}
+
+static edit_t *find_edit(edit_t *edits, size_t nedit, const unsigned char *raw,
+                         size_t rlen, int encoded)
+{
+    size_t lo = 0;
+    size_t hi = nedit;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int rv     = cmp_raw_key(raw, rlen, encoded, edits + mid);
+        if (rv == 0) {
+            return edits + mid;
+        } else if (rv < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return NULL;
+}
+
+/**
+ *  returns the encoded length of the "key=val" pair, or 0 if the value at
+ *  vidx is false.
+ */
+static size_t pair_len(lua_State *L, int vidx, const char *key, size_t klen)
+{
+    size_t len = 0;
+
+    switch (lua_type(L, vidx)) {
+    case LUA_TBOOLEAN:
+        if (!lua_toboolean(L, vidx)) {
+            return 0;
+        }
+        // key only
+        return URL_ENCODE_MAXLEN(klen);
+
+    case LUA_TSTRING:
+    case LUA_TNUMBER:
+        lua_tolstring(L, vidx, &len);
+        return URL_ENCODE_MAXLEN(klen) + 1 + URL_ENCODE_MAXLEN(len);
+
+    default:
+        return lauxh_argerror(
+            L, 2, "edits.%s must be string, number, boolean or table", key);
+    }
+}
+
+static char *write_pair(lua_State *L, char *p, int vidx, const char *key,
+                        size_t klen)
+{
+    size_t len      = 0;
+    const char *val = NULL;
+
+    p += url_encode((unsigned char *)p, (const unsigned char *)key, klen,
+                    URL_ENCODE_FORM);
+    if (lua_type(L, vidx) != LUA_TBOOLEAN) {
+        val  = lua_tolstring(L, vidx, &len);
+        *p++ = '=';
+        p += url_encode((unsigned char *)p, (const unsigned char *)val, len,
+                        URL_ENCODE_FORM);
+    }
+    return p;
+}
+
+/**
+ *  returns the maximum length of the pairs of the edit at the top of the
+ *  stack. if p is not NULL, the pairs are written to p.
+ */
+static size_t encode_edit(lua_State *L, char *p, const char *key, size_t klen)
+{
+    int vidx     = lua_gettop(L);
+    char *head   = p;
+    size_t total = 0;
+
+    if (!lua_istable(L, vidx)) {
+        total = pair_len(L, vidx, key, klen);
+        if (p && total) {
+            return write_pair(L, p, vidx, key, klen) - head;
+        }
+        return total;
+    }
+
+    for (size_t i = 1, n = lauxh_rawlen(L, vidx); i <= n; i++) {
+        size_t len = 0;
+
+        lua_rawgeti(L, vidx, i);
+        if (!(len = pair_len(L, vidx + 1, key, klen))) {
+            lauxh_argerror(L, 2, "edits.%s#%d must not be false", key, (int)i);
+        } else if (p) {
+            if (p != head) {
+                *p++ = '&';
+            }
+            p = write_pair(L, p, vidx + 1, key, klen);
+        }
+        total += len + (i > 1);
+        lua_pop(L, 1);
+    }
+    return p ? (size_t)(p - head) : total;
+}
+
+static inline void add_delimiter(luaL_Buffer *b, int npair, int has_mark)
+{
+    if (npair) {
+        luaL_addchar(b, '&');
+    } else if (has_mark) {
+        luaL_addchar(b, '?');
+    }
+}
+
+static int query_edit_lua(lua_State *L)
+{
+    size_t len               = 0;
+    const char *src          = lauxh_checklstring(L, 1, &len);
+    const unsigned char *url = (const unsigned char *)src;
+    int is_querystring       = lauxh_optboolean(L, 3, 0);
+    edit_t sbuf[NSTACK_SCRATCH / sizeof(edit_t)];
+    void *scratch = sbuf;
+    edit_t *edits = NULL;
+    size_t nedit  = 0;
+    size_t nbyte  = 0;
+    char *p       = NULL;
+    size_t head   = 0;
+    size_t tail   = 0;
+    int has_mark  = 0;
+    int modified  = 0;
+    int npair     = 0;
+    luaL_Buffer b = {0};
+    url_t u       = {0};
+
+    lauxh_checktable(L, 2);
+    lua_settop(L, 2);
+
+    if (url_parse(&u, url, len, 0, is_querystring)) {
+        // illegal byte sequence
+        lua_pushnil(L);
+        lua_pushinteger(L, u.cur + 1);
+        return 2;
+    }
+
+    // calculate the size of the edits and the encoded pairs
+    lua_pushnil(L);
+    while (lua_next(L, 2)) {
+        size_t klen     = 0;
+        const char *key = NULL;
+
+        if (lua_type(L, -2) != LUA_TSTRING) {
+            lauxh_argerror(L, 2, "edits key must be string");
+        }
+        key = lua_tolstring(L, -2, &klen);
+        nbyte += encode_edit(L, NULL, key, klen);
+        nedit++;
+        lua_pop(L, 1);
+    }
+    nbyte += sizeof(edit_t) * nedit;
+    if (nbyte > sizeof(sbuf)) {
+        scratch = lua_newuserdata(L, nbyte);
+    }
+
+    // encode the pairs
+    edits = (edit_t *)scratch;
+    p     = (char *)(edits + nedit);
+    nedit = 0;
+    lua_pushnil(L);
+    while (lua_next(L, 2)) {
+        edit_t *e = edits + nedit++;
+
+        e->key   = lua_tolstring(L, -2, &e->klen);
+        e->pairs = p;
+        e->plen  = encode_edit(L, p, e->key, e->klen);
+        e->done  = 0;
+        p += e->plen;
+        lua_pop(L, 1);
+    }
+    qsort(edits, nedit, sizeof(edit_t), cmp_edit);
+
+    // span of the query to be replaced
+    if (u.fields & (1 << URL_QUERY)) {
+        head = u.span[URL_QUERY].head;
+        tail = head + u.span[URL_QUERY].len;
+    } else if (u.fields & (1 << URL_FRAGMENT)) {
+        // insert before the '#'
+        head = tail = u.span[URL_FRAGMENT].head - 1;
+    } else {
+        head = tail = len;
+    }
+    if (!(u.fields & (1 << URL_QUERY))) {
+        // the query that has no pairs: "?", "?&&" or "&&" of the query-string
+        size_t pos = head;
+        while (pos && url[pos - 1] == '&') {
+            pos--;
+        }
+        if (is_querystring) {
+            head = 0;
+        } else if (pos && url[pos - 1] == '?') {
+            head = pos - 1;
+        }
+    }
+    // the query delimiter is written before the first pair
+    has_mark = !is_querystring || (head < tail && url[head] == '?');
+
+    luaL_buffinit(L, &b);
+    luaL_addlstring(&b, src, head);
+    if (u.fields & (1 << URL_QUERY)) {
+        url_param_t prm = {0};
+
+        url_param_init(&prm, url, &u.span[URL_QUERY]);
+        for (;;) {
+            size_t phead = prm.cur;
+            edit_t *e    = NULL;
+
+            while (phead < tail && url[phead] == '&') {
+                phead++;
+            }
+            if (!url_param_next(&prm, url, tail)) {
+                break;
+            } else if (!(e = find_edit(edits, nedit, url + prm.key.head,
+                                       prm.key.len, prm.key_encoded))) {
+                // copy the untouched pair
+                add_delimiter(&b, npair++, has_mark);
+                luaL_addlstring(&b, src + phead,
+                                prm.val.head + prm.val.len - phead);
+                continue;
+            }
+
+            // replace the first one and remove the others
+            modified = 1;
+            if (!e->done && e->plen) {
+                add_delimiter(&b, npair++, has_mark);
+                luaL_addlstring(&b, e->pairs, e->plen);
+            }
+            e->done = 1;
+        }
+    }
+
+    // append the new pairs in order of the key
+    for (size_t i = 0; i < nedit; i++) {
+        if (!edits[i].done && edits[i].plen) {
+            modified = 1;
+            add_delimiter(&b, npair++, has_mark);
+            luaL_addlstring(&b, edits[i].pairs, edits[i].plen);
+        }
+    }
+
+    if (!modified) {
+        // keep the url as is
+        lua_settop(L, 1);
+        return 1;
+    }
+    luaL_addlstring(&b, src + tail, len - tail);
+    luaL_pushresult(&b);
+    return 1;
+}
+
+LUALIB_API int luaopen_url_query_edit(lua_State *L)
+{
+    lua_pushcfunction(L, query_edit_lua);
+    return 1;
+}
@@ -0,0 +1,250 @@
+/**
+ *  Copyright (C) 2017 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *
+ *  src/seen_set.c
+ *  lua-url
+ *
+ *  set of the seen urls that keeps only the 64-bit fingerprints of the
+ *  normalized urls instead of the strings.
+ */
+
+// depend
+#include "lauxhlib.h"
+// lua
+#include <lauxlib.h>
+// lua-url
+#include "url.h"
+// system
+#include <errno.h>
+#include <string.h>
+
+#define MODULE_MT "url.seen_set"
+
+typedef struct {
+    url_seen_t *s;
+} seen_set_t;
+
+/**
+ *  add the url to the set and push true if it is new, false if it has been
+ *  seen, or the position of the illegal byte if the url is invalid.
+ *  returns 1 if the url is new, 0 if seen, or -1 if invalid.
+ */
+static int push_add(lua_State *L, url_seen_t *s, int idx)
+{
+    size_t len      = 0;
+    const char *url = lua_tolstring(L, idx, &len);
+    size_t epos     = 0;
+    uint64_t fp = url_fingerprint((const unsigned char *)url, len, &epos);
+    int rv      = 0;
+
+    if (!fp) {
+        // illegal byte sequence
+        lua_pushinteger(L, epos + 1);
+        return -1;
+    } else if ((rv = url_seen_add(s, fp)) < 0) {
+        return luaL_error(L, "failed to add url: %s", strerror(errno));
+    }
+    lua_pushboolean(L, rv);
+    return rv;
+}
+
+static int add_lua(lua_State *L)
+{
+    seen_set_t *s = luaL_checkudata(L, 1, MODULE_MT);
+
+    lauxh_checkstring(L, 2);
+    lua_settop(L, 2);
+    if (push_add(L, s->s, 2) < 0) {
+        lua_pushnil(L);
+        lua_insert(L, -2);
+        return 2;
+    }
+    return 1;
+}
+
+static int add_batch_lua(lua_State *L)
+{
+    seen_set_t *s = luaL_checkudata(L, 1, MODULE_MT);
+    int has_res   = !lauxh_isnil(L, 3);
+    size_t nurl   = 0;
+    lua_Integer n = 0;
+
+    lauxh_checktable(L, 2);
+    if (has_res) {
+        lauxh_checktable(L, 3);
+    }
+    lua_settop(L, 3);
+    nurl = lauxh_rawlen(L, 2);
+    for (size_t i = 1; i <= nurl; i++) {
+        lua_rawgeti(L, 2, i);
+        if (!lauxh_isstring(L, -1)) {
+            return lauxh_argerror(L, 2, "urls#%d must be string", (int)i);
+        }
+        n += push_add(L, s->s, 4) > 0;
+        if (has_res) {
+            lua_rawseti(L, 3, i);
+        } else {
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 1);
+    }
+    lua_pushinteger(L, n);
+    return 1;
+}
+
+static int has_lua(lua_State *L)
+{
+    seen_set_t *s   = luaL_checkudata(L, 1, MODULE_MT);
+    size_t len      = 0;
+    const char *url = lauxh_checklstring(L, 2, &len);
+    size_t epos     = 0;
+    uint64_t fp = url_fingerprint((const unsigned char *)url, len, &epos);
+
+    if (!fp) {
+        // illegal byte sequence
+        lua_pushnil(L);
+        lua_pushinteger(L, epos + 1);
+        return 2;
+    }
+    lua_pushboolean(L, url_seen_has(s->s, fp));
+    return 1;
+}
+
+static int len_lua(lua_State *L)
+{
+    seen_set_t *s = luaL_checkudata(L, 1, MODULE_MT);
+
+    lua_pushinteger(L, url_seen_len(s->s));
+    return 1;
+}
+
+static int cap_lua(lua_State *L)
+{
+    seen_set_t *s = luaL_checkudata(L, 1, MODULE_MT);
+
+    lua_pushinteger(L, url_seen_cap(s->s));
+    return 1;
+}
+
+static int save_lua(lua_State *L)
+{
+    seen_set_t *s        = luaL_checkudata(L, 1, MODULE_MT);
+    const char *pathname = lauxh_checkstring(L, 2);
+
+    if (url_seen_save(s->s, pathname)) {
+        lua_pushboolean(L, 0);
+        lua_pushfstring(L, "%s: %s", pathname, strerror(errno));
+        return 2;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int load_lua(lua_State *L)
+{
+    seen_set_t *s        = luaL_checkudata(L, 1, MODULE_MT);
+    const char *pathname = lauxh_checkstring(L, 2);
+
+    if (url_seen_load(s->s, pathname)) {
+        lua_pushboolean(L, 0);
+        lua_pushfstring(L, "%s: %s", pathname, strerror(errno));
+        return 2;
+    }
+    lua_pushboolean(L, 1);
+    return 1;
+}
+
+static int tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, MODULE_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int gc_lua(lua_State *L)
+{
+    seen_set_t *s = lua_touserdata(L, 1);
+
+    url_seen_free(s->s);
+    s->s = NULL;
+    return 0;
+}
+
+static int new_lua(lua_State *L)
+{
+    uint64_t capacity = lauxh_optuint64(L, 1, 0);
+    seen_set_t *s     = NULL;
+
+    if (capacity > SIZE_MAX) {
+        return lauxh_argerror(L, 1, "capacity too large");
+    }
+    lua_settop(L, 0);
+    s  = lua_newuserdata(L, sizeof(seen_set_t));
+    *s = (seen_set_t){0};
+    lauxh_setmetatable(L, MODULE_MT);
+    if (!(s->s = url_seen_new(capacity))) {
+        return luaL_error(L, "failed to create seen_set: %s", strerror(errno));
+    }
+    return 1;
+}
+
+LUALIB_API int luaopen_url_seen_set(lua_State *L)
+{
+    struct luaL_Reg mmethod[] = {
+        {"__gc",       gc_lua      },
+        {"__len",      len_lua     },
+        {"__tostring", tostring_lua},
+        {NULL,         NULL        }
+    };
+    struct luaL_Reg method[] = {
+        {"add",       add_lua      },
+        {"add_batch", add_batch_lua},
+        {"has",       has_lua      },
+        {"len",       len_lua      },
+        {"cap",       cap_lua      },
+        {"save",      save_lua     },
+        {"load",      load_lua     },
+        {NULL,        NULL         }
+    };
+    int i;
+
+    // create metatable
+    luaL_newmetatable(L, MODULE_MT);
+    // metamethods
+    i = 0;
+    while (mmethod[i].name) {
+        lauxh_pushfn2tbl(L, mmethod[i].name, mmethod[i].func);
+        i++;
+    }
+    // methods
+    lua_pushstring(L, "__index");
+    lua_newtable(L);
+    i = 0;
+    while (method[i].name) {
+        lauxh_pushfn2tbl(L, method[i].name, method[i].func);
+        i++;
+    }
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+
+    lua_pushcfunction(L, new_lua);
+    return 1;
+}
@@ -0,0 +1,144 @@
+/**
+ *  Copyright (C) 2017 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *
+ *  src/split_path.c
+ *  lua-url
+ *
+ */
+
+// depend
+#include "lauxhlib.h"
+// lua
+#include <lauxlib.h>
+// lua-url
+#include "url.h"
+
+/**
+ *  returns a scratch buffer that has at least size bytes.
+ *  the stack buffer is used for short strings, otherwise a userdata that is
+ *  released by the garbage collector is pushed onto the stack.
+ */
+static inline unsigned char *getbuf(lua_State *L, unsigned char *sbuf,
+                                    size_t size)
+{
+    if (size <= LUAL_BUFFERSIZE) {
+        return sbuf;
+    }
+    return lua_newuserdata(L, size);
+}
+
+static int split_path_lua(lua_State *L)
+{
+    size_t len               = 0;
+    const char *src          = lauxh_checklstring(L, 1, &len);
+    const unsigned char *url = (const unsigned char *)src;
+    int decode               = lauxh_optboolean(L, 2, 0);
+    int normalize            = lauxh_optboolean(L, 3, 0);
+    unsigned char sbuf[LUAL_BUFFERSIZE];
+    unsigned char *buf = NULL;
+    url_t u            = {0};
+    url_segment_t s    = {0};
+    size_t tail        = 0;
+    size_t epos        = 0;
+    lua_Integer n      = 0;
+    lua_Integer last   = 0;
+
+    // reuse the passed table
+    if (lauxh_isnil(L, 4)) {
+        lua_settop(L, 3);
+        lua_newtable(L);
+    } else {
+        lauxh_checktable(L, 4);
+        lua_settop(L, 4);
+        last = lauxh_rawlen(L, 4);
+    }
+
+    if (url_parse(&u, url, len, 0, 0)) {
+        // illegal byte sequence
+        lua_pushnil(L);
+        lua_pushinteger(L, u.cur + 1);
+        return 2;
+    } else if (!(u.fields & (1 << URL_PATH))) {
+        // no path
+        u.span[URL_PATH] = (url_span_t){0};
+    }
+
+    tail = u.span[URL_PATH].head + u.span[URL_PATH].len;
+    if (decode) {
+        buf = getbuf(L, sbuf, URL_DECODE_MAXLEN(u.span[URL_PATH].len));
+    }
+
+    url_segment_init(&s, url, &u.span[URL_PATH]);
+    while (url_segment_next(&s, url, tail)) {
+        const char *seg = src + s.seg.head;
+        size_t slen     = s.seg.len;
+
+        // decode only the segments that contain the '%' character
+        if (decode && s.encoded) {
+            ssize_t rv = url_decode(buf, url + s.seg.head, slen, URL_DECODE_ALL,
+                                    &epos);
+            if (rv < 0) {
+                // invalid percent-encoded sequence
+                lua_pushnil(L);
+                lua_pushinteger(L, s.seg.head + epos + 1);
+                return 2;
+            }
+            seg  = (const char *)buf;
+            slen = rv;
+        }
+
+        if (normalize) {
+            // skip the empty segment and "."
+            if (!slen || (slen == 1 && *seg == '.')) {
+                continue;
+            }
+            // ".." removes the previous segment
+            if (slen == 2 && seg[0] == '.' && seg[1] == '.') {
+                if (n) {
+                    n--;
+                }
+                continue;
+            }
+        }
+
+        lua_pushlstring(L, seg, slen);
+        lua_rawseti(L, 4, ++n);
+        if (n > last) {
+            last = n;
+        }
+    }
+
+    // remove the rest of the items
+    while (last > n) {
+        lua_pushnil(L);
+        lua_rawseti(L, 4, last--);
+    }
+
+    lua_settop(L, 4);
+    return 1;
+}
+
+LUALIB_API int luaopen_url_split_path(lua_State *L)
+{
+    lua_pushcfunction(L, split_path_lua);
+    return 1;
+}
@@ -0,0 +1,465 @@
+/**
+ *  Copyright (C) 2017 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  src/url.h
+ *  lua-url
+ *
+ *  Lua-free entry points of the codec and the parser.
+ *  these functions are used by the lua bindings (codec.c, parse.c) and are
+ *  exported from the shared objects for the LuaJIT FFI front end (url/ffi.lua).
+ *  keep the declarations in sync with the ffi.cdef in url/ffi.lua.
+ */
+
+#ifndef lua_url_h
+#define lua_url_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ *  codec
+ */
+
+typedef enum {
+    URL_ENCODE_URI  = 0,
+    URL_ENCODE_FORM = 1,
+    URL_ENCODE_2396 = 2,
+    URL_ENCODE_3986 = 3,
+    // bit-flag: the valid percent-encoded sequences are kept as they are
+    // except that the hex digits are uppercased
+    URL_ENCODE_PRESERVE = 0x10
+} url_encode_type_e;
+
+typedef enum {
+    URL_DECODE_ALL  = 0,
+    URL_DECODE_URI  = 1,
+    URL_DECODE_FORM = 2,
+    // bit-flag: the decoded bytes must be the well-formed UTF-8
+    URL_DECODE_UTF8 = 0x10,
+    // bit-flag: the invalid '%' is copied as it is instead of the error
+    URL_DECODE_LENIENT = 0x20
+} url_decode_type_e;
+
+// worst-case output size of url_encode: every byte becomes "%XX"
+#define URL_ENCODE_MAXLEN(len) ((len) * 3)
+// the decoded string never gets longer than the source
+#define URL_DECODE_MAXLEN(len) (len)
+
+/**
+ *  url_encode
+ *  percent-encode len bytes of src into dst and return the number of bytes
+ *  written. dst must have room for URL_ENCODE_MAXLEN(len) bytes.
+ *  if the type is combined with URL_ENCODE_PRESERVE, the valid "%XX"
+ *  sequences are copied with the uppercase hex digits instead of encoding
+ *  the '%', so that the encoding is idempotent.
+ */
+size_t url_encode(unsigned char *dst, const unsigned char *src, size_t len,
+                  url_encode_type_e type);
+
+/**
+ *  url_decode
+ *  decode len bytes of src into dst and return the number of bytes written.
+ *  dst must have room for URL_DECODE_MAXLEN(len) bytes.
+ *  returns -1 and sets the 0-based position of the illegal '%' to *epos if
+ *  src contains an invalid percent-encoded sequence. the "%uXXXX" surrogate
+ *  must be a high surrogate immediately followed by a low one.
+ *  if the type is combined with URL_DECODE_UTF8, the decoded bytes are
+ *  validated in the same pass, and returns -1 and sets the position of the
+ *  first byte (or '%') of the ill-formed UTF-8 sequence (overlong forms,
+ *  surrogates and truncated sequences) to *epos.
+ *  if the type is combined with URL_DECODE_LENIENT, the '%' that does not
+ *  start a valid sequence is copied as it is in the manner of the WHATWG
+ *  percent-decode, and the number of such '%' is set to *epos on success.
+ */
+ssize_t url_decode(unsigned char *dst, const unsigned char *src, size_t len,
+                   url_decode_type_e type, size_t *epos);
+
+/**
+ *  url_decode_step
+ *  decode src from the *cur position in the same way as url_decode, and
+ *  stop at the first sequence boundary at or after the stop position.
+ *  the percent-encoded sequence and the UTF-8 sequence in the
+ *  URL_DECODE_UTF8 mode are never split, so that the sequence that starts
+ *  before the stop position may be read beyond it.
+ *  returns the number of bytes written and sets the next position to *cur,
+ *  or -1 as url_decode. dst must have room for URL_DECODE_MAXLEN(len - *cur)
+ *  bytes.
+ */
+ssize_t url_decode_step(unsigned char *dst, const unsigned char *src,
+                        size_t len, url_decode_type_e type, size_t *cur,
+                        size_t stop, size_t *epos);
+
+// the decoded base64 never gets longer than the source, and the vectorized
+// decoder may write up to the source length
+#define URL_DECODE_BASE64_MAXLEN(len) (len)
+
+/**
+ *  url_decode_base64
+ *  decode len bytes of the base64 encoded src into dst in the
+ *  "forgiving-base64" manner of the WHATWG Infra Standard; the ASCII
+ *  whitespace is ignored and the padding is optional.
+ *  returns the number of bytes written. dst must have room for
+ *  URL_DECODE_BASE64_MAXLEN(len) bytes and may be the same as src.
+ *  returns -1 and sets the 0-based position of the invalid byte, the
+ *  incomplete padding or the trailing single sextet to *epos.
+ */
+ssize_t url_decode_base64(unsigned char *dst, const unsigned char *src,
+                          size_t len, size_t *epos);
+
+/**
+ *  url_reserve
+ *  grow the buffer *data of *cap bytes that holds len bytes so that it has
+ *  room for at least size more bytes. the capacity is doubled if not enough.
+ *  returns the pointer to the tail of the data, or NULL and sets errno if
+ *  failed to allocate memory.
+ */
+unsigned char *url_reserve(unsigned char **data, size_t len, size_t *cap,
+                           size_t size);
+
+/**
+ *  IDNA
+ */
+
+// worst-case output size of url_host_to_ascii: the punycode label is limited
+// to 63 bytes and it is generated from at least 2 bytes of the source
+#define URL_HOST_ASCII_MAXLEN(len)   ((len) * 32)
+// every code point of the punycode label is encoded in at most 4 bytes
+#define URL_HOST_UNICODE_MAXLEN(len) ((len) * 4)
+
+/**
+ *  url_host_to_ascii
+ *  convert the host name into the ASCII form. the percent-encoded bytes are
+ *  decoded, the ASCII characters are lowercased and the labels that contain
+ *  the non-ASCII characters are encoded to the punycode with "xn--" prefix.
+ *  dst must have room for URL_HOST_ASCII_MAXLEN(len) bytes.
+ *  returns the number of bytes written, or -1 and sets the 0-based position
+ *  of the invalid label to *epos if the label contains an invalid
+ *  percent-encoded sequence or UTF-8 sequence, or exceeds 63 bytes.
+ */
+ssize_t url_host_to_ascii(unsigned char *dst, const unsigned char *src,
+                          size_t len, size_t *epos);
+
+/**
+ *  url_host_to_unicode
+ *  convert the host name into the Unicode form. the "xn--" labels are
+ *  decoded from the punycode to UTF-8, and the other labels are lowercased.
+ *  dst must have room for URL_HOST_UNICODE_MAXLEN(len) bytes.
+ *  returns the number of bytes written, or -1 and sets the 0-based position
+ *  of the invalid label to *epos if the label contains an invalid
+ *  percent-encoded sequence or the "xn--" label is not a valid punycode.
+ */
+ssize_t url_host_to_unicode(unsigned char *dst, const unsigned char *src,
+                            size_t len, size_t *epos);
+
+/**
+ *  parser
+ */
+
+typedef enum {
+    URL_SCHEME   = 0,
+    URL_USERINFO = 1,
+    URL_USER     = 2,
+    URL_PASSWORD = 3,
+    URL_HOST     = 4,
+    URL_HOSTNAME = 5,
+    URL_PORT     = 6,
+    URL_PATH     = 7,
+    URL_QUERY    = 8,
+    URL_FRAGMENT = 9,
+    URL_NFIELD   = 10
+} url_field_e;
+
+// names of the fields in the result table of the parse function
+extern const char *const URL_FIELD_NAMES[URL_NFIELD];
+
+// value of the hex digit, or 0 if c is not a hex digit
+static inline int url_unhex(unsigned char c)
+{
+    if ('0' <= c && c <= '9') {
+        return c - '0';
+    } else if ('a' <= c && c <= 'f') {
+        return c - 'a' + 10;
+    } else if ('A' <= c && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return 0;
+}
+
+typedef struct {
+    size_t head;
+    size_t len;
+} url_span_t;
+
+typedef struct {
+    // bit-flags of the fields that have been found: (1 << url_field_e)
+    uint32_t fields;
+    url_span_t span[URL_NFIELD];
+    // cursor stop position
+    size_t cur;
+} url_t;
+
+/**
+ *  url_parse
+ *  parse the url string from the cur position and store the spans of the
+ *  found fields in u.
+ *  returns 0 if the parser stopped without an error, or 1 if an illegal byte
+ *  was found at u->cur.
+ *  url must be terminated by a NUL byte (e.g. a lua string).
+ */
+int url_parse(url_t *u, const unsigned char *url, size_t urllen, size_t cur,
+              int is_querystring);
+
+/**
+ *  url_parse_authority
+ *  parse the url string from the cur position in the same way as url_parse,
+ *  but stop at the end of the authority (the first '/', '?' or '#' after
+ *  the host) or at the first byte that rules out the scheme. the spans of
+ *  the path, the query and the fragment are not stored.
+ */
+int url_parse_authority(url_t *u, const unsigned char *url, size_t urllen,
+                        size_t cur);
+
+/**
+ *  url_parse_hostport
+ *  parse the authority without the scheme (e.g. "host:port" of the CONNECT
+ *  request or the value of the Host header) from the cur position, and stop
+ *  at the end of the authority in the same way as url_parse_authority.
+ */
+int url_parse_hostport(url_t *u, const unsigned char *url, size_t urllen,
+                       size_t cur);
+
+typedef struct {
+    // cursor position of the next parameter
+    size_t cur;
+    url_span_t key;
+    url_span_t val;
+    // key or value contains the '%' or '+' characters
+    int key_encoded;
+    int val_encoded;
+} url_param_t;
+
+/**
+ *  url_param_init
+ *  initialize p to iterate the key-value pairs of the query span.
+ */
+void url_param_init(url_param_t *p, const unsigned char *url,
+                    const url_span_t *query);
+
+/**
+ *  url_param_next
+ *  find the next key-value pair in url[p->cur, tail) and store its spans in
+ *  p. returns 1 if found, or 0 if no more pairs.
+ */
+int url_param_next(url_param_t *p, const unsigned char *url, size_t tail);
+
+typedef struct {
+    // cursor position of the next segment
+    size_t cur;
+    url_span_t seg;
+    // segment contains the '%' character
+    int encoded;
+} url_segment_t;
+
+/**
+ *  url_segment_init
+ *  initialize s to iterate the segments of the path span.
+ *  the leading '/' of the absolute path is not treated as a segment.
+ */
+void url_segment_init(url_segment_t *s, const unsigned char *url,
+                      const url_span_t *path);
+
+/**
+ *  url_segment_next
+ *  find the next segment in url[s->cur, tail) and store its span in s.
+ *  returns 1 if found, or 0 if no more segments.
+ */
+int url_segment_next(url_segment_t *s, const unsigned char *url, size_t tail);
+
+/**
+ *  matcher
+ */
+
+typedef struct url_matcher_s url_matcher_t;
+
+/**
+ *  url_matcher_new
+ *  returns a new empty matcher, or NULL if failed to allocate memory.
+ */
+url_matcher_t *url_matcher_new(void);
+
+/**
+ *  url_matcher_free
+ *  release the memory of the matcher.
+ */
+void url_matcher_free(url_matcher_t *m);
+
+/**
+ *  url_matcher_add
+ *  add the rule "[scheme://]host-suffix[/path-prefix]" with the id to the
+ *  matcher. the rule that has the scheme matches only the urls of the same
+ *  scheme. if the same rule already exists, the id of the first one is kept.
+ *  returns 0 on success, or -1 and sets errno to EINVAL if the rule (e.g. the
+ *  host with the port or the userinfo) or the id is invalid, or ENOMEM if
+ *  failed to allocate memory.
+ */
+int url_matcher_add(url_matcher_t *m, const unsigned char *rule, size_t len,
+                    uint32_t id);
+
+/**
+ *  url_matcher_match
+ *  returns the id of the most specific rule that matches the url, or 0 if
+ *  no rule matches or the url is invalid.
+ *  url must be terminated by a NUL byte (e.g. a lua string).
+ */
+uint32_t url_matcher_match(const url_matcher_t *m, const unsigned char *url,
+                           size_t len);
+
+/**
+ *  public suffix list
+ */
+
+typedef struct url_psl_s url_psl_t;
+
+/**
+ *  url_psl_new
+ *  returns a new empty list, or NULL and sets errno if failed to allocate
+ *  memory.
+ */
+url_psl_t *url_psl_new(void);
+
+/**
+ *  url_psl_free
+ *  release the memory of the list.
+ */
+void url_psl_free(url_psl_t *psl);
+
+/**
+ *  url_psl_len
+ *  returns the number of the rules in the list.
+ */
+size_t url_psl_len(const url_psl_t *psl);
+
+/**
+ *  url_psl_add
+ *  add the rule "[!|*.]label*(.label)" of the Public Suffix List format.
+ *  the rule is converted with url_host_to_ascii before it is stored.
+ *  returns 0 on success, or -1 and sets errno to EINVAL if the rule is
+ *  invalid, or ENOMEM if failed to allocate memory.
+ */
+int url_psl_add(url_psl_t *psl, const unsigned char *rule, size_t len);
+
+/**
+ *  url_psl_load
+ *  add the rules of the file in the public_suffix_list.dat format. the
+ *  first word of each line is the rule, and the lines that start with "//"
+ *  are ignored. returns 0 on success, or -1 and sets errno and the 1-based
+ *  line number of the invalid rule to *eline.
+ */
+int url_psl_load(url_psl_t *psl, const char *pathname, size_t *eline);
+
+/**
+ *  url_psl_lookup
+ *  find the public suffix of the host name in the ASCII form, and set the
+ *  0-based position of its head to *suffix and the head of the registrable
+ *  domain (the public suffix and one more label) to *domain, or the length
+ *  of the host if the host itself is a public suffix.
+ *  returns the length of the host without the trailing dot, or -1 if the
+ *  host is an IP address or contains an empty label.
+ */
+ssize_t url_psl_lookup(const url_psl_t *psl, const unsigned char *host,
+                       size_t len, size_t *suffix, size_t *domain);
+
+/**
+ *  seen set
+ */
+
+typedef struct url_seen_s url_seen_t;
+
+/**
+ *  url_fingerprint
+ *  returns the 64-bit fingerprint of the normalized url; the scheme and the
+ *  hostname are lowercased, the default port of the scheme and the leading
+ *  zeros of the port are removed, the empty path of the url that has a host
+ *  is treated as "/", the hex digits of the percent-encoded sequences are
+ *  uppercased, and the userinfo and the fragment are ignored.
+ *  returns 0 and sets the 0-based position of the illegal byte to *epos if
+ *  the url is invalid. url must be terminated by a NUL byte.
+ */
+uint64_t url_fingerprint(const unsigned char *url, size_t len, size_t *epos);
+
+/**
+ *  url_seen_new
+ *  returns a new empty set that holds the capacity fingerprints without
+ *  growing the table, or NULL and sets errno if failed to allocate memory.
+ */
+url_seen_t *url_seen_new(size_t capacity);
+
+/**
+ *  url_seen_free
+ *  release the memory of the set.
+ */
+void url_seen_free(url_seen_t *s);
+
+/**
+ *  url_seen_len
+ *  returns the number of the fingerprints in the set.
+ */
+size_t url_seen_len(const url_seen_t *s);
+
+/**
+ *  url_seen_cap
+ *  returns the number of the fingerprints that the set can hold without
+ *  growing the table. each slot of the table takes 8 bytes.
+ */
+size_t url_seen_cap(const url_seen_t *s);
+
+/**
+ *  url_seen_has
+ *  returns 1 if the set contains the fingerprint, or 0.
+ */
+int url_seen_has(const url_seen_t *s, uint64_t fp);
+
+/**
+ *  url_seen_add
+ *  add the fingerprint to the set. the table is doubled if the load factor
+ *  exceeds 4/5. returns 1 if added, 0 if the set already contains it, or -1
+ *  and sets errno to EINVAL if fp is 0, or ENOMEM if failed to grow.
+ */
+int url_seen_add(url_seen_t *s, uint64_t fp);
+
+/**
+ *  url_seen_save
+ *  write the fingerprints of the set to the file in the little-endian
+ *  format. returns 0 on success, or -1 and sets errno.
+ */
+int url_seen_save(const url_seen_t *s, const char *pathname);
+
+/**
+ *  url_seen_load
+ *  add the fingerprints of the file written by url_seen_save to the set.
+ *  returns 0 on success, or -1 and sets errno to EINVAL if the file is not
+ *  a valid fingerprint file. the fingerprints that have been read before
+ *  the error are kept in the set.
+ */
+int url_seen_load(url_seen_t *s, const char *pathname);
+
+#endif
@@ -0,0 +1,909 @@
+/**
+ *  Copyright (C) 2014 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *
+ *  src/url_codec.c
+ *  lua-url
+ *
+ *  Lua-free percent-encoding/decoding kernels.
+ *
+ */
+
+// lua-url
+#include "url.h"
+// system
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__) && !defined(URL_NO_SIMD)
+# define URL_USE_SSE2
+# include <emmintrin.h>
+#endif
+
+/*
+    encodeURI   : 0-9 a-zA-Z !#$&'()*+,-./:;=?@_~
+
+    uric        = reserved | unreserved | escaped
+    reserved    = ";" | "," | "/" | "?" | ":" | "@" | "&" | "=" | "+" | "$"
+    unreserved  = alphanum | mark
+    mark        = "-" | "_" | "." | "!" | "~" | "*" | "'" | "(" | ")"
+
+    escaped     = "%" hex hex
+
+    hex         = digit | "A" | "B" | "C" | "D" | "E" | "F" |
+                          "a" | "b" | "c" | "d" | "e" | "f"
+
+    digit       = "0" | "1" | "2" | "3" | "4" | "5" | "6" | "7" | "8" | "9"
+
+    alphanum    = alpha | digit
+    alpha       = lowalpha | upalpha
+
+    lowalpha    = "a" | "b" | "c" | "d" | "e" | "f" | "g" | "h" | "i" |
+                  "j" | "k" | "l" | "m" | "n" | "o" | "p" | "q" | "r" |
+                  "s" | "t" | "u" | "v" | "w" | "x" | "y" | "z"
+    upalpha     = "A" | "B" | "C" | "D" | "E" | "F" | "G" | "H" | "I" |
+                  "J" | "K" | "L" | "M" | "N" | "O" | "P" | "Q" | "R" |
+                  "S" | "T" | "U" | "V" | "W" | "X" | "Y" | "Z"
+*/
+static const unsigned char UNRESERVED_URI[256] = {
+    //  ctrl-code: 0-31
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0,
+
+    // SP      "            %
+    0, 0, '!', 0, '#', '$', 0, '&', '\'', '(', ')', '*', '+', ',', '-', '.',
+    '/',
+
+    // digit
+    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9',
+
+    //        <       >
+    ':', ';', 0, '=', 0, '?', '@',
+
+    // alpha-upper
+    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O',
+    'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y',
+    //   [  \  ]  ^       `
+    'Z', 0, 0, 0, 0, '_', 0,
+
+    // alpha-lower
+    'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
+    'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y',
+    //   {  |  }
+    'z', 0, 0, 0, '~'};
+
+/*
+    encode_form  : 0-9 a-zA-Z *-._~
+    https://url.spec.whatwg.org/#application-x-www-form-urlencoded-percent-encode-set
+
+    application/x-www-form-urlencoded = percent-encode
+                                        except: alpha | digit | "*" | "-" |
+                                                "." | "_"
+
+    parcent-encode              = component-percent-encode |
+                                  "!" | "'" | "(" | ")" | "~"
+
+    component-percent-encode    = userinfo-percent-encode |
+                                  "$" | "%" | "&" | "+" | ","
+
+    userinfo-percent-encode     = path-percent-encode |
+                                  "/" | ":" | ";" | "=" | "@" | "[" | "\" |
+                                  "]" | "^" | "|"
+
+    path-percent-encode         = query-percent-encode |
+                                  "?" | "`" | "{" | "}"
+
+    query-percent-encode        = c0-control-percent-encode |
+                                  code-points-gt-7e-encode |
+                                  " " | '"' | "#" | "<" | ">"
+
+    c0-control-percent-encode   = 0x0 to 0x1F
+
+    code-points-gt-7e-encode    = greater than "~"
+
+
+    unreserved  = alpha | digit | mark
+
+    alpha       = "a" | "b" | "c" | "d" | "e" | "f" | "g" | "h" | "i" |
+                  "j" | "k" | "l" | "m" | "n" | "o" | "p" | "q" | "r" |
+                  "s" | "t" | "u" | "v" | "w" | "x" | "y" | "z"
+                  "A" | "B" | "C" | "D" | "E" | "F" | "G" | "H" | "I" |
+                  "J" | "K" | "L" | "M" | "N" | "O" | "P" | "Q" | "R" |
+                  "S" | "T" | "U" | "V" | "W" | "X" | "Y" | "Z"
+
+    digit       = "0" | "1" | "2" | "3" | "4" | "5" | "6" | "7" | "8" | "9"
+
+    mark        = *-._~
+*/
+static const unsigned char UNRESERVED_FORM[256] = {
+    //  ctrl-code: 0-31
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0,
+
+    // SP   !  "  #  $  %  &  \  (  )       +  ,            /
+    0, '+', 0, 0, 0, 0, 0, 0, 0, 0, 0, '*', 0, 0, '-', '.', 0,
+
+    // digit                                          :  ;  <  =  >  ?  @
+    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 0, 0, 0, 0, 0, 0, 0,
+
+    // alpha-upper
+    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O',
+    'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y',
+    //   [  \  ]  ^       `
+    'Z', 0, 0, 0, 0, '_', 0,
+
+    // alpha-lower
+    'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
+    'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y',
+    //   {  |  }
+    'z', 0, 0, 0, '~'};
+
+/*
+    RFC 2396    : 0-9 a-zA-Z !'()*-._~
+
+    unreserved  = alphanum | mark
+
+    mark        = "-" | "_" | "." | "!" | "~" | "*" | "'" | "(" | ")"
+
+    alphanum    = alpha | digit
+
+    alpha       = lowalpha | upalpha
+
+    lowalpha    = "a" | "b" | "c" | "d" | "e" | "f" | "g" | "h" | "i" |
+                  "j" | "k" | "l" | "m" | "n" | "o" | "p" | "q" | "r" |
+                  "s" | "t" | "u" | "v" | "w" | "x" | "y" | "z"
+
+    upalpha     = "A" | "B" | "C" | "D" | "E" | "F" | "G" | "H" | "I" |
+                  "J" | "K" | "L" | "M" | "N" | "O" | "P" | "Q" | "R" |
+                  "S" | "T" | "U" | "V" | "W" | "X" | "Y" | "Z"
+
+    digit       = "0" | "1" | "2" | "3" | "4" | "5" | "6" | "7" | "8" | "9"
+*/
+static const unsigned char UNRESERVED_2396[256] = {
+    //  ctrl-code: 0-31
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0,
+
+    // SP      "  #  $  %  &                       +  ,            /
+    0, 0, '!', 0, 0, 0, 0, 0, '\'', '(', ')', '*', 0, 0, '-', '.', 0,
+
+    // digit                                          :  ;  <  =  >  ?  @
+    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 0, 0, 0, 0, 0, 0, 0,
+
+    // alpha-upper
+    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O',
+    'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y',
+    //   [  \  ]  ^       `
+    'Z', 0, 0, 0, 0, '_', 0,
+
+    // alpha-lower
+    'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
+    'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y',
+    //   {  |  }
+    'z', 0, 0, 0, '~'};
+
+/*
+    RFC 3986    : 0-9 a-zA-Z -._~
+
+    unreserved  = alpha | digit | "-" | "." | "_" | "~"
+
+    alpha       = lowalpha | upalpha
+
+    lowalpha    = "a" | "b" | "c" | "d" | "e" | "f" | "g" | "h" | "i" |
+                  "j" | "k" | "l" | "m" | "n" | "o" | "p" | "q" | "r" |
+                  "s" | "t" | "u" | "v" | "w" | "x" | "y" | "z"
+
+    upalpha     = "A" | "B" | "C" | "D" | "E" | "F" | "G" | "H" | "I" |
+                  "J" | "K" | "L" | "M" | "N" | "O" | "P" | "Q" | "R" |
+                  "S" | "T" | "U" | "V" | "W" | "X" | "Y" | "Z"
+
+    digit       = "0" | "1" | "2" | "3" | "4" | "5" | "6" | "7" | "8" | "9"
+*/
+static const unsigned char UNRESERVED_3986[256] = {
+    //  ctrl-code: 0-31
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0,
+
+    // SP !  "  #  $  %  &  '  (  )  *  +  ,            /
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '-', '.', 0,
+
+    // digit
+    //                                                :  ;  <  =  >  ?  @
+    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 0, 0, 0, 0, 0, 0, 0,
+
+    // alpha-upper
+    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O',
+    'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y',
+    //   [  \  ]  ^       `
+    'Z', 0, 0, 0, 0, '_', 0,
+
+    // alpha-lower
+    'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o',
+    'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y',
+    //   {  |  }
+    'z', 0, 0, 0, '~'};
+
+/*
+    hex = 0-16
+    '0' = 48
+    '7' = 55
+    'A' = 65
+    'W' = 87
+    'a' = 97
+    uppercase:
+        '7' = 'A' - 10
+    lowercase:
+        'W' = 'a' - 10
+*/
+static const unsigned char DEC2HEX[16] = "0123456789ABCDEF";
+
+static const char HEX2DEC[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    //  0  1  2  3  4  5  6  7  8  9
+    1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 0, 0, 0, 0, 0, 0, 0,
+    //  A   B   C   D   E   F
+    11, 12, 13, 14, 15, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0,
+    //  a   b   c   d   e   f
+    11, 12, 13, 14, 15, 16};
+
+static const unsigned char *UNRESERVED[] = {
+    [URL_ENCODE_URI]  = UNRESERVED_URI,
+    [URL_ENCODE_FORM] = UNRESERVED_FORM,
+    [URL_ENCODE_2396] = UNRESERVED_2396,
+    [URL_ENCODE_3986] = UNRESERVED_3986,
+};
+
+/**
+ *  encode is specialized at compile time for the preserve mode, so that the
+ *  default mode does not pay for the check of the '%' sequences.
+ */
+static inline __attribute__((always_inline)) size_t
+encode(unsigned char *dst, const unsigned char *src, size_t len,
+       const unsigned char *tbl, const int preserve)
+{
+    unsigned char *p = dst;
+
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c          = src[i];
+        unsigned char unreserved = tbl[c];
+        if (unreserved) {
+            *p++ = unreserved;
+        } else if (preserve && c == '%' && i + 2 < len &&
+                   HEX2DEC[src[i + 1]] && HEX2DEC[src[i + 2]]) {
+            // keep the valid percent-encoded sequence with the uppercase
+            // hex digits
+            p[0] = '%';
+            p[1] = DEC2HEX[HEX2DEC[src[i + 1]] - 1];
+            p[2] = DEC2HEX[HEX2DEC[src[i + 2]] - 1];
+            p += 3;
+            i += 2;
+        } else {
+            p[0] = '%';
+            // c >> 4 = c / 16
+            p[1] = DEC2HEX[c >> 4];
+            // c & 0xf = c % 16
+            p[2] = DEC2HEX[c & 0xf];
+            p += 3;
+        }
+    }
+
+    return p - dst;
+}
+
+size_t url_encode(unsigned char *dst, const unsigned char *src, size_t len,
+                  url_encode_type_e type)
+{
+    if (type & URL_ENCODE_PRESERVE) {
+        return encode(dst, src, len, UNRESERVED[type & ~URL_ENCODE_PRESERVE],
+                      1);
+    }
+    return encode(dst, src, len, UNRESERVED[type], 0);
+}
+
+/*
+                hex: 0xf                 = 0-15      = 4bit
+    utf8 code-point: u+0000 ... u+10ffff = 0-1114111 = 21bit
+              ascii: u+0000 ... u+007f   = 0-127     = 7bit
+
+    returns the number of bytes written to dest.
+*/
+static inline int unicode_pt2utf8(unsigned char *dest, uint32_t cp)
+{
+    // range: u+0000 ... u+007f
+    //   bit: 0xxx xxxx
+    if (cp < 0x80) {
+        dest[0] = cp;
+        return 1;
+    }
+    // range: u+0080 ... u+07ff
+    //   bit: [110y yyyx]:0xc0
+    //        [10xx xxxx]:0x80
+    else if (cp < 0x800) {
+        dest[0] = 0xc0 | (cp >> 6);
+        dest[1] = 0x80 | (cp & 0x3f);
+        return 2;
+    }
+    // range: u+d800 ... u+dfff use for surrogate pairs
+    else if (cp > 0xD7FF && cp < 0xE000) {
+        return -2;
+    }
+    // range: u+0800 ... u+ffff
+    //   bit: [1110 yyyy]:0xe0
+    //        [10yx xxxx]:0x80
+    //        [10xx xxxx]:0x80
+    else if (cp < 0x10000) {
+        dest[0] = 0xe0 | (cp >> 12);
+        dest[1] = 0x80 | ((cp >> 6) & 0x3f);
+        dest[2] = 0x80 | (cp & 0x3f);
+        return 3;
+    }
+    // range: u+10000 ... u+1FFFFF
+    //   bit: [1111 0yyy]:0xf0
+    //        [10yy xxxx]:0x80
+    //        [10xx xxxx]:0x80
+    //        [10xx xxxx]:0x80
+    //
+    // RFC 3629: UTF-8, characters from the U+0000..U+10FFFF
+    // else if( cp < 0x200000 ){
+    else if (cp < 0x110000) {
+        dest[0] = 0xf0 | (cp >> 18);
+        dest[1] = 0x80 | ((cp >> 12) & 0x3f);
+        dest[2] = 0x80 | ((cp >> 6) & 0x3f);
+        dest[3] = 0x80 | (cp & 0x3f);
+        return 4;
+    }
+    /* UTF-8 now max 4 bytes
+    // range: u+200000 ... u+3FFFFFF
+    //   bit: [1111 10yy]:0xf8
+    //        [10yy xxxx]:0x80
+    //        [10xx xxxx]:0x80
+    //        [10xx xxxx]:0x80
+    //        [10xx xxxx]:0x80
+    else if( cp < 0x400000 ){
+        dest[0] = 0xf8 | ( cp >> 24 );
+        dest[1] = 0x80 | ( ( cp >> 18 ) & 0x3f );
+        dest[2] = 0x80 | ( ( cp >> 12 ) & 0x3f );
+        dest[3] = 0x80 | ( ( cp >> 6 ) & 0x3f );
+        dest[4] = 0x80 | ( cp & 0x3f );
+        return 5;
+    }
+    // range: u+4000000 ... u+7FFFFFFF
+    //   bit: [1111 110y]:0xfc
+    //        [10yy xxxx]:0x80
+    //        [10yy xxxx]:0x80
+    //        [10yy xxxx]:0x80
+    //        [10xx xxxx]:0x80
+    //        [10xx xxxx]:0x80
+    else if( cp < 0x800000 ){
+        dest[0] = 0xfc | ( cp >> 30 );
+        dest[1] = 0x80 | ( ( cp >> 24 ) & 0x3f );
+        dest[2] = 0x80 | ( ( cp >> 18 ) & 0x3f );
+        dest[3] = 0x80 | ( ( cp >> 12 ) & 0x3f );
+        dest[4] = 0x80 | ( ( cp >> 6 ) & 0x3f );
+        dest[5] = 0x80 | ( cp & 0x3f );
+        return 6;
+    }
+    //*/
+    // invalid: code-point > 0x7FFFFFFF
+    errno = ERANGE;
+    return -1;
+}
+
+/*
+    RFC 3629 4. Syntax of UTF-8 Byte Sequences
+
+    UTF8-octets = *( UTF8-char )
+    UTF8-char   = UTF8-1 / UTF8-2 / UTF8-3 / UTF8-4
+    UTF8-1      = %x00-7F
+    UTF8-2      = %xC2-DF UTF8-tail
+    UTF8-3      = %xE0 %xA0-BF UTF8-tail / %xE1-EC 2( UTF8-tail ) /
+                  %xED %x80-9F UTF8-tail / %xEE-EF 2( UTF8-tail )
+    UTF8-4      = %xF0 %x90-BF 2( UTF8-tail ) / %xF1-F3 3( UTF8-tail ) /
+                  %xF4 %x80-8F 2( UTF8-tail )
+    UTF8-tail   = %x80-BF
+*/
+typedef struct {
+    // number of the continuation bytes that must follow
+    int need;
+    // range of the next continuation byte
+    unsigned char lo;
+    unsigned char hi;
+    // source position of the first byte of the sequence
+    size_t head;
+} utf8_state_t;
+
+/**
+ *  feed the decoded byte c that is produced at the source position pos.
+ *  returns 0 if c continues the well-formed sequence, or -1.
+ */
+static inline int utf8_next(utf8_state_t *u, unsigned char c, size_t pos)
+{
+    if (!u->need && c < 0x80) {
+        return 0;
+    } else if (u->need) {
+        if (c < u->lo || c > u->hi) {
+            return -1;
+        }
+        u->lo = 0x80;
+        u->hi = 0xBF;
+        u->need--;
+        return 0;
+    }
+
+    u->head = pos;
+    u->lo   = 0x80;
+    u->hi   = 0xBF;
+    switch (c) {
+    case 0xC2 ... 0xDF:
+        u->need = 1;
+        return 0;
+    case 0xE0:
+        // overlong
+        u->lo = 0xA0;
+    case 0xE1 ... 0xEC:
+    case 0xEE ... 0xEF:
+        u->need = 2;
+        return 0;
+    case 0xED:
+        // surrogates
+        u->hi   = 0x9F;
+        u->need = 2;
+        return 0;
+    case 0xF0:
+        // overlong
+        u->lo = 0x90;
+    case 0xF1 ... 0xF3:
+        u->need = 3;
+        return 0;
+    case 0xF4:
+        // greater than U+10FFFF
+        u->hi   = 0x8F;
+        u->need = 3;
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+/*
+                   hex: 0xf                 = 0-15  = 4bit
+    unicode code-point: u+0000 ... u+10ffff = 21bit
+                 ascii: u+0000 ... u+007f   = 0-127 = 7bit
+
+    the strict argument is a constant so that the compiler generates the
+    decoder without the UTF-8 validation for the default mode.
+    the lenient argument is checked only on the invalid '%'.
+    the decoder stops at the first sequence boundary at or after the stop
+    position, and sets the position to *cur.
+*/
+static inline __attribute__((always_inline)) ssize_t
+decode(unsigned char *dst, const unsigned char *src, size_t len,
+       url_decode_type_e type, size_t *cur, size_t stop, size_t *epos,
+       const int strict, int lenient)
+{
+    unsigned char *p = dst;
+    utf8_state_t u8  = {0};
+    size_t i         = *cur;
+    size_t ninvalid  = 0;
+
+    for (; i < len; i++) {
+        const unsigned char *s = src + i;
+
+        // the UTF-8 sequence must not be split
+        if (i >= stop && (!strict || !u8.need)) {
+            break;
+        }
+        if (*s != '%') {
+            unsigned char c = *s;
+            if (type == URL_DECODE_FORM && c == '+') {
+                c = ' ';
+            }
+            if (strict && utf8_next(&u8, c, i)) {
+                goto INVALID_UTF8;
+            }
+            *p++ = c;
+            continue;
+        }
+        // percent-encoding(%hex) must have more than 2 byte strings after '%'.
+        else if (len < i + 3) {
+            goto INVALID_PCT;
+        }
+        /*
+            hex(8bit) to decimal
+            e.g.
+                hex:'%41'
+                '4' to hex:0x04[0000 0100]
+                '1' to hex:0x01[0000 0001]
+                0x04[0000 0100] << 4bit
+                0x40[0100 0000] | 0x01[0000 0001]
+                0x41[0100 0001]
+                0x41 = 65 = 'A'
+
+                hex:'%7a'
+                '7' to hex:0x07[0000 0111]
+                'a' to hex:0x0a[0000 1010]
+                0x07[0000 0111] << 4bit
+                0x70[0111 0000] | 0x0a[0000 1010]
+                0x7a[0111 1010]
+                0x7a:122 = 'z'
+
+                hex:'%7a4'
+                '7' to hex:0x07[0000 0111]
+                'a' to hex:0x0a[0000 1010]
+                '4' to hex:0x04[0000 0100]
+                0x007[0000 0000 0111] << 8bit
+                0x00a[0000 0000 1010] << 4bit
+                0x70[0111 0000 0000] | [0000 1010 0000] | 0x04[0000 0100]
+                0x7a4[0111 1010 0100] = 1956
+        */
+        // %[hex]*2
+        else if (HEX2DEC[s[1]] && HEX2DEC[s[2]]) {
+            /*
+                hi = HEX2DEC( s[1] )-1  << 4;
+                lo = HEX2DEC( s[2] )-1;
+                hl = hi | lo;
+            */
+            uint32_t hl = ((HEX2DEC[s[1]] - 1) << 4) | (HEX2DEC[s[2]] - 1);
+
+            // decodeURI did not decode the following characters: '#$&+,/:;=?@'
+            if (type == URL_DECODE_URI) {
+                switch (hl) {
+                case '#':
+                case '$':
+                case '&':
+                case '+':
+                case ',':
+                case '/':
+                case ':':
+                case ';':
+                case '=':
+                case '?':
+                case '@':
+                    if (strict && u8.need) {
+                        goto INVALID_UTF8;
+                    }
+                    p[0] = s[0];
+                    p[1] = s[1];
+                    p[2] = s[2];
+                    p += 3;
+                    i += 2;
+                    continue;
+                }
+            }
+            if (strict && utf8_next(&u8, hl, i)) {
+                goto INVALID_UTF8;
+            }
+            *p++ = hl;
+            i += 2;
+            continue;
+        }
+        // %u[hex]*4
+        else if (s[1] == 'u' && i + 5 < len && HEX2DEC[s[2]] &&
+                 HEX2DEC[s[3]] && HEX2DEC[s[4]] && HEX2DEC[s[5]]) {
+            uint32_t hi = (HEX2DEC[s[2]] - 1) << 4 | (HEX2DEC[s[3]] - 1);
+            uint32_t lo = (HEX2DEC[s[4]] - 1) << 4 | (HEX2DEC[s[5]] - 1);
+            uint32_t hl = (hi << 8) | lo;
+            int n       = 0;
+
+            // the code point must not break the preceding sequence
+            if (strict && u8.need) {
+                goto INVALID_UTF8;
+            }
+            n = unicode_pt2utf8(p, hl);
+            if (n > 0) {
+                p += n;
+                i += 5;
+                continue;
+            } else if (n == -2 && hl < 0xDC00 && i + 11 < len) {
+                // surrogate pairs: a high surrogate followed by a low one
+                if (s[6] == '%' && s[7] == 'u' && HEX2DEC[s[8]] &&
+                    HEX2DEC[s[9]] && HEX2DEC[s[10]] && HEX2DEC[s[11]]) {
+                    uint32_t surp = 0x10000 + (hl - 0xD800) * 0x400;
+                    uint32_t low  = 0;
+
+                    hi  = (HEX2DEC[s[8]] - 1) << 4 | (HEX2DEC[s[9]] - 1);
+                    lo  = (HEX2DEC[s[10]] - 1) << 4 | (HEX2DEC[s[11]] - 1);
+                    low = (hi << 8) | lo;
+                    if (low > 0xDBFF && low < 0xE000) {
+                        n = unicode_pt2utf8(p, surp + low - 0xDC00);
+                        p += n;
+                        i += 11;
+                        continue;
+                    }
+                }
+            }
+        }
+
+INVALID_PCT:
+        if (!lenient) {
+            *epos = i;
+            return -1;
+        }
+        // copy the '%' as it is, and decode the rest from the next byte
+        if (strict && utf8_next(&u8, '%', i)) {
+            goto INVALID_UTF8;
+        }
+        *p++ = '%';
+        ninvalid++;
+    }
+
+    if (strict && u8.need) {
+        // truncated sequence
+        goto INVALID_UTF8;
+    }
+    if (lenient) {
+        *epos = ninvalid;
+    }
+    *cur = i;
+    return p - dst;
+
+INVALID_UTF8:
+    *epos = u8.head;
+    return -1;
+}
+
+ssize_t url_decode(unsigned char *dst, const unsigned char *src, size_t len,
+                   url_decode_type_e type, size_t *epos)
+{
+    size_t cur  = 0;
+    int lenient = type & URL_DECODE_LENIENT;
+
+    type &= ~URL_DECODE_LENIENT;
+    if (type & URL_DECODE_UTF8) {
+        return decode(dst, src, len, type & ~URL_DECODE_UTF8, &cur, len, epos,
+                      1, lenient);
+    }
+    return decode(dst, src, len, type, &cur, len, epos, 0, lenient);
+}
+
+ssize_t url_decode_step(unsigned char *dst, const unsigned char *src,
+                        size_t len, url_decode_type_e type, size_t *cur,
+                        size_t stop, size_t *epos)
+{
+    int lenient = type & URL_DECODE_LENIENT;
+
+    type &= ~URL_DECODE_LENIENT;
+    if (type & URL_DECODE_UTF8) {
+        return decode(dst, src, len, type & ~URL_DECODE_UTF8, cur, stop, epos,
+                      1, lenient);
+    }
+    return decode(dst, src, len, type, cur, stop, epos, 0, lenient);
+}
+
+/**
+ *  base64
+ *
+ *  the "forgiving-base64 decode" of the WHATWG Infra Standard:
+ *  the ASCII whitespace is ignored, the padding is optional, and the data
+ *  must not have the trailing single sextet.
+ */
+
+#define B64_INVALID -1
+#define B64_SPACE   -2
+#define B64_PAD     -3
+
+static const signed char BASE64[256] = {
+    [0 ... 255] = B64_INVALID,
+    // ASCII whitespace
+    ['\t'] = B64_SPACE, ['\n'] = B64_SPACE, ['\f'] = B64_SPACE,
+    ['\r'] = B64_SPACE, [' '] = B64_SPACE,
+    ['='] = B64_PAD,
+    ['A'] = 0, ['B'] = 1, ['C'] = 2, ['D'] = 3, ['E'] = 4, ['F'] = 5,
+    ['G'] = 6, ['H'] = 7, ['I'] = 8, ['J'] = 9, ['K'] = 10, ['L'] = 11,
+    ['M'] = 12, ['N'] = 13, ['O'] = 14, ['P'] = 15, ['Q'] = 16, ['R'] = 17,
+    ['S'] = 18, ['T'] = 19, ['U'] = 20, ['V'] = 21, ['W'] = 22, ['X'] = 23,
+    ['Y'] = 24, ['Z'] = 25, ['a'] = 26, ['b'] = 27, ['c'] = 28, ['d'] = 29,
+    ['e'] = 30, ['f'] = 31, ['g'] = 32, ['h'] = 33, ['i'] = 34, ['j'] = 35,
+    ['k'] = 36, ['l'] = 37, ['m'] = 38, ['n'] = 39, ['o'] = 40, ['p'] = 41,
+    ['q'] = 42, ['r'] = 43, ['s'] = 44, ['t'] = 45, ['u'] = 46, ['v'] = 47,
+    ['w'] = 48, ['x'] = 49, ['y'] = 50, ['z'] = 51, ['0'] = 52, ['1'] = 53,
+    ['2'] = 54, ['3'] = 55, ['4'] = 56, ['5'] = 57, ['6'] = 58, ['7'] = 59,
+    ['8'] = 60, ['9'] = 61, ['+'] = 62, ['/'] = 63,
+};
+
+#ifdef URL_USE_SSE2
+
+# define in_range_epi8(v, lo, hi)                                              \
+        _mm_and_si128(_mm_cmpgt_epi8((v), _mm_set1_epi8((lo) - 1)),              \
+                      _mm_cmpgt_epi8(_mm_set1_epi8((hi) + 1), (v)))
+
+/**
+ *  decode 16 bytes of the base64 alphabet into 12 bytes.
+ *  returns 0 without writing if the block contains other bytes.
+ *  dst must have room for 16 bytes.
+ */
+static inline int decode_base64_block(unsigned char *dst,
+                                      const unsigned char *src)
+{
+    __m128i v     = _mm_loadu_si128((const __m128i *)src);
+    // the bytes above 0x7f are negative and never in range
+    __m128i upper = in_range_epi8(v, 'A', 'Z');
+    __m128i lower = in_range_epi8(v, 'a', 'z');
+    __m128i digit = in_range_epi8(v, '0', '9');
+    __m128i plus  = _mm_cmpeq_epi8(v, _mm_set1_epi8('+'));
+    __m128i slash = _mm_cmpeq_epi8(v, _mm_set1_epi8('/'));
+    __m128i off   = _mm_or_si128(
+          _mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')),
+                       _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+          _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+                       _mm_or_si128(_mm_and_si128(plus, _mm_set1_epi8(62 - '+')),
+                                    _mm_and_si128(slash,
+                                                  _mm_set1_epi8(63 - '/')))));
+
+    if (_mm_movemask_epi8(_mm_or_si128(
+            _mm_or_si128(upper, lower),
+            _mm_or_si128(digit, _mm_or_si128(plus, slash)))) != 0xffff) {
+        return 0;
+    }
+    v = _mm_add_epi8(v, off);
+
+    // merge the sextets: a b c d -> (a << 18 | b << 12 | c << 6 | d) in
+    // every 32-bit lane
+    v = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi16(0xff)), 6),
+                     _mm_srli_epi16(v, 8));
+    v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+    // write the 3 bytes of every lane in the big-endian
+    {
+        uint32_t lane[4];
+
+        _mm_storeu_si128((__m128i *)lane, v);
+        for (int i = 0; i < 4; i++) {
+            uint32_t w = __builtin_bswap32(lane[i] << 8);
+            memcpy(dst + i * 3, &w, 4);
+        }
+    }
+    return 1;
+}
+
+#endif
+
+ssize_t url_decode_base64(unsigned char *dst, const unsigned char *src,
+                          size_t len, size_t *epos)
+{
+    unsigned char *p = dst;
+    size_t i         = 0;
+    // head position of the incomplete quantum
+    size_t head      = 0;
+    uint32_t acc     = 0;
+    int n            = 0;
+
+    while (i < len) {
+        if (!n) {
+#ifdef URL_USE_SSE2
+            // the output is never ahead of the input, so that the 16 bytes
+            // store is in the room of the source length
+            while (i + 16 <= len && decode_base64_block(p, src + i)) {
+                p += 12;
+                i += 16;
+            }
+#endif
+            // decode the quantum of 4 sextets
+            while (i + 4 <= len) {
+                int a = BASE64[src[i]];
+                int b = BASE64[src[i + 1]];
+                int c = BASE64[src[i + 2]];
+                int d = BASE64[src[i + 3]];
+
+                uint32_t v;
+
+                if ((a | b | c | d) < 0) {
+                    break;
+                }
+                v    = (uint32_t)a << 18 | b << 12 | c << 6 | d;
+                p[0] = v >> 16;
+                p[1] = v >> 8;
+                p[2] = v;
+                p += 3;
+                i += 4;
+            }
+            if (i == len) {
+                break;
+            }
+            head = i;
+        }
+
+        switch (BASE64[src[i]]) {
+        case B64_SPACE:
+            break;
+
+        case B64_INVALID:
+            *epos = i;
+            return -1;
+
+        case B64_PAD:
+            // the padding must complete the quantum and be followed by the
+            // whitespace only
+            if (n < 2) {
+                *epos = i;
+                return -1;
+            }
+            head = i;
+            for (int npad = 4 - n; i < len; i++) {
+                if (src[i] == '=' ? !npad-- : BASE64[src[i]] != B64_SPACE) {
+                    *epos = i;
+                    return -1;
+                } else if (i + 1 == len && npad) {
+                    // incomplete padding
+                    *epos = head;
+                    return -1;
+                }
+            }
+            goto DONE;
+
+        default:
+            acc = acc << 6 | BASE64[src[i]];
+            if (++n == 4) {
+                p[0] = acc >> 16;
+                p[1] = acc >> 8;
+                p[2] = acc;
+                p += 3;
+                n   = 0;
+                acc = 0;
+            }
+        }
+        i++;
+    }
+
+DONE:
+    switch (n) {
+    case 1:
+        // the single sextet cannot make a byte
+        *epos = head;
+        return -1;
+    case 2:
+        *p++ = acc >> 4;
+        break;
+    case 3:
+        *p++ = acc >> 10;
+        *p++ = acc >> 2;
+        break;
+    }
+    return p - dst;
+}
+
+// minimum capacity of the buffer
+#define MIN_CAP 64
+
+unsigned char *url_reserve(unsigned char **data, size_t len, size_t *cap,
+                           size_t size)
+{
+    if (*cap - len < size) {
+        size_t ncap      = *cap ? *cap : MIN_CAP;
+        unsigned char *p = NULL;
+
+        if (size > SIZE_MAX - len) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        while (ncap - len < size) {
+            ncap = (ncap > SIZE_MAX / 2) ? len + size : ncap * 2;
+        }
+        if (!(p = realloc(*data, ncap))) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        *data = p;
+        *cap  = ncap;
+    }
+    return *data + len;
+}
@@ -0,0 +1,524 @@
+/**
+ *  Copyright (C) 2017 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *
+ *  src/url_idna.c
+ *  lua-url
+ *
+ *  conversion of the host name between the Unicode and the ASCII form with
+ *  the punycode (RFC 3492).
+ *  NOTE: the mapping and the validation of the IDNA (UTS #46) are not
+ *  implemented. only the ASCII characters are lowercased.
+ */
+
+// lua-url
+#include "url.h"
+// system
+#include <string.h>
+
+// RFC 3492 6. Bootstring parameters
+#define PUNY_BASE         36
+#define PUNY_TMIN         1
+#define PUNY_TMAX         26
+#define PUNY_SKEW         38
+#define PUNY_DAMP         700
+#define PUNY_INITIAL_BIAS 72
+#define PUNY_INITIAL_N    0x80
+
+// maximum length of the label (RFC 1035)
+#define MAX_LABEL 63
+
+static inline unsigned char lower(unsigned char c)
+{
+    return ('A' <= c && c <= 'Z') ? c | 0x20 : c;
+}
+
+static inline int hexval(unsigned char c)
+{
+    switch (c) {
+    case '0' ... '9':
+        return c - '0';
+    case 'A' ... 'F':
+        return c - 'A' + 10;
+    case 'a' ... 'f':
+        return c - 'a' + 10;
+    default:
+        return -1;
+    }
+}
+
+/**
+ *  returns the next byte of the host name at *pos, and decodes it if it is
+ *  the percent-encoded byte. returns -1 if the percent-encoded sequence is
+ *  invalid.
+ */
+static inline int next_byte(const unsigned char *src, size_t len, size_t *pos)
+{
+    size_t i = *pos;
+
+    if (src[i] == '%') {
+        int hi = (len - i > 2) ? hexval(src[i + 1]) : -1;
+        int lo = (hi >= 0) ? hexval(src[i + 2]) : -1;
+        if (lo < 0) {
+            return -1;
+        }
+        *pos = i + 3;
+        return (hi << 4) | lo;
+    }
+    *pos = i + 1;
+    return src[i];
+}
+
+// RFC 3492 6.1 Bias adaptation function
+static uint32_t adapt(uint32_t delta, uint32_t numpoints, int firsttime)
+{
+    uint32_t k = 0;
+
+    delta = firsttime ? delta / PUNY_DAMP : delta / 2;
+    delta += delta / numpoints;
+    while (delta > ((PUNY_BASE - PUNY_TMIN) * PUNY_TMAX) / 2) {
+        delta /= PUNY_BASE - PUNY_TMIN;
+        k += PUNY_BASE;
+    }
+    return k + (PUNY_BASE - PUNY_TMIN + 1) * delta / (delta + PUNY_SKEW);
+}
+
+static inline uint32_t threshold(uint32_t k, uint32_t bias)
+{
+    if (k <= bias) {
+        return PUNY_TMIN;
+    } else if (k >= bias + PUNY_TMAX) {
+        return PUNY_TMAX;
+    }
+    return k - bias;
+}
+
+static inline unsigned char encode_digit(uint32_t d)
+{
+    // 0-25 = a-z, 26-35 = 0-9
+    return d < 26 ? 'a' + d : '0' + d - 26;
+}
+
+static inline uint32_t decode_digit(unsigned char c)
+{
+    switch (c) {
+    case '0' ... '9':
+        return c - '0' + 26;
+    case 'A' ... 'Z':
+        return c - 'A';
+    case 'a' ... 'z':
+        return c - 'a';
+    default:
+        return PUNY_BASE;
+    }
+}
+
+/**
+ *  RFC 3492 6.3 Encoding procedure
+ *  returns the number of bytes written to dst, or -1 if the output exceeds
+ *  the size.
+ */
+static int punycode_encode(unsigned char *dst, size_t size,
+                           const uint32_t *cps, size_t ncp)
+{
+    uint32_t n     = PUNY_INITIAL_N;
+    uint32_t delta = 0;
+    uint32_t bias  = PUNY_INITIAL_BIAS;
+    size_t h       = 0;
+    size_t b       = 0;
+    size_t out     = 0;
+
+    // copy the basic code points
+    for (size_t i = 0; i < ncp; i++) {
+        if (cps[i] < 0x80) {
+            if (out == size) {
+                return -1;
+            }
+            dst[out++] = cps[i];
+        }
+    }
+    h = b = out;
+    if (b) {
+        if (out == size) {
+            return -1;
+        }
+        dst[out++] = '-';
+    }
+
+    while (h < ncp) {
+        uint32_t m = UINT32_MAX;
+
+        // find the smallest code point that is greater than or equal to n
+        for (size_t i = 0; i < ncp; i++) {
+            if (cps[i] >= n && cps[i] < m) {
+                m = cps[i];
+            }
+        }
+        // the code points are less than 0x110000 and ncp is at most 63, so
+        // delta never overflows
+        delta += (m - n) * (h + 1);
+        n = m;
+
+        for (size_t i = 0; i < ncp; i++) {
+            if (cps[i] < n) {
+                delta++;
+            } else if (cps[i] == n) {
+                uint32_t q = delta;
+
+                for (uint32_t k = PUNY_BASE;; k += PUNY_BASE) {
+                    uint32_t t = threshold(k, bias);
+                    if (q < t) {
+                        break;
+                    } else if (out == size) {
+                        return -1;
+                    }
+                    dst[out++] = encode_digit(t + (q - t) % (PUNY_BASE - t));
+                    q          = (q - t) / (PUNY_BASE - t);
+                }
+                if (out == size) {
+                    return -1;
+                }
+                dst[out++] = encode_digit(q);
+                bias       = adapt(delta, h + 1, h == b);
+                delta      = 0;
+                h++;
+            }
+        }
+        delta++;
+        n++;
+    }
+
+    return out;
+}
+
+/**
+ *  RFC 3492 6.2 Decoding procedure
+ *  returns the number of code points written to cps, or -1 if the input is
+ *  invalid.
+ */
+static int punycode_decode(uint32_t *cps, const unsigned char *src, size_t len)
+{
+    uint32_t n    = PUNY_INITIAL_N;
+    uint32_t i    = 0;
+    uint32_t bias = PUNY_INITIAL_BIAS;
+    size_t ncp    = 0;
+    size_t b      = 0;
+    size_t in     = 0;
+
+    // copy the code points before the last delimiter
+    for (size_t j = 0; j < len; j++) {
+        if (src[j] == '-') {
+            b = j;
+            in = j + 1;
+        }
+    }
+    for (size_t j = 0; j < b; j++) {
+        if (src[j] >= 0x80) {
+            return -1;
+        }
+        cps[ncp++] = lower(src[j]);
+    }
+
+    while (in < len) {
+        uint32_t oldi = i;
+        uint32_t w    = 1;
+
+        for (uint32_t k = PUNY_BASE;; k += PUNY_BASE) {
+            uint32_t digit = 0;
+            uint32_t t     = 0;
+
+            if (in >= len ||
+                (digit = decode_digit(src[in++])) >= PUNY_BASE ||
+                digit > (UINT32_MAX - i) / w) {
+                return -1;
+            }
+            i += digit * w;
+            t = threshold(k, bias);
+            if (digit < t) {
+                break;
+            } else if (w > UINT32_MAX / (PUNY_BASE - t)) {
+                return -1;
+            }
+            w *= PUNY_BASE - t;
+        }
+
+        bias = adapt(i - oldi, ncp + 1, oldi == 0);
+        if (i / (ncp + 1) > UINT32_MAX - n) {
+            return -1;
+        }
+        n += i / (ncp + 1);
+        i %= (ncp + 1);
+        // basic code points must be encoded literally, and surrogates and the
+        // code points greater than 0x10FFFF are not allowed
+        if (n < 0x80 || (n >= 0xD800 && n <= 0xDFFF) || n > 0x10FFFF ||
+            ncp == MAX_LABEL) {
+            return -1;
+        }
+        // insert n at position i
+        for (size_t j = ncp; j > i; j--) {
+            cps[j] = cps[j - 1];
+        }
+        cps[i++] = n;
+        ncp++;
+    }
+
+    return ncp;
+}
+
+/**
+ *  decode the UTF-8 sequence of the label into the code points.
+ *  returns the number of code points, or -1 if the sequence is invalid or
+ *  the label is too long.
+ */
+static int utf8_decode(uint32_t *cps, const unsigned char *src, size_t len)
+{
+    size_t ncp = 0;
+
+    for (size_t i = 0; i < len; ncp++) {
+        unsigned char c = src[i++];
+        uint32_t cp     = 0;
+        uint32_t min    = 0;
+        size_t nbyte    = 0;
+
+        if (ncp == MAX_LABEL) {
+            return -1;
+        } else if (c < 0x80) {
+            cps[ncp] = c;
+            continue;
+        } else if (c >= 0xC2 && c <= 0xDF) {
+            cp    = c & 0x1F;
+            min   = 0x80;
+            nbyte = 1;
+        } else if (c >= 0xE0 && c <= 0xEF) {
+            cp    = c & 0x0F;
+            min   = 0x800;
+            nbyte = 2;
+        } else if (c >= 0xF0 && c <= 0xF4) {
+            cp    = c & 0x07;
+            min   = 0x10000;
+            nbyte = 3;
+        } else {
+            return -1;
+        }
+
+        if (len - i < nbyte) {
+            return -1;
+        }
+        for (; nbyte; nbyte--) {
+            c = src[i++];
+            if ((c & 0xC0) != 0x80) {
+                return -1;
+            }
+            cp = (cp << 6) | (c & 0x3F);
+        }
+        // overlong sequences, surrogates and out of range
+        if (cp < min || (cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF) {
+            return -1;
+        }
+        cps[ncp] = cp;
+    }
+
+    return ncp;
+}
+
+static inline unsigned char *utf8_encode(unsigned char *p, uint32_t cp)
+{
+    if (cp < 0x80) {
+        *p++ = cp;
+    } else if (cp < 0x800) {
+        *p++ = 0xC0 | (cp >> 6);
+        *p++ = 0x80 | (cp & 0x3F);
+    } else if (cp < 0x10000) {
+        *p++ = 0xE0 | (cp >> 12);
+        *p++ = 0x80 | ((cp >> 6) & 0x3F);
+        *p++ = 0x80 | (cp & 0x3F);
+    } else {
+        *p++ = 0xF0 | (cp >> 18);
+        *p++ = 0x80 | ((cp >> 12) & 0x3F);
+        *p++ = 0x80 | ((cp >> 6) & 0x3F);
+        *p++ = 0x80 | (cp & 0x3F);
+    }
+    return p;
+}
+
+/**
+ *  returns 1 if the label ends with the full stop of the ideographic or
+ *  fullwidth form that are treated as the label separator.
+ *  U+3002 = E3 80 82, U+FF0E = EF BC 8E, U+FF61 = EF BD A1
+ */
+static inline int is_fullstop(const unsigned char *label, size_t len)
+{
+    const unsigned char *c = label + len - 3;
+
+    return len >= 3 && ((c[0] == 0xE3 && c[1] == 0x80 && c[2] == 0x82) ||
+                        (c[0] == 0xEF && c[1] == 0xBC && c[2] == 0x8E) ||
+                        (c[0] == 0xEF && c[1] == 0xBD && c[2] == 0xA1));
+}
+
+/**
+ *  returns the number of the code points decoded from the lowercased punycode
+ *  label to cps, or 0 if the label is invalid, has no non-ASCII characters or
+ *  is not the canonical form that is generated by the encoder.
+ */
+static int is_punycode(uint32_t *cps, const unsigned char *src, size_t len)
+{
+    unsigned char enc[MAX_LABEL];
+    int ncp = 0;
+
+    if (len + 4 <= MAX_LABEL && (ncp = punycode_decode(cps, src, len)) > 0 &&
+        punycode_encode(enc, sizeof(enc), cps, ncp) == (int)len &&
+        memcmp(enc, src, len) == 0) {
+        for (int i = 0; i < ncp; i++) {
+            if (cps[i] >= 0x80) {
+                return ncp;
+            }
+        }
+    }
+    return 0;
+}
+
+ssize_t url_host_to_ascii(unsigned char *dst, const unsigned char *src,
+                          size_t len, size_t *epos)
+{
+    // the bytes of the label that contains the non-ASCII characters
+    unsigned char label[MAX_LABEL * 4];
+    uint32_t cps[MAX_LABEL];
+    unsigned char *p = dst;
+    size_t pos       = 0;
+
+    for (;;) {
+        size_t head          = pos;
+        unsigned char *lhead = p;
+        size_t nbyte         = 0;
+        // number of the non-ASCII bytes
+        size_t nonascii      = 0;
+        int sep              = 0;
+        int ncp              = 0;
+
+        // split and lowercase the label in the same pass
+        while (pos < len) {
+            int c = next_byte(src, len, &pos);
+
+            if (c < 0) {
+                *epos = head;
+                return -1;
+            } else if (c == '.') {
+                sep = 1;
+                break;
+            } else if (c >= 0x80) {
+                nonascii++;
+            }
+            if (nbyte < sizeof(label)) {
+                label[nbyte] = lower(c);
+            }
+            nbyte++;
+            if (nonascii >= 3 && nbyte <= sizeof(label) &&
+                is_fullstop(label, nbyte)) {
+                // remove the first 2 bytes of the full stop
+                p -= 2;
+                nbyte -= 3;
+                nonascii -= 3;
+                sep = 1;
+                break;
+            }
+            *p++ = lower(c);
+        }
+
+        if (!nonascii) {
+            // the "xn--" label must be a valid punycode
+            if (nbyte > MAX_LABEL ||
+                (nbyte >= 4 && lhead[0] == 'x' && lhead[1] == 'n' &&
+                 lhead[2] == '-' && lhead[3] == '-' &&
+                 !is_punycode(cps, lhead + 4, nbyte - 4))) {
+                *epos = head;
+                return -1;
+            }
+        } else {
+            // encode the label to punycode
+            p = lhead;
+            if (nbyte > sizeof(label) ||
+                (ncp = utf8_decode(cps, label, nbyte)) < 0 ||
+                (ncp = punycode_encode(p + 4, MAX_LABEL - 4, cps, ncp)) < 0) {
+                *epos = head;
+                return -1;
+            }
+            p[0] = 'x';
+            p[1] = 'n';
+            p[2] = '-';
+            p[3] = '-';
+            p += 4 + ncp;
+        }
+
+        if (!sep) {
+            return p - dst;
+        }
+        *p++ = '.';
+    }
+}
+
+ssize_t url_host_to_unicode(unsigned char *dst, const unsigned char *src,
+                            size_t len, size_t *epos)
+{
+    uint32_t cps[MAX_LABEL];
+    unsigned char *p = dst;
+    size_t pos       = 0;
+
+    for (;;) {
+        size_t head          = pos;
+        unsigned char *lhead = p;
+        size_t llen          = 0;
+        int sep              = 0;
+
+        // split and lowercase the label in the same pass
+        while (pos < len) {
+            int c = next_byte(src, len, &pos);
+            if (c < 0) {
+                *epos = head;
+                return -1;
+            } else if (c == '.') {
+                sep = 1;
+                break;
+            }
+            *p++ = lower(c);
+        }
+
+        llen = p - lhead;
+        if (llen >= 4 && lhead[0] == 'x' && lhead[1] == 'n' &&
+            lhead[2] == '-' && lhead[3] == '-') {
+            // decode the punycode label. the label that has no non-ASCII
+            // characters must not be encoded
+            int ncp = is_punycode(cps, lhead + 4, llen - 4);
+            if (!ncp) {
+                *epos = head;
+                return -1;
+            }
+            p = lhead;
+            for (int i = 0; i < ncp; i++) {
+                p = utf8_encode(p, cps[i]);
+            }
+        }
+
+        if (!sep) {
+            return p - dst;
+        }
+        *p++ = '.';
+    }
+}
@@ -0,0 +1,499 @@
+/**
+ *  Copyright (C) 2017 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *
+ *  src/url_matcher.c
+ *  lua-url
+ *
+ *  host-suffix and path-prefix matcher.
+ *  the host labels of the rules are stored in the reversed order (e.g.
+ *  "com" -> "example" -> "www") and each host node has its own path trie.
+ *  the edges of both tries are stored in a single open addressing hash table
+ *  keyed by (parent node, label), so that the match time depends on the
+ *  length of the url instead of the number of rules.
+ *  the rule that has the scheme is stored in the host trie whose root is
+ *  connected to the root node with the "scheme:" label, that never collides
+ *  with the host labels.
+ */
+
+// lua-url
+#include "url.h"
+// system
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    // id of the rule that ends at this node, or 0
+    uint32_t id;
+    // root node of the path trie of the host node, or 0
+    uint32_t path;
+} node_t;
+
+typedef struct {
+    // child node of the edge, or 0 if the slot is empty
+    uint32_t child;
+    uint32_t parent;
+    uint32_t hash;
+    uint32_t len;
+    // the key is stored in this field if len is 1, otherwise the offset of
+    // the key in the string pool
+    size_t key;
+} edge_t;
+
+struct url_matcher_s {
+    node_t *nodes;
+    uint32_t nnode;
+    uint32_t node_cap;
+    edge_t *edges;
+    uint32_t nedge;
+    // must be power of 2
+    uint32_t edge_cap;
+    unsigned char *pool;
+    size_t npool;
+    size_t pool_cap;
+};
+
+// the host labels are compared in case-insensitive
+static inline unsigned char lower(unsigned char c)
+{
+    return ('A' <= c && c <= 'Z') ? c | 0x20 : c;
+}
+
+// FNV-1a
+static inline uint32_t hash_key(uint32_t parent, const unsigned char *key,
+                                size_t len, int icase)
+{
+    uint32_t h = 2166136261u;
+
+    for (int i = 0; i < 4; i++) {
+        h = (h ^ ((parent >> (i * 8)) & 0xff)) * 16777619u;
+    }
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (icase ? lower(key[i]) : key[i])) * 16777619u;
+    }
+    return h;
+}
+
+static inline int key_equal(const url_matcher_t *m, const edge_t *e,
+                            const unsigned char *key, size_t len, int icase)
+{
+    const unsigned char *ekey = m->pool + e->key;
+
+    if (len == 1) {
+        return e->key == (icase ? lower(*key) : *key);
+    } else if (!icase) {
+        return memcmp(ekey, key, len) == 0;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (ekey[i] != lower(key[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static uint32_t find_edge(const url_matcher_t *m, uint32_t parent,
+                          const unsigned char *key, size_t len, int icase)
+{
+    uint32_t hash = hash_key(parent, key, len, icase);
+    uint32_t mask = m->edge_cap - 1;
+
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        const edge_t *e = m->edges + i;
+        if (!e->child) {
+            return 0;
+        } else if (e->hash == hash && e->parent == parent && e->len == len &&
+                   key_equal(m, e, key, len, icase)) {
+            return e->child;
+        }
+    }
+}
+
+static int grow_edges(url_matcher_t *m)
+{
+    uint32_t cap   = m->edge_cap * 2;
+    uint32_t mask  = cap - 1;
+    edge_t *edges  = NULL;
+    edge_t *oedges = m->edges;
+
+    if (cap < m->edge_cap || !(edges = calloc(cap, sizeof(edge_t)))) {
+        errno = ENOMEM;
+        return -1;
+    }
+    for (uint32_t i = 0; i < m->edge_cap; i++) {
+        if (oedges[i].child) {
+            uint32_t j = oedges[i].hash & mask;
+            while (edges[j].child) {
+                j = (j + 1) & mask;
+            }
+            edges[j] = oedges[i];
+        }
+    }
+    free(oedges);
+    m->edges    = edges;
+    m->edge_cap = cap;
+    return 0;
+}
+
+static uint32_t new_node(url_matcher_t *m)
+{
+    if (m->nnode == m->node_cap) {
+        uint32_t cap  = m->node_cap * 2;
+        node_t *nodes = NULL;
+
+        if (cap < m->node_cap ||
+            !(nodes = realloc(m->nodes, sizeof(node_t) * cap))) {
+            errno = ENOMEM;
+            return 0;
+        }
+        m->nodes    = nodes;
+        m->node_cap = cap;
+    }
+    m->nodes[m->nnode] = (node_t){0};
+    return m->nnode++;
+}
+
+/**
+ *  returns the child node of the parent that is connected with the key, or
+ *  creates a new one. returns 0 if failed to allocate memory.
+ */
+static uint32_t add_edge(url_matcher_t *m, uint32_t parent,
+                         const unsigned char *key, size_t len, int icase)
+{
+    uint32_t child = find_edge(m, parent, key, len, icase);
+    uint32_t mask  = 0;
+    edge_t e       = {
+              .parent = parent,
+              .hash   = hash_key(parent, key, len, icase),
+              .len    = len,
+    };
+
+    if (child) {
+        return child;
+    } else if (len > UINT32_MAX) {
+        errno = EINVAL;
+        return 0;
+    } else if ((m->nedge + 1) * 2 > m->edge_cap && grow_edges(m)) {
+        return 0;
+    }
+
+    if (len == 1) {
+        e.key = icase ? lower(*key) : *key;
+    } else {
+        // append the key to the string pool
+        if (m->pool_cap - m->npool < len) {
+            size_t cap          = m->pool_cap * 2 + len;
+            unsigned char *pool = realloc(m->pool, cap);
+            if (!pool) {
+                errno = ENOMEM;
+                return 0;
+            }
+            m->pool     = pool;
+            m->pool_cap = cap;
+        }
+        e.key = m->npool;
+        for (size_t i = 0; i < len; i++) {
+            m->pool[m->npool++] = icase ? lower(key[i]) : key[i];
+        }
+    }
+
+    if (!(e.child = new_node(m))) {
+        return 0;
+    }
+    mask = m->edge_cap - 1;
+    for (uint32_t i = e.hash & mask;; i = (i + 1) & mask) {
+        if (!m->edges[i].child) {
+            m->edges[i] = e;
+            m->nedge++;
+            return e.child;
+        }
+    }
+}
+
+url_matcher_t *url_matcher_new(void)
+{
+    url_matcher_t *m = calloc(1, sizeof(url_matcher_t));
+
+    if (m) {
+        m->node_cap = 64;
+        m->edge_cap = 128;
+        m->nodes    = malloc(sizeof(node_t) * m->node_cap);
+        m->edges    = calloc(m->edge_cap, sizeof(edge_t));
+        if (!m->nodes || !m->edges) {
+            url_matcher_free(m);
+            errno = ENOMEM;
+            return NULL;
+        }
+        // root node of the host trie
+        m->nodes[0] = (node_t){0};
+        m->nnode    = 1;
+    }
+    return m;
+}
+
+void url_matcher_free(url_matcher_t *m)
+{
+    if (m) {
+        free(m->nodes);
+        free(m->edges);
+        free(m->pool);
+        free(m);
+    }
+}
+
+// scheme = ALPHA *( ALPHA / DIGIT / "+" / "-" / "." )
+static inline int is_scheme(const unsigned char *str, size_t len)
+{
+    if (!len || !(('a' <= lower(*str) && lower(*str) <= 'z'))) {
+        return 0;
+    }
+    for (size_t i = 1; i < len; i++) {
+        unsigned char c = lower(str[i]);
+        if (!(('a' <= c && c <= 'z') || ('0' <= c && c <= '9') || c == '+' ||
+              c == '-' || c == '.')) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ *  rule    = [ scheme "://" ] [ host ] [ path ]
+ *  host    = label *( "." label ) [ "." ] / "[" ip-literal "]"
+ *  path    = "/" *char
+ */
+int url_matcher_add(url_matcher_t *m, const unsigned char *rule, size_t len,
+                    uint32_t id)
+{
+    size_t head = 0;
+    size_t tail = 0;
+    size_t pos  = 0;
+    uint32_t node = 0;
+
+    if (!id) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // find the scheme
+    for (; pos + 2 < len && rule[pos] != '/'; pos++) {
+        if (rule[pos] == ':' && rule[pos + 1] == '/' && rule[pos + 2] == '/') {
+            if (!is_scheme(rule, pos)) {
+                errno = EINVAL;
+                return -1;
+            }
+            // root of the host trie of the scheme
+            if (!(node = add_edge(m, 0, rule, pos + 1, 1))) {
+                return -1;
+            }
+            head = pos + 3;
+            break;
+        }
+    }
+
+    // find the end of the host
+    for (tail = head; tail < len && rule[tail] != '/'; tail++) {
+    }
+    pos = tail;
+    // ignore the trailing dot
+    if (tail > head && rule[tail - 1] == '.') {
+        tail--;
+    }
+
+    if (tail > head && rule[head] == '[') {
+        // ip-literal is treated as a single label, and the port cannot follow
+        if (rule[tail - 1] != ']') {
+            errno = EINVAL;
+            return -1;
+        } else if (!(node = add_edge(m, node, rule + head, tail - head, 1))) {
+            return -1;
+        }
+        tail = head;
+    } else {
+        // the port and the userinfo cannot be specified
+        for (size_t i = head; i < tail; i++) {
+            if (rule[i] == ':' || rule[i] == '@') {
+                errno = EINVAL;
+                return -1;
+            }
+        }
+    }
+
+    // add host labels in the reversed order
+    while (tail > head) {
+        size_t lhead = tail;
+        while (lhead > head && rule[lhead - 1] != '.') {
+            lhead--;
+        }
+        if (lhead == tail) {
+            // empty label
+            errno = EINVAL;
+            return -1;
+        } else if (!(node = add_edge(m, node, rule + lhead, tail - lhead, 1))) {
+            return -1;
+        } else if (lhead == head) {
+            break;
+        }
+        // skip the dot
+        tail = lhead - 1;
+        if (tail == head) {
+            // starts with the dot
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    // root of the path trie
+    if (!m->nodes[node].path) {
+        uint32_t root = new_node(m);
+        if (!root) {
+            return -1;
+        }
+        m->nodes[node].path = root;
+    }
+    node = m->nodes[node].path;
+
+    // add the path prefix byte by byte
+    for (; pos < len; pos++) {
+        if (!(node = add_edge(m, node, rule + pos, 1, 0))) {
+            return -1;
+        }
+    }
+
+    if (!m->nodes[node].id) {
+        m->nodes[node].id = id;
+    }
+    return 0;
+}
+
+static uint32_t match_path(const url_matcher_t *m, uint32_t node,
+                           const unsigned char *path, size_t len)
+{
+    uint32_t id = m->nodes[node].id;
+
+    for (size_t i = 0; i < len; i++) {
+        if (!(node = find_edge(m, node, path + i, 1, 0))) {
+            break;
+        } else if (m->nodes[node].id) {
+            // longer prefix
+            id = m->nodes[node].id;
+        }
+    }
+    return id;
+}
+
+// maximum number of labels of the hostname is 127
+#define MAX_DEPTH 128
+
+/**
+ *  find the path tries of the host suffixes from the root of the host trie,
+ *  and store them to roots by the number of the labels. returns the number
+ *  of the labels that matched.
+ */
+static int find_roots(const url_matcher_t *m, uint32_t node,
+                      const unsigned char *url, url_span_t host,
+                      uint32_t *roots)
+{
+    size_t tail = host.head + host.len;
+    int depth   = 0;
+
+    roots[0] = m->nodes[node].path;
+    if (host.len && url[tail - 1] == '.') {
+        // ignore the trailing dot
+        tail--;
+    }
+    if (host.len && url[host.head] == '[') {
+        // ip-literal is treated as a single label
+        if ((node = find_edge(m, node, url + host.head, host.len, 1))) {
+            roots[++depth] = m->nodes[node].path;
+        }
+        return depth;
+    }
+
+    while (tail > host.head && depth + 1 < MAX_DEPTH) {
+        size_t lhead = tail;
+        while (lhead > host.head && url[lhead - 1] != '.') {
+            lhead--;
+        }
+        if (lhead == tail ||
+            !(node = find_edge(m, node, url + lhead, tail - lhead, 1))) {
+            break;
+        }
+        roots[++depth] = m->nodes[node].path;
+        if (lhead == host.head) {
+            break;
+        }
+        tail = lhead - 1;
+    }
+    return depth;
+}
+
+uint32_t url_matcher_match(const url_matcher_t *m, const unsigned char *url,
+                           size_t len)
+{
+    url_t u                = {0};
+    url_span_t host        = {0};
+    url_span_t path        = {0};
+    const unsigned char *p = (const unsigned char *)"/";
+    uint32_t roots[MAX_DEPTH];
+    uint32_t sroots[MAX_DEPTH];
+    int depth     = 0;
+    int sdepth    = -1;
+    uint32_t node = 0;
+
+    if (url_parse(&u, url, len, 0, 0)) {
+        // invalid url
+        return 0;
+    }
+    if (u.fields & (1 << URL_HOSTNAME)) {
+        host = u.span[URL_HOSTNAME];
+    }
+    if (u.fields & (1 << URL_PATH)) {
+        path = u.span[URL_PATH];
+        p    = url + path.head;
+    } else if (host.len) {
+        // empty path of the authority is treated as "/"
+        path.len = 1;
+    }
+
+    depth = find_roots(m, 0, url, host, roots);
+    // the span of the scheme is followed by the ':'
+    if ((u.fields & (1 << URL_SCHEME)) &&
+        (node = find_edge(m, 0, url + u.span[URL_SCHEME].head,
+                          u.span[URL_SCHEME].len + 1, 1))) {
+        sdepth = find_roots(m, node, url, host, sroots);
+    }
+
+    // the longest host suffix takes precedence, and then the rule that has
+    // the scheme
+    for (int i = depth > sdepth ? depth : sdepth; i >= 0; i--) {
+        uint32_t id = 0;
+        if (i <= sdepth && sroots[i] &&
+            (id = match_path(m, sroots[i], p, path.len))) {
+            return id;
+        } else if (i <= depth && roots[i] &&
+                   (id = match_path(m, roots[i], p, path.len))) {
+            return id;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,1141 @@
+/**
+ *  Copyright (C) 2017 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  src/url_parse.c
+ *  lua-url
+ *
+ *  Lua-free url parser.
+ *
+ */
+
+// lua-url
+#include "url.h"
+// system
+#include <errno.h>
+#include <stddef.h>
+#if defined(__SSE2__) && !defined(URL_NO_SIMD)
+# define URL_USE_SSE2
+# include <emmintrin.h>
+#endif
+
+const char *const URL_FIELD_NAMES[URL_NFIELD] = {
+    [URL_SCHEME]   = "scheme",
+    [URL_USERINFO] = "userinfo",
+    [URL_USER]     = "user",
+    [URL_PASSWORD] = "password",
+    [URL_HOST]     = "host",
+    [URL_HOSTNAME] = "hostname",
+    [URL_PORT]     = "port",
+    [URL_PATH]     = "path",
+    [URL_QUERY]    = "query",
+    [URL_FRAGMENT] = "fragment",
+};
+
+/**
+ *  RFC 3986
+ *
+ *  pct-encoded     = "%" HEXDIG HEXDIG
+ *  pchar           = "!" / "$" / "%" / "&" / "'" / "(" / ")" / "*" / "+" / ","
+ *                  / "-" / "." / ":" / ";" / "=" / "@" / "_" / "~"
+ *                  / ALPHA / DIGIT /
+ *
+ *  userinfo        = *( pchar except "@" )
+ *  hostname        = *( pchar except ":" / "@" )
+ *  query           = *( pchar / "/" / "?" )
+ *  fragment        = *( pchar / "/" / "?" )
+ *
+ *
+ *  WHATWG-URL
+ *
+ *  URL-units           = pct-encoded / URL-code-points
+ *  URL-code-points     = "!" / "$" / "&" / "'" / "(" / ")" / "*" / "+" / ","
+ *                      / "-" / "." / "/" / ":" / ";" / "=" / "?" / "@" / "_"
+ *                      / "~" / ALPHA / DIGIT
+ *
+ *  followings are jump-symbols;
+ *      path-delimiter  = "/"
+ *      port            = ":"
+ *      userinfo        = "@"
+ *      query           = "?"
+ *      fragment        = "#"
+ */
+
+// ranges of the url code points (and "#" and "%")
+#define URIC_ALNUM(v) ['0' ... '9'] = v, ['A' ... 'Z'] = v, ['a' ... 'z'] = v
+#define URIC_MARK(v)                                                           \
+    ['!'] = v, /* 0x23-2F = # $ % & ' ( ) * + , - . / */ ['#' ... '/'] = v,    \
+    [':' ... ';'] = v, ['='] = v, ['?' ... '@'] = v, ['_'] = v, ['~'] = v
+#define URIC(v) URIC_ALNUM(v), URIC_MARK(v)
+
+/**
+ *  character class bitmap
+ */
+#define CC_URIC     0x1
+#define CC_ALPHA    0x2
+#define CC_DIGIT    0x4
+#define CC_HEXDIG   0x8
+#define CC_ALNUM    (CC_ALPHA | CC_DIGIT)
+// ordinary characters of the states that can be skipped without any action
+#define CC_PATH     0x10
+#define CC_HOST     0x20
+#define CC_QUERY    0x40
+#define CC_FRAGMENT 0x80
+#define CC_STATES   (CC_PATH | CC_HOST | CC_QUERY | CC_FRAGMENT)
+
+static const unsigned char CTYPE[256] = {
+    URIC_MARK(CC_URIC | CC_STATES),
+    // delimiters
+    ['%']         = CC_URIC,
+    ['#']         = CC_URIC | CC_FRAGMENT,
+    ['?']         = CC_URIC | CC_QUERY | CC_FRAGMENT,
+    ['/']         = CC_URIC | CC_PATH | CC_QUERY | CC_FRAGMENT,
+    [':']         = CC_URIC | CC_PATH | CC_QUERY | CC_FRAGMENT,
+    ['@']         = CC_URIC | CC_PATH | CC_QUERY | CC_FRAGMENT,
+    ['0' ... '9'] = CC_URIC | CC_STATES | CC_DIGIT | CC_HEXDIG,
+    ['A' ... 'F'] = CC_URIC | CC_STATES | CC_ALPHA | CC_HEXDIG,
+    ['G' ... 'Z'] = CC_URIC | CC_STATES | CC_ALPHA,
+    ['a' ... 'f'] = CC_URIC | CC_STATES | CC_ALPHA | CC_HEXDIG,
+    ['g' ... 'z'] = CC_URIC | CC_STATES | CC_ALPHA,
+};
+
+#define is_alpha(c)  (CTYPE[(c)] & CC_ALPHA)
+#define is_alnum(c)  (CTYPE[(c)] & CC_ALNUM)
+#define is_hexdig(c) (CTYPE[(c)] & CC_HEXDIG)
+
+/**
+ *  pct-encoded     = "%" HEXDIG HEXDIG
+ *  HEXDIG          = "A" / "B" / "C" / "D" / "E" / "F"
+ *                  / "a" / "b" / "c" / "d" / "e" / "f"
+ *                  / DIGIT
+ */
+static inline int is_percentencoded(const unsigned char *str)
+{
+    return is_hexdig(str[0]) && is_hexdig(str[1]);
+}
+
+/**
+ *  transition tables
+ *
+ *  each state of the parser looks up the action of the byte in its own
+ *  table, and jumps to the action with a switch statement.
+ *  the bytes that are not in the table are illegal (A_ILLEGAL = 0).
+ */
+typedef enum {
+    A_ILLEGAL = 0,
+    // ordinary character of the state
+    A_CHAR,
+    // "%" HEXDIG HEXDIG
+    A_PCT,
+    // "/"
+    A_PATH,
+    // "?"
+    A_QUERY,
+    // "#"
+    A_FRAGMENT,
+    // ":"
+    A_COLON,
+    // "@"
+    A_USERINFO,
+    // pathname: the character cannot be used in the scheme
+    A_NOSCHEME,
+} action_e;
+
+// scheme or pathname
+static const unsigned char PATH_ACTION[256] = {
+    URIC_ALNUM(A_CHAR),
+    URIC_MARK(A_NOSCHEME),
+    ['+'] = A_CHAR,
+    ['-'] = A_CHAR,
+    [':'] = A_COLON,
+    ['?'] = A_QUERY,
+    ['#'] = A_FRAGMENT,
+    ['%'] = A_PCT,
+};
+
+// hostname or username
+static const unsigned char HOST_ACTION[256] = {
+    URIC(A_CHAR),
+    ['@'] = A_USERINFO,
+    [':'] = A_COLON,
+    ['/'] = A_PATH,
+    ['?'] = A_QUERY,
+    ['#'] = A_FRAGMENT,
+    ['%'] = A_PCT,
+};
+
+// port number or password
+static const unsigned char PORT_ACTION[256] = {
+    ['0' ... '9'] = A_CHAR,
+    ['/']         = A_PATH,
+    ['?']         = A_QUERY,
+    ['#']         = A_FRAGMENT,
+};
+
+// password
+static const unsigned char PASSWORD_ACTION[256] = {
+    URIC(A_CHAR),
+    [':'] = A_ILLEGAL,
+    ['/'] = A_ILLEGAL,
+    ['?'] = A_ILLEGAL,
+    ['#'] = A_ILLEGAL,
+    ['@'] = A_USERINFO,
+    ['%'] = A_PCT,
+};
+
+// query
+static const unsigned char QUERY_ACTION[256] = {
+    URIC(A_CHAR),
+    ['#'] = A_FRAGMENT,
+    ['%'] = A_PCT,
+};
+
+// fragment
+static const unsigned char FRAGMENT_ACTION[256] = {
+    URIC(A_CHAR),
+    ['%'] = A_PCT,
+};
+
+/**
+ *  skip_chars
+ *  returns the position of the first byte in url[pos, urllen) that is not
+ *  the ordinary character of the state (cls), so that the switch statement of
+ *  the state only runs on the delimiters, '%' and illegal bytes.
+ *  delim must be the uric characters that are not in the cls.
+ */
+#ifdef URL_USE_SSE2
+
+// number of bytes that are checked one by one before the vector loop
+# define SKIP_PROBE 16
+
+static inline size_t skip_chars(const unsigned char *url, size_t pos,
+                                size_t urllen, unsigned char cls,
+                                const char *delim, size_t ndelim)
+{
+    const size_t probe = pos + SKIP_PROBE;
+    __m128i lo, hi, c20, c7b, c02;
+    __m128i d[6];
+    size_t i = 0;
+
+    // the components of the short urls (e.g. the host and the path segments)
+    // and the short runs (e.g. "%XX%XX") are scanned without the setup
+    while (pos < probe && pos < urllen && (CTYPE[url[pos]] & cls)) {
+        pos++;
+    }
+    if (pos < probe) {
+        return pos;
+    } else if (urllen - pos < 16) {
+        goto SKIP_TAIL;
+    }
+
+    lo  = _mm_set1_epi8(0x21);
+    hi  = _mm_set1_epi8(0x7E);
+    c20 = _mm_set1_epi8(0x20);
+    c7b = _mm_set1_epi8(0x7B);
+    c02 = _mm_set1_epi8(0x02);
+    for (; i < ndelim; i++) {
+        d[i] = _mm_set1_epi8(delim[i]);
+    }
+
+    for (; pos + 16 <= urllen; pos += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(url + pos));
+        // 0x00-0x20 and 0x80-0xFF are negative or less than 0x21, and 0x7F
+        __m128i stop =
+            _mm_or_si128(_mm_cmplt_epi8(v, lo), _mm_cmpgt_epi8(v, hi));
+        __m128i t;
+        int mask;
+
+        // " < > ^ `
+        stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+        stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, _mm_set1_epi8('<')));
+        stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, _mm_set1_epi8('>')));
+        stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, _mm_set1_epi8('^')));
+        stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, _mm_set1_epi8('`')));
+        // [ \ ] and { | } are in 0x7B-0x7D by setting the 0x20 bit
+        t    = _mm_sub_epi8(_mm_or_si128(v, c20), c7b);
+        stop = _mm_or_si128(stop, _mm_cmpeq_epi8(_mm_min_epu8(t, c02), t));
+        // delimiters of the state
+        for (i = 0; i < ndelim; i++) {
+            stop = _mm_or_si128(stop, _mm_cmpeq_epi8(v, d[i]));
+        }
+
+        mask = _mm_movemask_epi8(stop);
+        if (mask) {
+            return pos + __builtin_ctz(mask);
+        }
+    }
+
+SKIP_TAIL:
+    while (pos < urllen && (CTYPE[url[pos]] & cls)) {
+        pos++;
+    }
+    return pos;
+}
+
+#else
+
+static inline size_t skip_chars(const unsigned char *url, size_t pos,
+                                size_t urllen, unsigned char cls,
+                                const char *delim, size_t ndelim)
+{
+    (void)delim;
+    (void)ndelim;
+    while (pos < urllen && (CTYPE[url[pos]] & cls)) {
+        pos++;
+    }
+    return pos;
+}
+
+#endif
+
+#define skip_path(url, pos, urllen)                                            \
+    skip_chars((url), (pos), (urllen), CC_PATH, "%?#", 3)
+#define skip_host(url, pos, urllen)                                            \
+    skip_chars((url), (pos), (urllen), CC_HOST, "%?#/:@", 6)
+#define skip_query(url, pos, urllen)                                           \
+    skip_chars((url), (pos), (urllen), CC_QUERY, "%#", 2)
+#define skip_fragment(url, pos, urllen)                                        \
+    skip_chars((url), (pos), (urllen), CC_FRAGMENT, "%", 1)
+
+/**
+ *  IPv4address = dec-octet "." dec-octet "." dec-octet "." dec-octet
+ *  dec-octet   = DIGIT                 ; 0-9
+ *              / %x31-39 DIGIT         ; 10-99
+ *              / "1" 2DIGIT            ; 100-199
+ *              / "2" %x30-34 DIGIT     ; 200-249
+ *              / "25" %x30-35          ; 250-255
+ */
+static int parse_ipv4(const unsigned char *url, size_t urllen, size_t *cur)
+{
+    size_t pos  = *cur;
+    size_t head = pos;
+    int nseg    = 0;
+    int dec     = -1;
+
+    for (; pos < urllen; pos++) {
+        switch (url[pos]) {
+        case '0' ... '9':
+            if (pos - head < 4) {
+                // convert to integer
+                if (dec == -1) {
+                    dec = url[pos] - '0';
+                } else {
+                    dec = (dec << 3) + (dec << 1) + (url[pos] - '0');
+                }
+
+                if (dec <= 0xFF) {
+                    continue;
+                }
+            }
+            break;
+
+        case '.':
+            if (pos - head && nseg < 3) {
+                dec  = -1;
+                head = pos + 1;
+                nseg++;
+                continue;
+            }
+            break;
+
+        default:
+            // done
+            if (nseg == 3 && dec != -1) {
+                *cur = pos;
+                return url[pos];
+            }
+        }
+        break;
+    }
+
+    // illegal byte sequence
+    *cur = pos;
+    return url[head];
+}
+
+/**
+ * IPv6address  =                            6( h16 ":" ) ls32
+ *              /                       "::" 5( h16 ":" ) ls32
+ *              / [               h16 ] "::" 4( h16 ":" ) ls32
+ *              / [ *1( h16 ":" ) h16 ] "::" 3( h16 ":" ) ls32
+ *              / [ *2( h16 ":" ) h16 ] "::" 2( h16 ":" ) ls32
+ *              / [ *3( h16 ":" ) h16 ] "::"    h16 ":"   ls32
+ *              / [ *4( h16 ":" ) h16 ] "::"              ls32
+ *              / [ *5( h16 ":" ) h16 ] "::"              h16
+ *              / [ *6( h16 ":" ) h16 ] "::"
+ *
+ * ls32         = ( h16 ":" h16 ) / IPv4address
+ * h16         = 1*4HEXDIG
+ */
+static int parse_ipv6(const unsigned char *url, size_t urllen, size_t *cur)
+{
+    size_t pos  = *cur;
+    size_t head = 0;
+    int zerogrp = 0;
+    int nbit    = 0;
+
+    if (url[pos] == ':') {
+        zerogrp = url[pos + 1] == ':';
+        // not zero group
+        if (!zerogrp) {
+            return url[pos + 1];
+        }
+        pos += 2;
+        nbit += 16;
+    }
+
+    for (; pos < urllen; pos++) {
+        switch (url[pos]) {
+        // found finish
+        case ']':
+            *cur = pos;
+            return ']';
+
+        // zero-group
+        case ':':
+            // illegal byte sequence
+            // zero group already defined
+            if (zerogrp) {
+                *cur = pos;
+                return url[pos];
+            }
+            nbit += 16;
+            zerogrp = 1;
+            continue;
+
+        // h16
+        case '0' ... '9':
+        case 'A' ... 'F':
+        case 'a' ... 'f':
+            if (nbit < 128) {
+                nbit += 16;
+                head = pos;
+                if (is_hexdig(url[++pos]) && is_hexdig(url[++pos]) &&
+                    is_hexdig(url[++pos])) {
+                    pos++;
+                }
+                switch (url[pos]) {
+                case ':':
+                    if (url[pos + 1] != ']') {
+                        continue;
+                    }
+                    break;
+
+                // found finish
+                case ']':
+                    if (nbit == 128) {
+                        *cur = pos;
+                        return ']';
+                    }
+                    break;
+
+                // embed ipv4
+                case '.':
+                    // if nbit is less than or equal to 112, can be
+                    // embedded ipv4 address (32 bit).
+                    //
+                    //  max nbit = 128 bit(IPv6) - 32 bit(IPv4)
+                    //           = 96
+                    if (nbit <= 112) {
+                        *cur = head;
+                        return parse_ipv4(url, urllen, cur);
+                    }
+                    break;
+                }
+            }
+        }
+
+        break;
+    }
+
+    // illegal byte sequence
+    *cur = pos;
+    return url[pos];
+}
+
+static inline void set_span(url_t *u, url_field_e field, size_t head,
+                            size_t len)
+{
+    u->fields |= 1 << field;
+    u->span[field] = (url_span_t){head, len};
+}
+
+static inline int parse_query(url_t *u, const unsigned char *url,
+                              size_t urllen, size_t *cur)
+{
+    size_t head = *cur;
+    size_t pos  = 0;
+
+    // skip query delimiter
+    if (url[head] == '?') {
+        head++;
+    }
+    // skip param separator
+    while (url[head] == '&') {
+        head++;
+    }
+    pos = head;
+
+    for (; (pos = skip_query(url, pos, urllen)) < urllen; pos++) {
+        switch (QUERY_ACTION[url[pos]]) {
+        // illegal byte sequence
+        case A_ILLEGAL:
+            // fallthrough
+
+        // fragment
+        case A_FRAGMENT:
+            goto PARSE_DONE;
+
+        // percent-encoded
+        case A_PCT:
+            // invalid percent-encoded format
+            if (!is_percentencoded(url + pos + 1)) {
+                goto PARSE_DONE;
+            }
+            // skip "%<HEX>"
+            pos += 2;
+        }
+    }
+
+PARSE_DONE:
+    // add query field
+    if (pos > head) {
+        set_span(u, URL_QUERY, *cur, pos - *cur);
+    }
+    *cur = pos;
+    // urllen may be shorter than the string (e.g. the request-target)
+    return pos < urllen ? url[pos] : 0;
+}
+
+/**
+ * fragment      = *( pchar / "/" / "?" )
+ * pchar         = unreserved / pct-encoded / sub-delims / ":" / "@"
+ * unreserved    = ALPHA / DIGIT / "-" / "." / "_" / "~"
+ * pct-encoded   = "%" HEXDIG HEXDIG
+ * sub-delims    = "!" / "$" / "&" / "'" / "(" / ")"
+ *               / "*" / "+" / "," / ";" / "="
+ */
+static int parse_fragment(url_t *u, const unsigned char *url, size_t urllen,
+                          size_t *cur)
+{
+    size_t pos  = *cur;
+    size_t head = pos;
+
+    // parse fragment
+    for (; (pos = skip_fragment(url, pos, urllen)) < urllen; pos++) {
+        switch (FRAGMENT_ACTION[url[pos]]) {
+        // illegal byte sequence
+        case A_ILLEGAL:
+            set_span(u, URL_FRAGMENT, head, pos - head);
+            *cur = pos;
+            return url[pos];
+
+        // percent-encoded
+        case A_PCT:
+            // invalid percent-encoded format
+            if (!is_percentencoded(url + pos + 1)) {
+                *cur = pos;
+                return '%';
+            }
+            // skip "%<HEX>"
+            pos += 2;
+        }
+    }
+
+    set_span(u, URL_FRAGMENT, head, pos - head);
+    *cur = pos;
+
+    return 0;
+}
+
+/*
+ URI           = scheme ":" hier-part [ "?" query ] [ "#" fragment ]
+
+ host          = IP-literal / IPv4address / reg-name
+
+ IP-literal    = "[" ( IPv6address / IPvFuture  ) "]"
+
+ IPvFuture     = "v" 1*HEXDIG "." 1*( unreserved / sub-delims / ":" )
+
+ IPv6address   =                            6( h16 ":" ) ls32
+               /                       "::" 5( h16 ":" ) ls32
+               / [               h16 ] "::" 4( h16 ":" ) ls32
+               / [ *1( h16 ":" ) h16 ] "::" 3( h16 ":" ) ls32
+               / [ *2( h16 ":" ) h16 ] "::" 2( h16 ":" ) ls32
+               / [ *3( h16 ":" ) h16 ] "::"    h16 ":"   ls32
+               / [ *4( h16 ":" ) h16 ] "::"              ls32
+               / [ *5( h16 ":" ) h16 ] "::"              h16
+               / [ *6( h16 ":" ) h16 ] "::"
+
+ h16           = 1*4HEXDIG
+ ls32          = ( h16 ":" h16 ) / IPv4address
+
+ IPv4address   = dec-octet "." dec-octet "." dec-octet "." dec-octet
+ dec-octet     = DIGIT                 ; 0-9
+               / %x31-39 DIGIT         ; 10-99
+               / "1" 2DIGIT            ; 100-199
+               / "2" %x30-34 DIGIT     ; 200-249
+               / "25" %x30-35          ; 250-255
+
+*/
+static inline __attribute__((always_inline)) int
+parse(url_t *u, const unsigned char *url, size_t urllen, size_t cur,
+      int is_querystring, const int authority, const int hostport)
+{
+    unsigned char c   = 0;
+    size_t head       = 0;
+    size_t tail       = 0;
+    size_t phead      = 0;
+    size_t userinfo   = 0;
+    size_t portnum    = 0;
+    int chk_scheme    = 1;
+    int omit_hostname = 0;
+
+#define parse_done(pos)                                                        \
+    do {                                                                       \
+        u->cur = (pos);                                                        \
+        return 0;                                                              \
+    } while (0)
+
+#define parse_error(pos)                                                       \
+    do {                                                                       \
+        u->cur = (pos);                                                        \
+        return 1;                                                              \
+    } while (0)
+
+// the authority parser stops at the end of the authority
+#define parse_next(label)                                                      \
+    do {                                                                       \
+        if (authority) {                                                       \
+            parse_done(cur);                                                   \
+        }                                                                      \
+        goto label;                                                            \
+    } while (0)
+
+    u->fields = 0;
+    if (!urllen) {
+        parse_done(0);
+    } else if (is_querystring) {
+        goto PARSE_QUERY;
+    } else if (hostport) {
+        // authority without the scheme
+        goto PARSE_HOST;
+    }
+
+    // check first byte
+    switch (url[cur]) {
+    // illegal byte sequence
+    case 0:
+        parse_done(cur);
+
+    // query-string
+    case '?':
+        parse_next(PARSE_QUERY);
+
+    // fragment
+    case '#':
+        if (authority) {
+            parse_done(cur);
+        }
+        cur++;
+        goto PARSE_FRAGMENT;
+    }
+
+PARSE_PATHNAME:
+    // pathname
+    head = cur;
+    for (; cur < urllen; cur++) {
+        // skip the ordinary characters once the scheme has been ruled out
+        if (!chk_scheme && (cur = skip_path(url, cur, urllen)) == urllen) {
+            break;
+        }
+        switch (PATH_ACTION[url[cur]]) {
+        // illegal byte sequence
+        case A_ILLEGAL:
+            set_span(u, URL_PATH, head, cur - head);
+            parse_error(cur);
+
+        // query-string
+        case A_QUERY:
+            set_span(u, URL_PATH, head, cur - head);
+            parse_next(PARSE_QUERY);
+
+        // fragment
+        case A_FRAGMENT:
+            set_span(u, URL_PATH, head, cur - head);
+            if (authority) {
+                parse_done(cur);
+            }
+            cur++;
+            goto PARSE_FRAGMENT;
+
+        // percent-encoded
+        case A_PCT:
+            // invalid percent-encoded format
+            if (!is_percentencoded(url + cur + 1)) {
+                parse_error(cur);
+            }
+            // skip "%<HEX>"
+            cur += 2;
+            // fallthrough to disable chk_scheme
+
+        // set chk_scheme to 0 if not scheme characters
+        case A_NOSCHEME:
+            // relative reference has no authority
+            if (authority) {
+                parse_done(cur);
+            }
+            chk_scheme = 0;
+            break;
+
+        case A_COLON:
+            // use as scheme separator
+            if (chk_scheme) {
+                chk_scheme = 0;
+                goto PARSE_SCHEME;
+            }
+            break;
+        }
+    }
+
+    // set path
+    set_span(u, URL_PATH, head, cur - head);
+    parse_done(cur);
+
+PARSE_QUERY:
+    switch (parse_query(u, url, urllen, &cur)) {
+    // done
+    case 0:
+        parse_done(cur);
+
+    // fragment
+    case '#':
+        cur++;
+        goto PARSE_FRAGMENT;
+
+    // illegal byte sequence
+    default:
+        parse_error(cur);
+    }
+
+PARSE_FRAGMENT:
+    // parse fragment
+    switch (parse_fragment(u, url, urllen, &cur)) {
+    // done
+    case 0:
+        parse_done(cur);
+
+    // illegal byte sequence
+    default:
+        parse_error(cur);
+    }
+
+PARSE_SCHEME:
+    if ((cur + 2) >= urllen || url[cur + 1] != '/' || url[cur + 2] != '/') {
+        // opaque URI (e.g. "mailto:user@example.com"): the scheme must be
+        // started with ALPHA and the rest is parsed as the path
+        if (cur == head || !is_alpha(url[head])) {
+            parse_error(cur);
+        }
+        set_span(u, URL_SCHEME, head, cur - head);
+        cur++;
+        parse_next(PARSE_PATHNAME);
+    }
+    // set "scheme" to scheme field
+    set_span(u, URL_SCHEME, head, cur - head);
+    // skip "://"
+    cur += 3;
+
+PARSE_HOST:
+    // parse host
+    head = cur;
+    // check first byte
+    switch (url[cur]) {
+    // parse ipv6
+    case '[':
+        goto PARSE_IPV6;
+
+    case '/':
+    case '.':
+        // host required if userinfo is defined
+        if (!userinfo) {
+            // some scheme (e.g. file) can be omit parsing the authority
+            parse_next(PARSE_PATHNAME);
+        }
+        // illegal byte sequence
+        parse_error(cur);
+
+    case ':':
+        omit_hostname = 1;
+        tail          = cur;
+        cur++;
+        goto PARSE_PORT;
+
+    case '@':
+CHECK_USERINFO:
+        // userinfo already parsed
+        if (userinfo) {
+            // illegal byte sequence
+            parse_error(cur);
+        }
+        // previous string is treated as userinfo
+        if (cur - head) {
+            set_span(u, URL_USERINFO, head, cur - head);
+            set_span(u, URL_USER, head, cur - head);
+        }
+        userinfo = cur;
+        cur++;
+        goto PARSE_HOST;
+
+    default:
+        // host must be started with ALPHA / DIGIT / '%' (percent-encoded)
+        if (url[cur] != '%' && !is_alnum(url[cur])) {
+            // illegal byte sequence
+            parse_error(cur);
+        }
+    }
+
+#define set_host()                                                             \
+    do {                                                                       \
+        set_span(u, URL_HOST, head, cur - head);                               \
+        set_span(u, URL_HOSTNAME, head, cur - head);                           \
+    } while (0)
+
+    for (; (cur = skip_host(url, cur, urllen)) < urllen; cur++) {
+        switch (HOST_ACTION[url[cur]]) {
+        // illegal byte sequence
+        case A_ILLEGAL:
+            set_host();
+            parse_error(cur);
+
+        case A_USERINFO:
+            goto CHECK_USERINFO;
+
+        case A_COLON:
+            tail = cur;
+            cur++;
+            goto PARSE_PORT;
+
+        case A_PATH:
+            set_host();
+            parse_next(PARSE_PATHNAME);
+
+        case A_QUERY:
+            set_host();
+            parse_next(PARSE_QUERY);
+
+        case A_FRAGMENT:
+            set_host();
+            if (authority) {
+                parse_done(cur);
+            }
+            cur++;
+            goto PARSE_FRAGMENT;
+
+        // percent-encoded
+        case A_PCT:
+            // invalid percent-encoded format
+            if (!is_percentencoded(url + cur + 1)) {
+                parse_error(cur);
+            }
+            // skip "%<HEX>"
+            cur += 2;
+        }
+    }
+
+    set_host();
+    parse_done(cur);
+
+PARSE_IPV6:
+    // parse ipv6
+    head = cur;
+    cur++;
+    switch (parse_ipv6(url, urllen, &cur)) {
+    // found delemiter
+    case ']':
+        cur++;
+        if (cur == urllen) {
+            // "[IPv6]" at the end of the url (e.g. the Host header value)
+            set_host();
+            parse_done(cur);
+        }
+        switch (url[cur]) {
+        case ':':
+            tail = cur;
+            cur++;
+            goto PARSE_PORT;
+
+        case '/':
+            set_host();
+            parse_next(PARSE_PATHNAME);
+
+        case '?':
+            set_host();
+            parse_next(PARSE_QUERY);
+
+        case '#':
+            set_host();
+            if (authority) {
+                parse_done(cur);
+            }
+            cur++;
+            goto PARSE_FRAGMENT;
+
+        // illegal byte sequence
+        default:
+            set_host();
+            parse_error(cur);
+        }
+        break;
+
+    // illegal byte sequence
+    default:
+        parse_error(cur);
+    }
+
+#undef set_host
+
+PARSE_PORT:
+    // parse port
+    phead   = cur;
+    portnum = 0;
+
+#define set_hostport()                                                         \
+    do {                                                                       \
+        if (cur - head > 2) {                                                  \
+            set_span(u, URL_HOSTNAME, head, tail - head);                      \
+            if (cur - phead) {                                                 \
+                set_span(u, URL_HOST, head, cur - head);                       \
+                set_span(u, URL_PORT, phead, cur - phead);                     \
+            } else {                                                           \
+                set_span(u, URL_HOST, head, tail - head);                      \
+            }                                                                  \
+        }                                                                      \
+    } while (0)
+
+    for (; cur < urllen; cur++) {
+        c = url[cur];
+        switch (PORT_ACTION[c]) {
+        // convert to integer
+        case A_CHAR:
+            portnum = (portnum << 3) + (portnum << 1) + (c - '0');
+            // invalid port range
+            if (portnum > 0xFFFF) {
+                // illegal byte sequence
+                parse_error(cur);
+            }
+            continue;
+
+        case A_PATH:
+            // set "hostname", "host" and "port" fields
+            set_hostport();
+            parse_next(PARSE_PATHNAME);
+
+        case A_QUERY:
+            set_hostport();
+            parse_next(PARSE_QUERY);
+
+        case A_FRAGMENT:
+            set_hostport();
+            if (authority) {
+                parse_done(cur);
+            }
+            cur++;
+            goto PARSE_FRAGMENT;
+
+        default:
+            // userinfo already parsed or hostname ommited
+            if (userinfo || omit_hostname) {
+                // illegal byte sequence
+                parse_error(cur);
+            }
+            // previsous string is treated as username
+            goto PARSE_PASSWORD;
+        }
+    }
+
+    set_hostport();
+    parse_done(cur);
+
+#undef set_hostport
+
+PARSE_PASSWORD:
+    for (; (cur = skip_host(url, cur, urllen)) < urllen; cur++) {
+        switch (PASSWORD_ACTION[url[cur]]) {
+        // illegal byte sequence
+        case A_ILLEGAL:
+            parse_error(cur);
+
+        case A_USERINFO:
+            set_span(u, URL_USERINFO, head, cur - head);
+            set_span(u, URL_USER, head, tail - head);
+            set_span(u, URL_PASSWORD, phead, cur - phead);
+            userinfo = c;
+            cur++;
+            goto PARSE_HOST;
+
+        // percent-encoded
+        case A_PCT:
+            // invalid percent-encoded format
+            if (!is_percentencoded(url + cur + 1)) {
+                parse_error(cur);
+            }
+            // skip "%<HEX>"
+            cur += 2;
+        }
+    }
+
+    // invalid userinfo format
+    parse_error(cur);
+
+#undef parse_done
+#undef parse_error
+#undef parse_next
+}
+
+int url_parse(url_t *u, const unsigned char *url, size_t urllen, size_t cur,
+              int is_querystring)
+{
+    return parse(u, url, urllen, cur, is_querystring, 0, 0);
+}
+
+int url_parse_authority(url_t *u, const unsigned char *url, size_t urllen,
+                        size_t cur)
+{
+    return parse(u, url, urllen, cur, 0, 1, 0);
+}
+
+int url_parse_hostport(url_t *u, const unsigned char *url, size_t urllen,
+                       size_t cur)
+{
+    return parse(u, url, urllen, cur, 0, 1, 1);
+}
+
+void url_param_init(url_param_t *p, const unsigned char *url,
+                    const url_span_t *query)
+{
+    *p = (url_param_t){.cur = query->head};
+    // skip query delimiter
+    if (query->len && url[p->cur] == '?') {
+        p->cur++;
+    }
+}
+
+/**
+ *  query     = *( key-value *( "&" key-value ) )
+ *  key-value = key [ "=" value ]
+ *
+ *  the span must be validated by url_parse. if the pair contains multiple
+ *  "=" characters, the key is the segment before the last "=".
+ *  e.g. "a=b=c" is treated as "b=c".
+ */
+int url_param_next(url_param_t *p, const unsigned char *url, size_t tail)
+{
+    size_t pos     = p->cur;
+    size_t head    = pos;
+    int has_key    = 0;
+    int is_encoded = 0;
+
+    for (; pos <= tail; pos++) {
+        switch (pos < tail ? url[pos] : '&') {
+        case '%':
+            // skip "%<HEX>"
+            pos += 2;
+            // fallthrough
+
+        case '+':
+            is_encoded = 1;
+            continue;
+
+        // key-value separator
+        case '=':
+            p->key         = (url_span_t){head, pos - head};
+            p->key_encoded = is_encoded;
+            head           = pos + 1;
+            has_key        = 1;
+            is_encoded     = 0;
+            continue;
+
+        // next key-value pair
+        case '&':
+            if (has_key) {
+                // key=val
+                p->val         = (url_span_t){head, pos - head};
+                p->val_encoded = is_encoded;
+            } else if (pos > head) {
+                // key=""
+                p->key         = (url_span_t){head, pos - head};
+                p->key_encoded = is_encoded;
+                p->val         = (url_span_t){pos, 0};
+                p->val_encoded = 0;
+            } else {
+                // skip empty pair
+                head = pos + 1;
+                continue;
+            }
+            p->cur = pos + 1;
+            return 1;
+        }
+    }
+
+    p->cur = pos;
+    return 0;
+}
+
+void url_segment_init(url_segment_t *s, const unsigned char *url,
+                      const url_span_t *path)
+{
+    *s = (url_segment_t){.cur = path->head};
+    if (!path->len) {
+        // empty path has no segments
+        s->cur++;
+    } else if (url[s->cur] == '/') {
+        // skip the root of the absolute path
+        s->cur++;
+    }
+}
+
+/**
+ *  path    = segment *( "/" segment )
+ *
+ *  the span must be validated by url_parse. the segments are not decoded,
+ *  s->encoded is set to 1 if the segment contains the percent-encoded
+ *  characters.
+ */
+int url_segment_next(url_segment_t *s, const unsigned char *url, size_t tail)
+{
+    size_t pos = s->cur;
+
+    if (pos > tail) {
+        return 0;
+    }
+
+    s->seg.head = pos;
+    s->encoded  = 0;
+    for (; pos < tail && url[pos] != '/'; pos++) {
+        if (url[pos] == '%') {
+            s->encoded = 1;
+        }
+    }
+    s->seg.len = pos - s->seg.head;
+    // skip the "/" separator
+    s->cur     = pos + 1;
+    return 1;
+}
@@ -0,0 +1,468 @@
+/**
+ *  Copyright (C) 2017 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *
+ *  src/url_psl.c
+ *  lua-url
+ *
+ *  compiled Public Suffix List.
+ *  the labels of the rules are stored in the reversed order (e.g. "uk" ->
+ *  "co") in the same way as the host trie of the matcher, and the edges are
+ *  stored in a single open addressing hash table keyed by (parent node,
+ *  label), so that the lookup time depends on the number of the labels of
+ *  the host instead of the number of the rules.
+ */
+
+// lua-url
+#include "url.h"
+// system
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// maximum length of the rule and the host name
+#define MAX_HOST 253
+
+// flags of the node
+#define RULE_NORMAL    0x1
+// "*.<node>"
+#define RULE_WILDCARD  0x2
+// "!<node>"
+#define RULE_EXCEPTION 0x4
+
+typedef struct {
+    // child node of the edge, or 0 if the slot is empty
+    uint32_t child;
+    uint32_t parent;
+    uint32_t hash;
+    uint32_t len;
+    // offset of the label in the string pool
+    size_t key;
+} edge_t;
+
+struct url_psl_s {
+    uint8_t *nodes;
+    uint32_t nnode;
+    uint32_t node_cap;
+    edge_t *edges;
+    uint32_t nedge;
+    // must be power of 2
+    uint32_t edge_cap;
+    unsigned char *pool;
+    size_t npool;
+    size_t pool_cap;
+    size_t nrule;
+};
+
+static inline unsigned char lower(unsigned char c)
+{
+    return ('A' <= c && c <= 'Z') ? c | 0x20 : c;
+}
+
+// FNV-1a
+static inline uint32_t hash_key(uint32_t parent, const unsigned char *key,
+                                size_t len)
+{
+    uint32_t h = 2166136261u;
+
+    for (int i = 0; i < 4; i++) {
+        h = (h ^ ((parent >> (i * 8)) & 0xff)) * 16777619u;
+    }
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ lower(key[i])) * 16777619u;
+    }
+    return h;
+}
+
+static inline int key_equal(const url_psl_t *psl, const edge_t *e,
+                            const unsigned char *key, size_t len)
+{
+    const unsigned char *ekey = psl->pool + e->key;
+
+    for (size_t i = 0; i < len; i++) {
+        if (ekey[i] != lower(key[i])) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static uint32_t find_edge(const url_psl_t *psl, uint32_t parent,
+                          const unsigned char *key, size_t len)
+{
+    uint32_t hash = hash_key(parent, key, len);
+    uint32_t mask = psl->edge_cap - 1;
+
+    for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+        const edge_t *e = psl->edges + i;
+        if (!e->child) {
+            return 0;
+        } else if (e->hash == hash && e->parent == parent && e->len == len &&
+                   key_equal(psl, e, key, len)) {
+            return e->child;
+        }
+    }
+}
+
+static int grow_edges(url_psl_t *psl)
+{
+    uint32_t cap   = psl->edge_cap * 2;
+    uint32_t mask  = cap - 1;
+    edge_t *edges  = NULL;
+    edge_t *oedges = psl->edges;
+
+    if (cap < psl->edge_cap || !(edges = calloc(cap, sizeof(edge_t)))) {
+        errno = ENOMEM;
+        return -1;
+    }
+    for (uint32_t i = 0; i < psl->edge_cap; i++) {
+        if (oedges[i].child) {
+            uint32_t j = oedges[i].hash & mask;
+            while (edges[j].child) {
+                j = (j + 1) & mask;
+            }
+            edges[j] = oedges[i];
+        }
+    }
+    free(oedges);
+    psl->edges    = edges;
+    psl->edge_cap = cap;
+    return 0;
+}
+
+static uint32_t new_node(url_psl_t *psl)
+{
+    if (psl->nnode == psl->node_cap) {
+        uint32_t cap   = psl->node_cap * 2;
+        uint8_t *nodes = NULL;
+
+        if (cap < psl->node_cap || !(nodes = realloc(psl->nodes, cap))) {
+            errno = ENOMEM;
+            return 0;
+        }
+        psl->nodes    = nodes;
+        psl->node_cap = cap;
+    }
+    psl->nodes[psl->nnode] = 0;
+    return psl->nnode++;
+}
+
+/**
+ *  returns the child node of the parent that is connected with the label,
+ *  or creates a new one. returns 0 if failed to allocate memory.
+ */
+static uint32_t add_edge(url_psl_t *psl, uint32_t parent,
+                         const unsigned char *key, size_t len)
+{
+    uint32_t child = find_edge(psl, parent, key, len);
+    uint32_t mask  = 0;
+    edge_t e       = {
+              .parent = parent,
+              .hash   = hash_key(parent, key, len),
+              .len    = len,
+    };
+
+    if (child) {
+        return child;
+    } else if ((psl->nedge + 1) * 2 > psl->edge_cap && grow_edges(psl)) {
+        return 0;
+    }
+
+    // append the label to the string pool
+    if (psl->pool_cap - psl->npool < len) {
+        size_t cap          = psl->pool_cap * 2 + len;
+        unsigned char *pool = realloc(psl->pool, cap);
+        if (!pool) {
+            errno = ENOMEM;
+            return 0;
+        }
+        psl->pool     = pool;
+        psl->pool_cap = cap;
+    }
+    e.key = psl->npool;
+    for (size_t i = 0; i < len; i++) {
+        psl->pool[psl->npool++] = lower(key[i]);
+    }
+
+    if (!(e.child = new_node(psl))) {
+        return 0;
+    }
+    mask = psl->edge_cap - 1;
+    for (uint32_t i = e.hash & mask;; i = (i + 1) & mask) {
+        if (!psl->edges[i].child) {
+            psl->edges[i] = e;
+            psl->nedge++;
+            return e.child;
+        }
+    }
+}
+
+url_psl_t *url_psl_new(void)
+{
+    url_psl_t *psl = calloc(1, sizeof(url_psl_t));
+
+    if (psl) {
+        psl->node_cap = 1024;
+        psl->edge_cap = 2048;
+        psl->nodes    = malloc(psl->node_cap);
+        psl->edges    = calloc(psl->edge_cap, sizeof(edge_t));
+        if (!psl->nodes || !psl->edges) {
+            url_psl_free(psl);
+            errno = ENOMEM;
+            return NULL;
+        }
+        // root node
+        psl->nodes[0] = 0;
+        psl->nnode    = 1;
+    } else {
+        errno = ENOMEM;
+    }
+    return psl;
+}
+
+void url_psl_free(url_psl_t *psl)
+{
+    if (psl) {
+        free(psl->nodes);
+        free(psl->edges);
+        free(psl->pool);
+        free(psl);
+    }
+}
+
+size_t url_psl_len(const url_psl_t *psl)
+{
+    return psl->nrule;
+}
+
+/**
+ *  rule = [ "!" / "*." ] label *( "." label )
+ */
+int url_psl_add(url_psl_t *psl, const unsigned char *rule, size_t len)
+{
+    unsigned char host[URL_HOST_ASCII_MAXLEN(MAX_HOST)];
+    uint8_t flag  = RULE_NORMAL;
+    uint32_t node = 0;
+    size_t tail   = 0;
+    size_t epos   = 0;
+    ssize_t n     = 0;
+
+    if (len && rule[0] == '!') {
+        flag = RULE_EXCEPTION;
+        rule++;
+        len--;
+    } else if (len > 1 && rule[0] == '*' && rule[1] == '.') {
+        flag = RULE_WILDCARD;
+        rule += 2;
+        len -= 2;
+    }
+    // the internationalized rules are stored in the ASCII form to match the
+    // host names that are converted by url_host_to_ascii
+    if (!len || len > MAX_HOST ||
+        (n = url_host_to_ascii(host, rule, len, &epos)) <= 0 ||
+        n > MAX_HOST ||
+        (flag == RULE_EXCEPTION && !memchr(host, '.', n))) {
+        // the exception rule must have the public suffix
+        errno = EINVAL;
+        return -1;
+    }
+
+    // add the labels in the reversed order
+    tail = n;
+    while (tail) {
+        size_t lhead = tail;
+        while (lhead && host[lhead - 1] != '.') {
+            lhead--;
+        }
+        if (lhead == tail || memchr(host + lhead, '*', tail - lhead) ||
+            memchr(host + lhead, '!', tail - lhead)) {
+            // empty label or the wildcard that is not the leftmost label
+            errno = EINVAL;
+            return -1;
+        } else if (!(node = add_edge(psl, node, host + lhead, tail - lhead))) {
+            return -1;
+        } else if (!lhead) {
+            break;
+        }
+        // skip the dot
+        tail = lhead - 1;
+        if (!tail) {
+            // starts with the dot
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    if (!(psl->nodes[node] & flag)) {
+        psl->nodes[node] |= flag;
+        psl->nrule++;
+    }
+    return 0;
+}
+
+static inline int is_space(int c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' ||
+           c == '\f';
+}
+
+int url_psl_load(url_psl_t *psl, const char *pathname, size_t *eline)
+{
+    unsigned char rule[MAX_HOST + 2];
+    size_t len   = 0;
+    size_t line  = 1;
+    int skip     = 0;
+    int c        = 0;
+    FILE *fp     = fopen(pathname, "r");
+
+    if (!fp) {
+        return -1;
+    }
+
+    // the rule is the first word of the line, and the comment starts with
+    // "//" at the head of the line
+    do {
+        c = fgetc(fp);
+        if (c == '\n' || c == EOF) {
+            if (len && url_psl_add(psl, rule, len)) {
+                goto FAILED;
+            }
+            len  = 0;
+            skip = 0;
+            line++;
+        } else if (skip) {
+            continue;
+        } else if (is_space(c)) {
+            // the rest of the line is ignored
+            skip = len > 0;
+        } else if (len == 1 && rule[0] == '/' && c == '/') {
+            len  = 0;
+            skip = 1;
+        } else if (len == sizeof(rule)) {
+            // too long rule
+            errno = EINVAL;
+            goto FAILED;
+        } else {
+            rule[len++] = c;
+        }
+    } while (c != EOF);
+
+    if (ferror(fp)) {
+        errno = EIO;
+        goto FAILED;
+    }
+    return fclose(fp);
+
+FAILED: {
+    int err = errno;
+    fclose(fp);
+    *eline = line;
+    errno  = err;
+    return -1;
+}
+}
+
+/**
+ *  returns 1 if the host name is an IPv4 address or an IP-literal.
+ *  the top-level label of the domain name is never numeric.
+ */
+static inline int is_ipaddr(const unsigned char *host, size_t len)
+{
+    size_t i = len;
+
+    if (host[0] == '[') {
+        return 1;
+    }
+    while (i && host[i - 1] != '.') {
+        if (host[--i] < '0' || host[i] > '9') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+ssize_t url_psl_lookup(const url_psl_t *psl, const unsigned char *host,
+                       size_t len, size_t *suffix, size_t *domain)
+{
+    uint32_t node = 0;
+    size_t tail   = 0;
+    size_t head   = len;
+
+    if (len && host[len - 1] == '.') {
+        // ignore the trailing dot
+        len--;
+    }
+    if (!len || len > MAX_HOST || host[0] == '.' || is_ipaddr(host, len)) {
+        return -1;
+    }
+
+    // the default rule "*": the top-level label is the public suffix
+    tail = len;
+    for (;;) {
+        size_t lhead = tail;
+        while (lhead && host[lhead - 1] != '.') {
+            lhead--;
+        }
+        if (lhead == tail) {
+            // empty label
+            return -1;
+        } else if (tail == len || (psl->nodes[node] & RULE_WILDCARD)) {
+            // the label matches the default rule or "*.<node>"
+            head = lhead;
+        }
+
+        if (!(node = find_edge(psl, node, host + lhead, tail - lhead))) {
+            break;
+        } else if (psl->nodes[node] & RULE_EXCEPTION) {
+            // the exception rule takes precedence over the other rules, and
+            // its public suffix is the rule without the leftmost label
+            head = tail + 1;
+            break;
+        } else if (psl->nodes[node] & RULE_NORMAL) {
+            head = lhead;
+        }
+        if (!lhead) {
+            break;
+        }
+        // skip the dot
+        tail = lhead - 1;
+    }
+
+    // validate the rest of the labels
+    for (size_t i = 0; i < head; i++) {
+        if (host[i] == '.' && (!i || host[i - 1] == '.')) {
+            return -1;
+        }
+    }
+
+    *suffix = head;
+    *domain = len;
+    if (head) {
+        // the registrable domain is the public suffix and one more label
+        size_t lhead = head - 1;
+        while (lhead && host[lhead - 1] != '.') {
+            lhead--;
+        }
+        *domain = lhead;
+    }
+    return len;
+}
@@ -0,0 +1,445 @@
+/**
+ *  Copyright (C) 2017 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *
+ *  src/url_seen.c
+ *  lua-url
+ *
+ *  set of the 64-bit fingerprints of the normalized urls.
+ *  the fingerprints are stored in a single open addressing table without
+ *  the keys, so that each url takes 8 bytes of the slot and the empty
+ *  slots of the load factor.
+ */
+
+// lua-url
+#include "url.h"
+// system
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the table grows when the number of the fingerprints exceeds 4/5 of the
+// slots
+#define MAX_LOAD(nslot) ((nslot) / 5 * 4 + (nslot) % 5 * 4 / 5)
+#define MIN_SLOT        8
+
+// header of the saved file: magic and the number of the fingerprints
+#define FILE_MAGIC     "URLSEEN1"
+#define FILE_MAGIC_LEN 8
+// number of the fingerprints that are written or read at once
+#define FILE_CHUNK     512
+
+struct url_seen_s {
+    // 0 is the empty slot
+    uint64_t *slots;
+    size_t nslot;
+    size_t len;
+};
+
+typedef struct {
+    uint64_t h;
+} fnv_t;
+
+static inline void fnv_add(fnv_t *f, const unsigned char *s, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        f->h = (f->h ^ s[i]) * 0x100000001b3ULL;
+    }
+}
+
+static inline void fnv_add_lower(fnv_t *f, const unsigned char *s, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = s[i];
+        f->h = (f->h ^ ((c >= 'A' && c <= 'Z') ? c | 0x20 : c)) *
+               0x100000001b3ULL;
+    }
+}
+
+// the hex digits of the percent-encoded sequences are uppercased. the
+// sequences have been validated by the parser.
+static inline void fnv_add_pct(fnv_t *f, const unsigned char *s, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = s[i];
+        f->h = (f->h ^ c) * 0x100000001b3ULL;
+        if (c == '%' && i + 2 < len) {
+            for (int j = 1; j <= 2; j++) {
+                c    = s[i + j];
+                f->h = (f->h ^ ((c >= 'a' && c <= 'f') ? c & ~0x20 : c)) *
+                       0x100000001b3ULL;
+            }
+            i += 2;
+        }
+    }
+}
+
+static inline int span_equal(const unsigned char *url, const url_span_t *span,
+                             const char *str)
+{
+    size_t len = strlen(str);
+
+    if (span->len != len) {
+        return 0;
+    }
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = url[span->head + i];
+        if (((c >= 'A' && c <= 'Z') ? c | 0x20 : c) != (unsigned char)str[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ *  returns the default port number of the scheme, or 0 if unknown.
+ */
+static int default_port(const unsigned char *url, const url_t *u)
+{
+    static const struct {
+        const char *scheme;
+        int port;
+    } PORTS[] = {
+        {"http",  80 },
+        {"https", 443},
+        {"ws",    80 },
+        {"wss",   443},
+        {"ftp",   21 },
+    };
+
+    if (u->fields & (1 << URL_SCHEME)) {
+        for (size_t i = 0; i < sizeof(PORTS) / sizeof(PORTS[0]); i++) {
+            if (span_equal(url, &u->span[URL_SCHEME], PORTS[i].scheme)) {
+                return PORTS[i].port;
+            }
+        }
+    }
+    return 0;
+}
+
+// finalizer of MurmurHash3 to spread the bits of FNV-1a over the table
+static inline uint64_t fmix64(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t url_fingerprint(const unsigned char *url, size_t len, size_t *epos)
+{
+    fnv_t f = {.h = 0xcbf29ce484222325ULL};
+    url_t u = {0};
+
+    if (url_parse(&u, url, len, 0, 0) || u.cur != len) {
+        // illegal byte sequence
+        *epos = u.cur;
+        return 0;
+    }
+
+    if (u.fields & (1 << URL_SCHEME)) {
+        fnv_add_lower(&f, url + u.span[URL_SCHEME].head,
+                      u.span[URL_SCHEME].len);
+        fnv_add(&f, (const unsigned char *)":", 1);
+    }
+    if (u.fields & (1 << URL_HOST)) {
+        fnv_add(&f, (const unsigned char *)"//", 2);
+        if (u.fields & (1 << URL_HOSTNAME)) {
+            fnv_add_lower(&f, url + u.span[URL_HOSTNAME].head,
+                          u.span[URL_HOSTNAME].len);
+        }
+        if ((u.fields & (1 << URL_PORT)) && u.span[URL_PORT].len) {
+            // the port is validated by the parser, and the leading zeros
+            // and the default port of the scheme are removed
+            const unsigned char *p = url + u.span[URL_PORT].head;
+            int port               = 0;
+            for (size_t i = 0; i < u.span[URL_PORT].len; i++) {
+                port = port * 10 + (p[i] - '0');
+            }
+            if (port != default_port(url, &u)) {
+                unsigned char buf[6] = {':'};
+                size_t n             = 6;
+                do {
+                    buf[--n] = '0' + port % 10;
+                    port /= 10;
+                } while (port);
+                fnv_add(&f, buf, 1);
+                fnv_add(&f, buf + n, 6 - n);
+            }
+        }
+    }
+    if ((u.fields & (1 << URL_PATH)) && u.span[URL_PATH].len) {
+        fnv_add_pct(&f, url + u.span[URL_PATH].head, u.span[URL_PATH].len);
+    } else if (u.fields & (1 << URL_HOST)) {
+        fnv_add(&f, (const unsigned char *)"/", 1);
+    }
+    if (u.fields & (1 << URL_QUERY)) {
+        fnv_add_pct(&f, url + u.span[URL_QUERY].head, u.span[URL_QUERY].len);
+    }
+
+    f.h = fmix64(f.h);
+    // 0 is reserved for the empty slot
+    return f.h ? f.h : 1;
+}
+
+// map the fingerprint to [0, nslot) without the modulo where the compiler
+// has a 128-bit integer; 32-bit targets fall back to the modulo
+static inline size_t slot_of(uint64_t fp, size_t nslot)
+{
+#ifdef __SIZEOF_INT128__
+    return (size_t)(((__uint128_t)fp * nslot) >> 64);
+#else
+    return (size_t)(fp % nslot);
+#endif
+}
+
+static inline int find_slot(const uint64_t *slots, size_t nslot, uint64_t fp,
+                            size_t *idx)
+{
+    size_t i = slot_of(fp, nslot);
+
+    for (;;) {
+        if (slots[i] == fp) {
+            *idx = i;
+            return 1;
+        } else if (!slots[i]) {
+            *idx = i;
+            return 0;
+        } else if (++i == nslot) {
+            i = 0;
+        }
+    }
+}
+
+static int resize(url_seen_t *s, size_t nslot)
+{
+    uint64_t *slots = NULL;
+
+    if (nslot > SIZE_MAX / sizeof(uint64_t) ||
+        !(slots = calloc(nslot, sizeof(uint64_t)))) {
+        errno = ENOMEM;
+        return -1;
+    }
+    for (size_t i = 0; i < s->nslot; i++) {
+        if (s->slots[i]) {
+            size_t idx = 0;
+            find_slot(slots, nslot, s->slots[i], &idx);
+            slots[idx] = s->slots[i];
+        }
+    }
+    free(s->slots);
+    s->slots = slots;
+    s->nslot = nslot;
+    return 0;
+}
+
+url_seen_t *url_seen_new(size_t capacity)
+{
+    url_seen_t *s = calloc(1, sizeof(url_seen_t));
+    size_t nslot  = capacity + capacity / 4 + 1;
+
+    if (!s) {
+        errno = ENOMEM;
+        return NULL;
+    } else if (nslot < capacity) {
+        nslot = SIZE_MAX;
+    } else if (nslot < MIN_SLOT) {
+        nslot = MIN_SLOT;
+    }
+    if (resize(s, nslot)) {
+        free(s);
+        return NULL;
+    }
+    return s;
+}
+
+void url_seen_free(url_seen_t *s)
+{
+    if (s) {
+        free(s->slots);
+        free(s);
+    }
+}
+
+size_t url_seen_len(const url_seen_t *s)
+{
+    return s->len;
+}
+
+size_t url_seen_cap(const url_seen_t *s)
+{
+    return MAX_LOAD(s->nslot);
+}
+
+int url_seen_has(const url_seen_t *s, uint64_t fp)
+{
+    size_t idx = 0;
+    return fp && find_slot(s->slots, s->nslot, fp, &idx);
+}
+
+int url_seen_add(url_seen_t *s, uint64_t fp)
+{
+    size_t idx = 0;
+
+    if (!fp) {
+        errno = EINVAL;
+        return -1;
+    } else if (find_slot(s->slots, s->nslot, fp, &idx)) {
+        return 0;
+    } else if (s->len + 1 > MAX_LOAD(s->nslot)) {
+        if (s->nslot > SIZE_MAX / 2 || resize(s, s->nslot * 2)) {
+            errno = ENOMEM;
+            return -1;
+        }
+        find_slot(s->slots, s->nslot, fp, &idx);
+    }
+    s->slots[idx] = fp;
+    s->len++;
+    return 1;
+}
+
+static inline void put_le64(unsigned char *p, uint64_t v)
+{
+    for (int i = 0; i < 8; i++, v >>= 8) {
+        p[i] = v & 0xff;
+    }
+}
+
+static inline uint64_t get_le64(const unsigned char *p)
+{
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+/**
+ *  file = "URLSEEN1" count:le64 *( fingerprint:le64 )
+ */
+int url_seen_save(const url_seen_t *s, const char *pathname)
+{
+    unsigned char buf[FILE_CHUNK * 8];
+    size_t n = 0;
+    FILE *fp = fopen(pathname, "wb");
+
+    if (!fp) {
+        return -1;
+    }
+    memcpy(buf, FILE_MAGIC, FILE_MAGIC_LEN);
+    put_le64(buf + FILE_MAGIC_LEN, s->len);
+    if (fwrite(buf, FILE_MAGIC_LEN + 8, 1, fp) != 1) {
+        goto FAILED;
+    }
+    for (size_t i = 0; i < s->nslot; i++) {
+        if (s->slots[i]) {
+            put_le64(buf + n * 8, s->slots[i]);
+            if (++n == FILE_CHUNK) {
+                if (fwrite(buf, n * 8, 1, fp) != 1) {
+                    goto FAILED;
+                }
+                n = 0;
+            }
+        }
+    }
+    if ((n && fwrite(buf, n * 8, 1, fp) != 1) || fflush(fp)) {
+        goto FAILED;
+    }
+    return fclose(fp);
+
+FAILED: {
+    int err = errno;
+    fclose(fp);
+    errno = err;
+    return -1;
+}
+}
+
+int url_seen_load(url_seen_t *s, const char *pathname)
+{
+    unsigned char buf[FILE_CHUNK * 8];
+    uint64_t count = 0;
+    long size      = 0;
+    FILE *fp       = fopen(pathname, "rb");
+
+    if (!fp) {
+        return -1;
+    } else if (fread(buf, FILE_MAGIC_LEN + 8, 1, fp) != 1 ||
+               memcmp(buf, FILE_MAGIC, FILE_MAGIC_LEN) != 0) {
+        goto INVALID;
+    }
+    count = get_le64(buf + FILE_MAGIC_LEN);
+
+    // the count of the header must match the size of the body before the
+    // slots are reserved for it
+    if (fseek(fp, 0, SEEK_END) || (size = ftell(fp)) < 0 ||
+        fseek(fp, FILE_MAGIC_LEN + 8, SEEK_SET)) {
+        goto FAILED;
+    } else if ((uint64_t)size - (FILE_MAGIC_LEN + 8) != count * 8 ||
+               count > UINT64_MAX / 8) {
+        goto INVALID;
+    }
+
+    // reserve the slots at once
+    if (count > SIZE_MAX - s->len) {
+        goto INVALID;
+    } else if (s->len + count > MAX_LOAD(s->nslot)) {
+        size_t len   = s->len + count;
+        size_t nslot = len + len / 4 + 1;
+        if (nslot < len || resize(s, nslot)) {
+            errno = ENOMEM;
+            goto FAILED;
+        }
+    }
+
+    while (count) {
+        size_t n = count < FILE_CHUNK ? count : FILE_CHUNK;
+
+        if (fread(buf, 8, n, fp) != n) {
+            goto INVALID;
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (url_seen_add(s, get_le64(buf + i * 8)) < 0) {
+                goto FAILED;
+            }
+        }
+        count -= n;
+    }
+    // trailing garbage
+    if (fgetc(fp) != EOF) {
+        goto INVALID;
+    }
+    return fclose(fp);
+
+INVALID:
+    // truncated or not a fingerprint file
+    errno = ferror(fp) ? EIO : EINVAL;
+
+FAILED: {
+    int err = errno;
+    fclose(fp);
+    errno = err;
+    return -1;
+}
+}
@@ -0,0 +1,165 @@
+/**
+ *  Copyright (C) 2017 Masatoshi Teruya
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  src/url_stats.h
+ *  lua-url
+ *
+ *  per-function counters of the lua bindings. the counters are compiled in
+ *  only if URL_STATS is defined, otherwise the macros expand to nothing.
+ *  the counters are kept in a userdata in the registry, so that the
+ *  url.codec and url.parse modules share them in the same lua_State.
+ */
+
+#ifndef lua_url_stats_h
+#define lua_url_stats_h
+
+typedef enum {
+    URL_STATS_ENCODE_URI = 0,
+    URL_STATS_ENCODE_FORM,
+    URL_STATS_ENCODE_2396,
+    URL_STATS_ENCODE_3986,
+    URL_STATS_DECODE_URI,
+    URL_STATS_DECODE_FORM,
+    URL_STATS_DECODE,
+    URL_STATS_HOST_TO_ASCII,
+    URL_STATS_HOST_TO_UNICODE,
+    URL_STATS_PARSE,
+    URL_STATS_PARSE_QUERY,
+    URL_STATS_DECODE_DATA,
+    URL_STATS_NFUNC
+} url_stats_func_e;
+
+#ifdef URL_STATS
+
+// lua
+# include <lauxlib.h>
+// system
+# include <stdint.h>
+# include <string.h>
+# include <time.h>
+
+# define URL_STATS_KEY "url.stats"
+
+typedef struct {
+    uint64_t calls;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t errors;
+    uint64_t ns;
+} url_stats_t;
+
+static const char *const URL_STATS_NAMES[URL_STATS_NFUNC] = {
+    [URL_STATS_ENCODE_URI]      = "encode_uri",
+    [URL_STATS_ENCODE_FORM]     = "encode_form",
+    [URL_STATS_ENCODE_2396]     = "encode2396",
+    [URL_STATS_ENCODE_3986]     = "encode3986",
+    [URL_STATS_DECODE_URI]      = "decode_uri",
+    [URL_STATS_DECODE_FORM]     = "decode_form",
+    [URL_STATS_DECODE]          = "decode",
+    [URL_STATS_HOST_TO_ASCII]   = "host_to_ascii",
+    [URL_STATS_HOST_TO_UNICODE] = "host_to_unicode",
+    [URL_STATS_PARSE]           = "parse",
+    [URL_STATS_PARSE_QUERY]     = "parse_query",
+    [URL_STATS_DECODE_DATA]     = "decode_data",
+};
+
+static inline uint64_t url_stats_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ *  returns the counters in the registry. the counters are created at the
+ *  first call.
+ */
+static inline url_stats_t *url_stats_get(lua_State *L)
+{
+    url_stats_t *stats = NULL;
+
+    lua_getfield(L, LUA_REGISTRYINDEX, URL_STATS_KEY);
+    stats = lua_touserdata(L, -1);
+    lua_pop(L, 1);
+    if (!stats) {
+        stats = lua_newuserdata(L, sizeof(url_stats_t) * URL_STATS_NFUNC);
+        memset(stats, 0, sizeof(url_stats_t) * URL_STATS_NFUNC);
+        lua_setfield(L, LUA_REGISTRYINDEX, URL_STATS_KEY);
+    }
+    return stats;
+}
+
+static inline void url_stats_add(lua_State *L, url_stats_func_e fn,
+                                 uint64_t t0, size_t in, size_t out, int err)
+{
+    url_stats_t *stats = url_stats_get(L) + fn;
+
+    stats->ns += url_stats_now() - t0;
+    stats->calls++;
+    stats->bytes_in += in;
+    stats->bytes_out += out;
+    stats->errors += !!err;
+}
+
+/**
+ *  push the table of the counters: { <name> = { calls = ..., ... }, ... }
+ */
+static inline int url_stats_lua(lua_State *L)
+{
+    url_stats_t *stats = url_stats_get(L);
+
+    lua_createtable(L, 0, URL_STATS_NFUNC);
+    for (int i = 0; i < URL_STATS_NFUNC; i++) {
+        lua_createtable(L, 0, 5);
+        lua_pushinteger(L, stats[i].calls);
+        lua_setfield(L, -2, "calls");
+        lua_pushinteger(L, stats[i].bytes_in);
+        lua_setfield(L, -2, "bytes_in");
+        lua_pushinteger(L, stats[i].bytes_out);
+        lua_setfield(L, -2, "bytes_out");
+        lua_pushinteger(L, stats[i].errors);
+        lua_setfield(L, -2, "errors");
+        lua_pushinteger(L, stats[i].ns);
+        lua_setfield(L, -2, "ns");
+        lua_setfield(L, -2, URL_STATS_NAMES[i]);
+    }
+    return 1;
+}
+
+static inline int url_stats_reset_lua(lua_State *L)
+{
+    memset(url_stats_get(L), 0, sizeof(url_stats_t) * URL_STATS_NFUNC);
+    return 0;
+}
+
+# define URL_STATS_START(t0) uint64_t t0 = url_stats_now()
+# define URL_STATS_ADD(L, fn, t0, in, out, err)                                \
+  url_stats_add((L), (fn), (t0), (in), (out), (err))
+
+#else
+
+# define URL_STATS_START(t0)
+# define URL_STATS_ADD(L, fn, t0, in, out, err) ((void)(fn))
+
+#endif
+
+#endif
@@ -0,0 +1,138 @@
+local testcase = require('testcase')
+local url = require('url')
+local buffer = url.buffer
+
+function testcase.buffer()
+    -- test that create an empty buffer
+    local b = buffer()
+    assert.equal(b:len(), 0)
+    assert.equal(#b, 0)
+    assert.equal(b:tostring(), '')
+    assert.match(tostring(b), 'url.buffer: ')
+
+    -- test that reserve the initial capacity
+    b = buffer(1000)
+    assert.equal(b:len(), 0)
+    assert.greater_or_equal(b:cap(), 1000)
+
+    -- test that throws an error if argument is invalid
+    local err = assert.throws(buffer, -1)
+    assert.match(err, 'bad argument #1')
+end
+
+function testcase.encode_decode()
+    local b = buffer()
+
+    -- test that append the encoded string
+    for _, name in ipairs({
+        'encode_uri',
+        'encode_form',
+        'encode2396',
+        'encode3986',
+    }) do
+        local s = 'foo bar/ほげ?a=b&c=d#e'
+        b:reset()
+        assert.equal(b:append('x'), 1)
+        assert.equal(b[name](b, s), 1 + #url[name](s))
+        assert.equal(b:tostring(), 'x' .. url[name](s))
+    end
+
+    -- test that keep the valid percent-encoded sequences
+    b:reset()
+    assert.equal(b:encode_uri('a%2fb c%', true), 12)
+    assert.equal(b:tostring(), 'a%2Fb%20c%25')
+
+    -- test that append the decoded string
+    for _, name in ipairs({
+        'decode_uri',
+        'decode_form',
+        'decode',
+    }) do
+        local s = '%E3%81%BB+%2F%u3052'
+        b:reset()
+        assert.equal(b:append('x'), 1)
+        assert.equal(b[name](b, s), 1 + #url[name](s))
+        assert.equal(b:tostring(), 'x' .. url[name](s))
+    end
+
+    -- test that copy the invalid '%' in the lenient mode
+    b:reset()
+    assert.equal({
+        b:decode('a%zz%41', false, true),
+    }, {
+        5,
+        1,
+    })
+    assert.equal(b:tostring(), 'a%zzA')
+
+    -- test that returns an error and keep the data if decoding failed
+    b:reset()
+    b:append('abc')
+    local n, err = b:decode('foo%zz')
+    assert.is_nil(n)
+    assert.equal(err, 4)
+    n, err = b:decode_form('%C0%AF', true)
+    assert.is_nil(n)
+    assert.equal(err, 1)
+    assert.equal(b:tostring(), 'abc')
+
+    -- test that throws an error if argument is not a string
+    err = assert.throws(b.encode_uri, b, {})
+    assert.match(err, 'bad argument #2')
+    err = assert.throws(b.encode_uri, {}, 'foo')
+    assert.match(err, 'bad argument #1')
+end
+
+function testcase.reuse()
+    local b = buffer()
+    local s = string.rep('%41%u3042+', 10000)
+
+    -- test that the buffer grows for large inputs
+    assert.equal(b:decode_form(s), #url.decode_form(s))
+    assert.equal(b:tostring(), url.decode_form(s))
+    local cap = b:cap()
+
+    -- test that the capacity is kept after reset
+    b:reset()
+    assert.equal(b:len(), 0)
+    assert.equal(b:cap(), cap)
+    b:decode_form(s)
+    assert.equal(b:cap(), cap)
+end
+
+function testcase.sub()
+    local b = buffer()
+    local s = 'hello world'
+    b:append(s)
+
+    -- test that sub works like string.sub
+    for _, args in ipairs({
+        {1},
+        {3},
+        {-5},
+        {0},
+        {-100},
+        {3, 5},
+        {3, -3},
+        {5, 3},
+        {1, 100},
+        {-3, -1},
+        {12},
+        {2, 0},
+    }) do
+        assert.equal(b:sub(args[1], args[2]), s:sub(args[1], args[2]))
+    end
+end
+
+function testcase.ptr()
+    local b = buffer()
+    b:encode3986('a b')
+
+    -- test that returns the pointer of the data
+    assert.equal(type(b:ptr()), 'userdata')
+    if jit then
+        local ffi = require('ffi')
+        local p = ffi.cast('const char *', b:ptr())
+        assert.equal(ffi.string(p, b:len()), 'a%20b')
+    end
+end
@@ -0,0 +1,145 @@
+local testcase = require('testcase')
+local url = require('url')
+local builder = url.builder
+
+function testcase.builder()
+    -- test that create a builder with the base url
+    local b = builder('https://api.example.com/v1')
+    assert.match(tostring(b), 'url.builder: ')
+    assert.equal(b:tostring(), 'https://api.example.com/v1')
+    assert.equal(b:len(), 26)
+    assert.equal(#b, 26)
+
+    -- test that the base url is optional
+    b = builder()
+    assert.equal(b:tostring(), '')
+
+    -- test that throws an error if argument is invalid
+    local err = assert.throws(builder, {})
+    assert.match(err, 'bad argument #1')
+end
+
+function testcase.segment()
+    local b = builder('https://api.example.com/v1')
+
+    -- test that append the encoded path segments separated by '/'
+    assert.equal(b:segment('users', 42), b)
+    assert.equal(b:segment('a/b c', 'ほげ'), b)
+    assert.equal(b:tostring(), 'https://api.example.com/v1/users/42/' ..
+                     url.encode3986('a/b c') .. '/' .. url.encode3986('ほげ'))
+
+    -- test that the '/' is not duplicated after the base url
+    b = builder('https://api.example.com/')
+    assert.equal(b:segment('users'):tostring(), 'https://api.example.com/users')
+
+    -- test that the empty segment is appended
+    b = builder('http://example.com')
+    assert.equal(b:segment('a', '', 'b'):tostring(), 'http://example.com/a//b')
+
+    -- test that throws an error after the query or fragment
+    b:param('k', 'v')
+    local err = assert.throws(b.segment, b, 'c')
+    assert.match(err, 'cannot append the path segment')
+    err = assert.throws(builder('http://example.com/?q').segment, builder(
+                            'http://example.com/?q'), 'c')
+    assert.match(err, 'cannot append the path segment')
+
+    -- test that throws an error if the segment is not string or number
+    b = builder()
+    err = assert.throws(b.segment, b, 'a', true)
+    assert.match(err, 'bad argument #3')
+end
+
+function testcase.param()
+    local b = builder('https://api.example.com/search')
+
+    -- test that append the query parameters encoded by encode3986
+    assert.equal(b:param('q', 'a b&c=d'), b)
+    assert.equal(b:param('page', 2):param('flag'):tostring(),
+                 'https://api.example.com/search?q=a%20b%26c%3Dd&page=2&flag')
+
+    -- test that append the numbers as the same as tostring
+    local exp = {}
+    b:reset()
+    for _, v in ipairs({
+        0,
+        -1,
+        1234567890,
+        math.mininteger or -2 ^ 53,
+        2 ^ 53,
+        1.5,
+        -0.0,
+        -0.25,
+        1e300,
+    }) do
+        b:param('n', v)
+        exp[#exp + 1] = 'n=' .. url.encode3986(tostring(v))
+    end
+    assert.equal(b:tostring(), 'https://api.example.com/search?' ..
+                     table.concat(exp, '&'))
+
+    -- test that append the parameters to the query of the base url
+    for base, exp in pairs({
+        ['http://example.com/?a=b'] = 'http://example.com/?a=b&k=v',
+        ['http://example.com/?'] = 'http://example.com/?k=v',
+        ['http://example.com/?a=b&'] = 'http://example.com/?a=b&k=v',
+    }) do
+        assert.equal(builder(base):param('k', 'v'):tostring(), exp)
+    end
+
+    -- test that encode the parameters by encode_form
+    b = builder('http://example.com/', true)
+    b:param('a~b', 'c*d')
+    assert.equal(b:tostring(), 'http://example.com/?' .. url.encode_form('a~b') ..
+                     '=' .. url.encode_form('c*d'))
+
+    -- test that throws an error after the fragment
+    b:fragment('top')
+    local err = assert.throws(b.param, b, 'k', 'v')
+    assert.match(err, 'cannot append the query parameter')
+
+    -- test that throws an error if the arguments are invalid
+    b = builder()
+    err = assert.throws(b.param, b, 1, 'v')
+    assert.match(err, 'bad argument #2')
+    err = assert.throws(b.param, b, 'k', {})
+    assert.match(err, 'bad argument #3')
+end
+
+function testcase.fragment()
+    local b = builder('http://example.com')
+
+    -- test that append the encoded fragment
+    assert.equal(b:segment('a'):param('k', 'v'):fragment('x y#z'), b)
+    assert.equal(b:tostring(), 'http://example.com/a?k=v#x%20y%23z')
+
+    -- test that throws an error if the fragment has already been appended
+    local err = assert.throws(b.fragment, b, 'z')
+    assert.match(err, 'already been appended')
+    err = assert.throws(builder('http://example.com/#a').fragment,
+                        builder('http://example.com/#a'), 'b')
+    assert.match(err, 'already been appended')
+end
+
+function testcase.reset()
+    local b = builder('https://api.example.com/v1')
+    b:segment(('x'):rep(1000)):param('k', 'v'):fragment('f')
+    local cap = b:cap()
+    assert.greater_or_equal(cap, b:len())
+
+    -- test that restore the base url and keep the capacity
+    assert.equal(b:reset(), b)
+    assert.equal(b:tostring(), 'https://api.example.com/v1')
+    assert.equal(b:cap(), cap)
+    assert.equal(b:segment('users'):param('id', 1):tostring(),
+                 'https://api.example.com/v1/users?id=1')
+
+    -- test that replace the base url
+    b:reset('http://example.com/?a=b')
+    assert.equal(b:cap(), cap)
+    assert.equal(b:param('c', 'd'):tostring(), 'http://example.com/?a=b&c=d')
+    b:reset()
+    assert.equal(b:tostring(), 'http://example.com/?a=b')
+    local err = assert.throws(b.segment, b, 'c')
+    assert.match(err, 'cannot append the path segment')
+end
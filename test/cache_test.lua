@@ -0,0 +1,158 @@
+local testcase = require('testcase')
+local url = require('url')
+
+function testcase.parse()
+    local c = url.cache(10)
+    local s = 'http://user@example.com:8080/foo/bar?a=b&a=c#frag'
+
+    -- test that returns the same result as parse
+    local res, cur, err = c:parse(s, true)
+    assert.equal({
+        res,
+        cur,
+        err,
+    }, {
+        url.parse(s, true),
+    })
+    assert.equal(c:stats(), {
+        size = 10,
+        entries = 1,
+        hits = 0,
+        misses = 1,
+        evictions = 0,
+    })
+
+    -- test that returns the same result on hit
+    local res2, cur2, err2 = c:parse(s, true)
+    assert.equal(res2, res)
+    assert.equal(cur2, cur)
+    assert.equal(err2, err)
+    assert.equal(c:stats().hits, 1)
+
+    -- test that the options are part of the key
+    res2 = c:parse(s)
+    assert.is_nil(res2.query_params)
+    res2 = c:parse('a=b', true, 0, true)
+    assert.equal(res2, url.parse('a=b', true, 0, true))
+    c:parse(s, false, 0, false, true)
+    assert.equal(c:stats().misses, 4)
+
+    -- test that the error is cached
+    s = 'http://example.com/foo bar'
+    assert.equal({
+        c:parse(s),
+    }, {
+        url.parse(s),
+    })
+    assert.equal({
+        c:parse(s),
+    }, {
+        url.parse(s),
+    })
+    assert.equal(c:stats(), {
+        size = 10,
+        entries = 5,
+        hits = 3,
+        misses = 5,
+        evictions = 0,
+    })
+end
+
+function testcase.lru_eviction()
+    local c = url.cache(3)
+    local first = c:parse('/1')
+    c:parse('/2')
+    c:parse('/3')
+
+    -- test that the least recently used entry is evicted
+    assert.equal(c:parse('/1'), first)
+    assert.equal(c:stats().hits, 1)
+    c:parse('/4')
+    assert.equal(c:stats(), {
+        size = 3,
+        entries = 3,
+        hits = 1,
+        misses = 4,
+        evictions = 1,
+    })
+    c:parse('/1')
+    c:parse('/3')
+    c:parse('/4')
+    assert.equal(c:stats().hits, 4)
+    -- '/2' was evicted
+    c:parse('/2')
+    assert.equal(c:stats().misses, 5)
+    assert.equal(c:stats().evictions, 2)
+    -- '/1' was evicted
+    assert.equal(c:parse('/1'), first)
+    assert.equal(c:stats().misses, 6)
+end
+
+function testcase.result_is_not_shared()
+    local c = url.cache(3)
+    local s = 'http://example.com/foo?a=b&a=c&x=y'
+    local res = c:parse(s, true)
+
+    -- test that modifying the result does not affect the next hit
+    res.path = '/bar'
+    res.query_params.x = nil
+    res.query_params.a[1] = 'z'
+    assert.equal(c:parse(s, true), url.parse(s, true))
+
+    -- test that the result of the hit can also be modified
+    res = c:parse(s, true)
+    res.query_params.a[2] = nil
+    assert.equal(c:parse(s, true), url.parse(s, true))
+    assert.equal(c:stats().hits, 2)
+end
+
+function testcase.not_cacheable()
+    local c = url.cache(3, 10)
+
+    -- test that the long url, the init option and the limits of the
+    -- query-params bypass the cache
+    c:parse('/0123456789')
+    c:parse('/0123456789')
+    c:parse('/foo', false, 1)
+    c:parse('/foo?a', {
+        max_params = 1,
+    })
+    assert.equal(c:stats().entries, 0)
+    assert.equal(c:stats().misses, 0)
+
+    -- test that throws the error of parse
+    local err = assert.throws(c.parse, c, {})
+    assert.match(err, 'string expected')
+end
+
+function testcase.clear()
+    local c = url.cache(3)
+    c:parse('/foo')
+    c:parse('/foo')
+
+    -- test that remove all entries and reset the counters
+    c:clear()
+    assert.equal(c:stats(), {
+        size = 3,
+        entries = 0,
+        hits = 0,
+        misses = 0,
+        evictions = 0,
+    })
+    c:parse('/foo')
+    assert.equal(c:stats().misses, 1)
+end
+
+function testcase.invalid_arguments()
+    -- test that throws an error if arguments are invalid
+    for _, v in ipairs({
+        0,
+        1.5,
+        'a',
+    }) do
+        local err = assert.throws(url.cache, v)
+        assert.match(err, 'positive integer expected')
+    end
+    local err = assert.throws(url.cache, 1, -1)
+    assert.match(err, 'bad argument #2')
+end
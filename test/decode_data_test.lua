@@ -0,0 +1,177 @@
+local testcase = require('testcase')
+local decode_data = require('url').decode_data
+
+local B64 = 'ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/'
+
+--- encode the string to the base64 with padding
+--- @param s string
+--- @return string
+local function base64(s)
+    local t = {}
+    for i = 1, #s, 3 do
+        local a, b, c = s:byte(i, i + 2)
+        local v = a * 65536 + (b or 0) * 256 + (c or 0)
+        local n = math.floor(v / 262144)
+        t[#t + 1] = B64:sub(n + 1, n + 1)
+        n = math.floor(v / 4096) % 64
+        t[#t + 1] = B64:sub(n + 1, n + 1)
+        n = math.floor(v / 64) % 64
+        t[#t + 1] = b and B64:sub(n + 1, n + 1) or '='
+        n = v % 64
+        t[#t + 1] = c and B64:sub(n + 1, n + 1) or '='
+    end
+    return table.concat(t)
+end
+
+function testcase.decode_data()
+    -- test that decode the percent-encoded data
+    assert.equal({
+        decode_data('data:text/plain,hello%20world'),
+    }, {
+        'hello world',
+        'text/plain',
+    })
+
+    -- test that the omitted mediatype is "text/plain;charset=US-ASCII"
+    assert.equal({
+        decode_data('data:,A%20brief%20note'),
+    }, {
+        'A brief note',
+        'text/plain',
+        {
+            charset = 'US-ASCII',
+        },
+    })
+    assert.equal({
+        decode_data('data:;charset=utf-8,x'),
+    }, {
+        'x',
+        'text/plain',
+        {
+            charset = 'utf-8',
+        },
+    })
+
+    -- test that lowercase the mediatype and the attributes, and unquote the
+    -- values. the first one is used if the attribute is duplicated
+    assert.equal({
+        decode_data(
+            'DATA:Text/HTML ; Charset="UTF-8";q=%31;q=2;novalue ;=x,<p>'),
+    }, {
+        '<p>',
+        'text/html',
+        {
+            charset = 'UTF-8',
+            q = '1',
+        },
+    })
+
+    -- test that drop the fragment
+    assert.equal({
+        decode_data('data:,abc#frag'),
+    }, {
+        'abc',
+        'text/plain',
+        {
+            charset = 'US-ASCII',
+        },
+    })
+end
+
+function testcase.decode_data_base64()
+    -- test that decode the base64 data
+    assert.equal({
+        decode_data('data:image/gif;base64,R0lGODlhAQABAAAAACw='),
+    }, {
+        'GIF89a\1\0\1\0\0\0\0,',
+        'image/gif',
+    })
+    assert.equal({
+        decode_data('data:text/plain;charset=utf-8;BASE64 ,SGVsbG8='),
+    }, {
+        'Hello',
+        'text/plain',
+        {
+            charset = 'utf-8',
+        },
+    })
+
+    -- test that the padding is optional and the whitespace is ignored
+    for s, exp in pairs({
+        [''] = '',
+        ['QQ'] = 'A',
+        ['QQ=='] = 'A',
+        ['QUI'] = 'AB',
+        ['QUI='] = 'AB',
+        ['QUJD'] = 'ABC',
+        [' Q U\tJ\nD\r\n '] = 'ABC',
+        ['QQ= ='] = 'A',
+        ['QUJDRA'] = 'ABCD',
+    }) do
+        assert.equal(decode_data('data:;base64,' .. s), exp)
+    end
+
+    -- test that decode the percent-encoded base64 data
+    assert.equal(decode_data('data:;base64,QU%4AD%0A'), 'ABC')
+
+    -- test that decode the long data in the blocks
+    local src = {}
+    for i = 0, 1023 do
+        src[#src + 1] = string.char(i % 256, (i * 7) % 256, (i * 13) % 256)
+    end
+    src = table.concat(src)
+    for _, n in ipairs({
+        0,
+        1,
+        2,
+        15,
+        16,
+        17,
+        47,
+        48,
+        49,
+        1000,
+        #src,
+    }) do
+        local s = src:sub(1, n)
+        assert.equal(decode_data('data:;base64,' .. base64(s)), s)
+    end
+
+    -- test that the whitespace in the middle of the blocks is ignored
+    local s = base64(src):gsub('(' .. ('.'):rep(61) .. ')', '%1\r\n')
+    assert.equal(decode_data('data:;base64,' .. s), src)
+end
+
+function testcase.decode_data_error()
+    -- test that return the position of the error
+    for s, pos in pairs({
+        ['http://example.com/'] = 1,
+        ['dat:,'] = 1,
+        ['data:text/plain'] = 16,
+        ['data:text/plain#,abc'] = 16,
+        ['data:text/%zz,abc'] = 11,
+        ['data:,%zz'] = 7,
+        -- the invalid base64
+        ['data:;base64,QUJD*'] = 18,
+        ['data:;base64,Q'] = 14,
+        ['data:;base64,QUJDR'] = 18,
+        ['data:;base64,QQ='] = 16,
+        ['data:;base64,QUJD='] = 18,
+        ['data:;base64,QQ===='] = 18,
+        ['data:;base64,QQ==QQ=='] = 18,
+        ['data:;base64,QUJDRA==\255'] = 22,
+        -- the position of the percent-encoded base64 is the head of the data
+        ['data:;base64,%51'] = 14,
+    }) do
+        assert.equal({
+            decode_data(s),
+        }, {
+            nil,
+            pos,
+        })
+    end
+
+    -- test that throws an error if the argument is not a string
+    local err = assert.throws(decode_data, {})
+    assert.match(err, 'string expected')
+end
@@ -61,6 +61,36 @@ function testcase.encode3986()
     assert.not_re_match(s, '[^' .. unescaped .. ']')
 end
 
+function testcase.encode_preserve()
+    -- test that keep the valid percent-encoded sequences with the uppercase
+    -- hex digits, and encode the other bytes
+    for name, exp in pairs({
+        encode_uri = 'a%20b%2Fc/%25zz%C3%A9%25%252?x=%7E',
+        encode_form = 'a%20b%2Fc%2F%25zz%C3%A9%25%252%3Fx%3D%7E',
+        encode2396 = 'a%20b%2Fc%2F%25zz%C3%A9%25%252%3Fx%3D%7E',
+        encode3986 = 'a%20b%2Fc%2F%25zz%C3%A9%25%252%3Fx%3D%7E',
+    }) do
+        local s = 'a%20b%2fc/%zz\195\169%%2?x=%7e'
+        assert.equal(url[name](s, true), exp)
+        -- test that the encoding is idempotent
+        assert.equal(url[name](exp, true), exp)
+        -- test that the '%' is encoded by default
+        assert.equal(url[name]('%41'), '%2541')
+    end
+
+    -- test that the truncated sequence at the end is encoded
+    assert.equal(url.encode3986('%4', true), '%254')
+    assert.equal(url.encode3986('%', true), '%25')
+
+    -- test that return the same string if nothing is changed
+    local s = string.rep('abc%E3%81%82', 100)
+    assert.equal(url.encode_uri(s, true), s)
+
+    -- test that throws an error if preserve is not a boolean
+    local err = assert.throws(url.encode_uri, 'a', 1)
+    assert.match(err, 'boolean expected')
+end
+
 function testcase.decode_uri()
     local escaped = ''
     for i = 1, 0x7E do
@@ -127,4 +157,167 @@ function testcase.decode_unicode_point()
     local s, err = url.decode_uri(cp)
     assert.is_nil(s)
     assert.equal(string.sub(cp, 1, err), '%20%')
+
+    -- test that returns err if the surrogate is not paired correctly
+    for _, v in ipairs({
+        'a%uD800%u0041',
+        'a%uDC00%u0041',
+        'a%uDC00%uDC00',
+        'a%uD800%uD800',
+        'a%uD800',
+    }) do
+        for _, strict in ipairs({
+            false,
+            true,
+        }) do
+            s, err = url.decode_uri(v, strict)
+            assert.is_nil(s)
+            assert.equal(err, 2)
+        end
+    end
+end
+
+function testcase.decode_strict_utf8()
+    -- test that decode well-formed UTF-8 in strict mode
+    for _, f in ipairs({
+        url.decode_uri,
+        url.decode_form,
+        url.decode,
+    }) do
+        assert.equal(f('%E3%81%82 \227\129\130 %u3042', true),
+                     'あ あ あ')
+        assert.equal(f('%F0%9F%98%80%C3%9F%EF%BF%BF', true),
+                     '\240\159\152\128\195\159\239\191\191')
+        assert.equal(f('', true), '')
+    end
+    assert.equal(url.decode_form('a+b%2B', true), 'a b+')
+    assert.equal(url.decode_uri('%2F%C3%A8', true), '%2Fè')
+
+    -- test that returns the position of the ill-formed sequence
+    for _, v in ipairs({
+        -- invalid lead bytes
+        {
+            'abc%FF',
+            4,
+        },
+        {
+            'ab\192\128',
+            3,
+        },
+        -- overlong
+        {
+            'a%C1%BF',
+            2,
+        },
+        {
+            '%E0%80%AF',
+            1,
+        },
+        {
+            '%F0%8F%BF%BF',
+            1,
+        },
+        -- surrogate
+        {
+            'x%ED%A0%80',
+            2,
+        },
+        -- greater than U+10FFFF
+        {
+            '%F4%90%80%80',
+            1,
+        },
+        -- broken and truncated sequences
+        {
+            'a%C3b',
+            2,
+        },
+        {
+            'a%E3%81',
+            2,
+        },
+        {
+            '%E3%81%u3042',
+            1,
+        },
+        {
+            '%E3\129%2F',
+            1,
+        },
+    }) do
+        local s, err = url.decode(v[1], true)
+        assert.is_nil(s)
+        assert.equal(err, v[2])
+        -- not validated by default
+        assert.is_string(url.decode(v[1]))
+    end
+
+    -- test that the invalid percent-encoding is reported as before
+    local s, err = url.decode('%E3%8', true)
+    assert.is_nil(s)
+    assert.equal(err, 4)
+end
+
+function testcase.decode_lenient()
+    -- test that copy the invalid '%' as it is and return the number of them
+    for _, v in ipairs({
+        {
+            'a%41%zz%4%',
+            'aA%zz%4%',
+            3,
+        },
+        {
+            '%u00e8%u12%uD83D%uDE00%',
+            '\195\168%u12\240\159\152\128%',
+            2,
+        },
+        {
+            '%E3%81%82',
+            '\227\129\130',
+            0,
+        },
+    }) do
+        assert.equal({
+            url.decode(v[1], false, true),
+        }, {
+            v[2],
+            v[3],
+        })
+    end
+    assert.equal({
+        url.decode_form('a+%2%2B', false, true),
+    }, {
+        'a %2+',
+        1,
+    })
+    assert.equal({
+        url.decode_uri('%2F%%41', false, true),
+    }, {
+        '%2F%A',
+        1,
+    })
+
+    -- test that the strict mode still rejects the ill-formed UTF-8
+    assert.equal({
+        url.decode('%zz%C3%28', true, true),
+    }, {
+        nil,
+        4,
+    })
+    assert.equal({
+        url.decode('%C3%', true, true),
+    }, {
+        nil,
+        1,
+    })
+    assert.equal({
+        url.decode('%zz%C3%A9', true, true),
+    }, {
+        '%zz\195\169',
+        1,
+    })
+
+    -- test that throws an error if lenient is not a boolean
+    local err = assert.throws(url.decode, 'a', false, 1)
+    assert.match(err, 'boolean expected')
 end
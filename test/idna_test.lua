@@ -0,0 +1,97 @@
+local testcase = require('testcase')
+local url = require('url')
+local host_to_ascii = url.host_to_ascii
+local host_to_unicode = url.host_to_unicode
+
+function testcase.host_to_ascii()
+    -- test that encode the non-ASCII labels to the punycode
+    for _, v in ipairs({
+        {
+            'b\195\188cher.example',
+            'xn--bcher-kva.example',
+        },
+        {
+            '\230\151\165\230\156\172\232\170\158.jp',
+            'xn--wgv71a119e.jp',
+        },
+        {
+            'm\195\188nchen',
+            'xn--mnchen-3ya',
+        },
+    }) do
+        assert.equal(host_to_ascii(v[1]), v[2])
+        assert.equal(host_to_unicode(v[2]), v[1])
+    end
+
+    -- test that the ideographic full stop is a label separator
+    assert.equal(host_to_ascii(
+                     '\228\190\139\227\129\136\227\128\130\227\131\134\227\130\185\227\131\136'),
+                 'xn--r8jz45g.xn--zckzah')
+
+    -- test that the percent-encoded bytes are decoded
+    assert.equal(host_to_ascii('b%C3%BCcher.example'), 'xn--bcher-kva.example')
+
+    -- test that the ASCII characters are lowercased
+    assert.equal(host_to_ascii('WWW.Example.COM.'), 'www.example.com.')
+    assert.equal(host_to_ascii(''), '')
+
+    -- test that returns an error position of the invalid label
+    local s, err = host_to_ascii('\255')
+    assert.is_nil(s)
+    assert.equal(err, 1)
+    s, err = host_to_ascii('example.b\195cher')
+    assert.is_nil(s)
+    assert.equal(err, 9)
+    s, err = host_to_ascii('a%zz')
+    assert.is_nil(s)
+    assert.equal(err, 1)
+    -- label must not exceed 63 bytes
+    s, err = host_to_ascii('a.' .. string.rep('b', 64))
+    assert.is_nil(s)
+    assert.equal(err, 3)
+    s = host_to_ascii('a.' .. string.rep('b', 63))
+    assert.equal(s, 'a.' .. string.rep('b', 63))
+
+    -- test that throws an error if argument is not a string
+    err = assert.throws(host_to_ascii, {})
+    assert.match(err, 'string expected')
+end
+
+function testcase.host_to_unicode()
+    -- test that the ASCII labels are lowercased
+    assert.equal(host_to_unicode('XN--BCHER-KVA.Example'),
+                 'b\195\188cher.example')
+
+    -- test that returns an error position of the invalid punycode label
+    local s, err = host_to_unicode('example.xn--a-.com')
+    assert.is_nil(s)
+    assert.equal(err, 9)
+    s, err = host_to_unicode('xn--99999999999')
+    assert.is_nil(s)
+    assert.equal(err, 1)
+
+    -- test that throws an error if argument is not a string
+    err = assert.throws(host_to_unicode, 1)
+    assert.match(err, 'string expected')
+end
+
+function testcase.parse_ascii_host()
+    -- test that convert the hostname to the ASCII form
+    local res, cur, err = url.parse('http://B%C3%BCcher.example:8080/p', false,
+                                    0, false, true)
+    assert.equal(res, {
+        scheme = 'http',
+        host = 'B%C3%BCcher.example:8080',
+        hostname = 'xn--bcher-kva.example',
+        port = '8080',
+        path = '/p',
+    })
+    assert.equal(cur, 33)
+    assert.is_nil(err)
+
+    -- test that keep the hostname if it cannot be converted
+    res, cur, err = url.parse('http://example.b%FFcher/p', false, 0, false, true)
+    assert.equal(res.hostname, 'example.b%FFcher')
+    assert.equal(cur, 15)
+    assert.equal(err, 'b')
+end
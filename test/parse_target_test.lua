@@ -0,0 +1,294 @@
+local testcase = require('testcase')
+local parse_target = require('url').parse_target
+
+function testcase.origin_form()
+    -- test that parse the origin-form
+    assert.equal({
+        parse_target('/where?q=now'),
+    }, {
+        {
+            form = 'origin',
+            path = '/where',
+            query = '?q=now',
+        },
+        12,
+    })
+
+    -- test that parse the request line
+    assert.equal({
+        parse_target('GET /where?q=now HTTP/1.1\r\n'),
+    }, {
+        {
+            method = 'GET',
+            form = 'origin',
+            path = '/where',
+            query = '?q=now',
+            version = '1.1',
+        },
+        25,
+        '\r',
+    })
+
+    -- test that the HTTP/0.9 request line has no version
+    assert.equal({
+        parse_target('GET /'),
+    }, {
+        {
+            method = 'GET',
+            form = 'origin',
+            path = '/',
+        },
+        5,
+    })
+
+    -- test that parse from the init position
+    assert.equal({
+        parse_target('xxGET / HTTP/1.0', 2),
+    }, {
+        {
+            method = 'GET',
+            form = 'origin',
+            path = '/',
+            version = '1.0',
+        },
+        16,
+    })
+end
+
+function testcase.origin_form_with_host()
+    -- test that combine the origin-form with the Host header value
+    assert.equal({
+        parse_target('GET /pub/index.html?a=b HTTP/1.1', 0,
+                     'www.example.org:8080'),
+    }, {
+        {
+            method = 'GET',
+            form = 'origin',
+            scheme = 'http',
+            host = 'www.example.org:8080',
+            hostname = 'www.example.org',
+            port = '8080',
+            path = '/pub/index.html',
+            query = '?a=b',
+            version = '1.1',
+        },
+        32,
+    })
+    assert.equal({
+        parse_target('/', 0, '[::1]', 'https'),
+    }, {
+        {
+            form = 'origin',
+            scheme = 'https',
+            host = '[::1]',
+            hostname = '[::1]',
+            path = '/',
+        },
+        1,
+    })
+
+    -- test that return the position in the Host header value if it is invalid
+    for host, pos in pairs({
+        [''] = 0,
+        ['example.com/'] = 11,
+        ['user@example.com'] = 0,
+        ['example.com:80x'] = 15,
+        [':80'] = 0,
+    }) do
+        local res, cur, err = parse_target('GET / HTTP/1.1', 0, host)
+        assert.equal(res.path, '/')
+        assert.is_nil(res.scheme)
+        assert.equal({
+            cur,
+            err,
+        }, {
+            pos,
+            'host',
+        })
+    end
+end
+
+function testcase.absolute_form()
+    -- test that parse the absolute-form
+    assert.equal({
+        parse_target('GET http://www.example.org/pub/?x HTTP/1.1'),
+    }, {
+        {
+            method = 'GET',
+            form = 'absolute',
+            scheme = 'http',
+            host = 'www.example.org',
+            hostname = 'www.example.org',
+            path = '/pub/',
+            query = '?x',
+            version = '1.1',
+        },
+        42,
+    })
+
+    -- test that the Host header value is ignored
+    local res = assert(parse_target('http://a.example:81/', 0, 'b.example'))
+    assert.equal(res.host, 'a.example:81')
+    assert.equal(res.form, 'absolute')
+end
+
+function testcase.authority_form()
+    -- test that parse the authority-form of the CONNECT request
+    assert.equal({
+        parse_target('CONNECT server.example.com:80 HTTP/1.1'),
+    }, {
+        {
+            method = 'CONNECT',
+            form = 'authority',
+            host = 'server.example.com:80',
+            hostname = 'server.example.com',
+            port = '80',
+            version = '1.1',
+        },
+        38,
+    })
+    assert.equal({
+        parse_target('CONNECT [2001:db8::1]:443 HTTP/1.1', 0, 'ignored'),
+    }, {
+        {
+            method = 'CONNECT',
+            form = 'authority',
+            host = '[2001:db8::1]:443',
+            hostname = '[2001:db8::1]',
+            port = '443',
+            version = '1.1',
+        },
+        34,
+    })
+
+    -- test that the target with the host and the port is treated as the
+    -- authority-form if the method is not given
+    assert.equal({
+        parse_target('example.com:443'),
+    }, {
+        {
+            form = 'authority',
+            host = 'example.com:443',
+            hostname = 'example.com',
+            port = '443',
+        },
+        15,
+    })
+end
+
+function testcase.asterisk_form()
+    -- test that parse the asterisk-form
+    assert.equal({
+        parse_target('OPTIONS * HTTP/1.1', 0, 'example.com'),
+    }, {
+        {
+            method = 'OPTIONS',
+            form = 'asterisk',
+            scheme = 'http',
+            host = 'example.com',
+            hostname = 'example.com',
+            version = '1.1',
+        },
+        18,
+    })
+    assert.equal({
+        parse_target('*'),
+    }, {
+        {
+            form = 'asterisk',
+        },
+        1,
+    })
+end
+
+function testcase.error()
+    -- test that return the position and the illegal character
+    for s, exp in pairs({
+        -- the request-target ends unexpectedly
+        [''] = {
+            0,
+            'eof',
+        },
+        ['GET '] = {
+            4,
+            'eof',
+        },
+        ['CONNECT h:'] = {
+            10,
+            'eof',
+        },
+        ['GET / '] = {
+            6,
+            'eof',
+        },
+        ['GET / HTTP/1.'] = {
+            6,
+            'H',
+        },
+        ['GET  HTTP/1.1'] = {
+            4,
+            ' ',
+        },
+        -- fragment is not allowed
+        ['GET /a#b HTTP/1.1'] = {
+            6,
+            '#',
+        },
+        ['GET //a HTTP/1.1'] = {
+            5,
+            '/',
+        },
+        ['GET /a%zz HTTP/1.1'] = {
+            6,
+            '%',
+        },
+        -- absolute-form requires the scheme
+        ['GET a/b HTTP/1.1'] = {
+            4,
+            'a',
+        },
+        -- asterisk-form is only for OPTIONS
+        ['GET * HTTP/1.1'] = {
+            4,
+            '*',
+        },
+        -- authority-form is only for CONNECT
+        ['CONNECT / HTTP/1.1'] = {
+            8,
+            '/',
+        },
+        ['CONNECT example.com HTTP/1.1'] = {
+            19,
+            ' ',
+        },
+        ['CONNECT user@example.com:80 HTTP/1.1'] = {
+            8,
+            'u',
+        },
+        -- invalid version
+        ['GET / HTTP/1'] = {
+            6,
+            'H',
+        },
+        ['GET / http/1.1'] = {
+            6,
+            'h',
+        },
+        ['GET / HTTP/1.x'] = {
+            6,
+            'H',
+        },
+    }) do
+        local _, cur, err = parse_target(s)
+        assert.equal({
+            cur,
+            err,
+        }, exp)
+    end
+
+    -- test that throws an error if the argument is invalid
+    local err = assert.throws(parse_target, {})
+    assert.match(err, 'string expected')
+    err = assert.throws(parse_target, '/', 0, {})
+    assert.match(err, 'string expected')
+end
@@ -287,6 +287,29 @@ function testcase.parse_scheme()
         port = '80',
     })
 
+    -- test that parse ipv6 host at the end of the url
+    s = 'https://[::1]'
+    u, cur, err = parse(s)
+    assert.equal(cur, #s)
+    assert.is_nil(err)
+    assert.equal(u, {
+        scheme = 'https',
+        host = '[::1]',
+        hostname = '[::1]',
+    })
+
+    -- test that parse ipv6 host followed by the fragment
+    s = 'https://[::1]#hash'
+    u, cur, err = parse(s)
+    assert.equal(cur, #s)
+    assert.is_nil(err)
+    assert.equal(u, {
+        scheme = 'https',
+        host = '[::1]',
+        hostname = '[::1]',
+        fragment = 'hash',
+    })
+
     -- test that parse scheme with port
     s = 'https://:80'
     u, cur, err = parse(s)
@@ -309,12 +332,97 @@ function testcase.parse_scheme()
         path = './foo/bar',
     })
 
-    -- test that return an error if invalid scheme format
+    -- test that the scheme without double-slash is parsed as opaque URI
     s = 'http:/localhost'
     u, cur, err = parse(s)
-    assert.equal(cur, 4)
-    assert.equal(err, ':')
-    assert.equal(u, {})
+    assert.equal(cur, #s)
+    assert.is_nil(err)
+    assert.equal(u, {
+        scheme = 'http',
+        path = '/localhost',
+    })
+
+    -- test that return an error if the scheme is not started with ALPHA
+    for _, v in ipairs({
+        ':foo',
+        '1a:foo',
+        '+a:foo',
+    }) do
+        u, cur, err = parse(v)
+        assert.equal(cur, #v - 4)
+        assert.equal(err, ':')
+        assert.equal(u, {})
+    end
+end
+
+function testcase.parse_opaque()
+    -- test that parse opaque URIs
+    for s, exp in pairs({
+        ['mailto:user@example.com?subject=hi'] = {
+            scheme = 'mailto',
+            path = 'user@example.com',
+            query = '?subject=hi',
+        },
+        ['urn:isbn:0451450523'] = {
+            scheme = 'urn',
+            path = 'isbn:0451450523',
+        },
+        ['data:text/plain;base64,SGVsbG8=#frag'] = {
+            scheme = 'data',
+            path = 'text/plain;base64,SGVsbG8=',
+            fragment = 'frag',
+        },
+        ['tel:+1-201-555-0123'] = {
+            scheme = 'tel',
+            path = '+1-201-555-0123',
+        },
+        ['about:'] = {
+            scheme = 'about',
+            path = '',
+        },
+    }) do
+        local u, cur, err = parse(s)
+        assert.equal(cur, #s)
+        assert.is_nil(err)
+        assert.equal(u, exp)
+    end
+
+    -- test that return an error if the opaque part contains an illegal byte
+    local s = 'mailto:a b'
+    local u, cur, err = parse(s)
+    assert.equal(cur, 8)
+    assert.equal(err, ' ')
+    assert.equal(u, {
+        scheme = 'mailto',
+        path = 'a',
+    })
+
+    -- test that the "host:port" without "//" is parsed as the opaque URI
+    -- whose scheme is the hostname, as RFC 3986 does
+    for s, exp in pairs({
+        ['localhost:8080'] = {
+            scheme = 'localhost',
+            path = '8080',
+        },
+        ['Localhost:8080/p?q'] = {
+            scheme = 'Localhost',
+            path = '8080/p',
+            query = '?q',
+        },
+        -- the hostname that contains "." or starts with a digit is parsed
+        -- as the path
+        ['example.com:8080'] = {
+            path = 'example.com:8080',
+        },
+        ['127.0.0.1:8080'] = {
+            path = '127.0.0.1:8080',
+        },
+    }) do
+        u, cur, err = parse(s)
+        assert.equal(cur, #s)
+        assert.is_nil(err)
+        assert.equal(u, exp)
+    end
 end
 
 function testcase.parse_host()
@@ -714,6 +822,113 @@ function testcase.parse_query_params()
     })
 end
 
+function testcase.parse_query_params_limits()
+    local s = 'http://a/?k1=v1&k2=%41%42&k1=v3&k3#f'
+
+    -- test that parse query with the limits that are not exceeded
+    local u, cur, err = parse(s, {
+        max_params = 4,
+        max_key_len = 2,
+        max_value_len = 2,
+        max_values = 2,
+        max_bytes = 14,
+    })
+    assert.equal(cur, #s)
+    assert.is_nil(err)
+    assert.equal(u.query_params, {
+        k1 = {
+            'v1',
+            'v3',
+        },
+        k2 = {
+            'AB',
+        },
+        k3 = {
+            '',
+        },
+    })
+
+    -- test that an empty table has no limits
+    u = parse(s, {})
+    assert.equal(u.query_params.k2, {
+        'AB',
+    })
+
+    -- test that stop at the key-value pair that exceeds the limit
+    for _, v in ipairs({
+        {
+            limits = {
+                max_params = 3,
+            },
+            pair = 'k3#f',
+        },
+        {
+            limits = {
+                max_key_len = 1,
+            },
+            pair = 'k1=v1&',
+        },
+        {
+            limits = {
+                max_value_len = 1,
+            },
+            pair = 'k1=v1&',
+        },
+        {
+            limits = {
+                max_values = 1,
+            },
+            pair = 'k1=v3&',
+        },
+        {
+            limits = {
+                max_values = 0,
+            },
+            pair = 'k1=v1&',
+        },
+        {
+            limits = {
+                max_bytes = 13,
+            },
+            pair = 'k3#f',
+        },
+    }) do
+        u, cur, err = parse(s, v.limits)
+        assert.equal(string.sub(s, cur + 1, cur + #v.pair), v.pair)
+        assert.equal(err, next(v.limits))
+        assert.is_nil(u.query_params)
+        assert.equal(u.query, '?k1=v1&k2=%41%42&k1=v3&k3')
+        assert.equal(u.fragment, 'f')
+    end
+
+    -- test that the decoded length is checked before decoding
+    u, cur, err = parse('?k=' .. string.rep('%41', 100), {
+        max_value_len = 99,
+    })
+    assert.equal(cur, 1)
+    assert.equal(err, 'max_value_len')
+
+    -- test that the limits are applied to the query-string
+    u, cur, err = parse('a&a&a&a', {
+        max_values = 3,
+    }, 0, true)
+    assert.equal(cur, 6)
+    assert.equal(err, 'max_values')
+
+    -- test that throws an error if the limit is invalid
+    for _, v in ipairs({
+        -1,
+        1.5,
+        '1',
+        0 / 0,
+    }) do
+        err = assert.throws(parse, s, {
+            max_params = v,
+        })
+        assert.match(err, 'parse_query.max_params must be unsigned integer')
+    end
+end
+
 function testcase.parse_as_query()
     -- test that parse query
     local s = 'q1=v1-1&q1=v1-1%20&q2=v2'
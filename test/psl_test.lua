@@ -0,0 +1,160 @@
+local testcase = require('testcase')
+local psl_load = require('url').psl_load
+
+local TMPFILE = os.tmpname()
+
+local function write_list(...)
+    local f = assert(io.open(TMPFILE, 'w'))
+    f:write(table.concat({
+        ...,
+    }, '\n'))
+    f:close()
+end
+
+local function load_list()
+    write_list('// ===BEGIN ICANN DOMAINS===', '', 'com', 'jp', 'co.jp',
+               '*.kobe.jp', '!city.kobe.jp', 'uk', 'co.uk   ignored words',
+               '*.ck', '!www.ck', '公司.cn', '// ===BEGIN PRIVATE DOMAINS===',
+               'github.io', 'blogspot.com')
+    return assert(psl_load(TMPFILE))
+end
+
+function testcase.psl_load()
+    -- test that load the rules from the file
+    local psl = load_list()
+    assert.match(tostring(psl), 'url.psl: ')
+    assert.equal(psl:len(), 12)
+
+    -- test that return nil and the error message if the rule is invalid
+    for _, v in ipairs({
+        '!jp',
+        'a..jp',
+        '.jp',
+        'foo.*.jp',
+        'a!b.jp',
+        'a%zz.jp',
+        ('a'):rep(300),
+    }) do
+        write_list('com', '', v)
+        local err
+        psl, err = psl_load(TMPFILE)
+        assert.is_nil(psl)
+        assert.match(err, TMPFILE .. ':3: ')
+    end
+
+    -- test that return nil and the error message if the file cannot open
+    local err
+    psl, err = psl_load(TMPFILE .. '/noent')
+    assert.is_nil(psl)
+    assert.match(err, 'noent: ')
+    assert.not_match(err, 'noent:%d')
+end
+
+function testcase.public_suffix()
+    local psl = load_list()
+
+    -- test that return the public suffix of the host
+    for host, exp in pairs({
+        ['example.com'] = 'com',
+        ['www.example.co.jp'] = 'co.jp',
+        ['example.jp'] = 'jp',
+        ['co.jp'] = 'co.jp',
+        ['www.example.co.uk'] = 'co.uk',
+        -- the default rule "*"
+        ['www.example.test'] = 'test',
+        ['test'] = 'test',
+        -- the wildcard rules and the exception rules
+        ['foo.bar.kobe.jp'] = 'bar.kobe.jp',
+        ['bar.kobe.jp'] = 'bar.kobe.jp',
+        ['kobe.jp'] = 'jp',
+        ['www.city.kobe.jp'] = 'kobe.jp',
+        ['city.kobe.jp'] = 'kobe.jp',
+        ['www.example.ck'] = 'example.ck',
+        ['www.ck'] = 'ck',
+        -- the private rules
+        ['foo.github.io'] = 'github.io',
+        ['foo.blogspot.com'] = 'blogspot.com',
+        -- the trailing dot and the upper case letters
+        ['www.Example.COM.'] = 'com',
+        -- the internationalized rules and host names
+        ['www.example.公司.cn'] = 'xn--55qx5d.cn',
+        ['www.example.xn--55qx5d.cn'] = 'xn--55qx5d.cn',
+    }) do
+        assert.equal(psl:public_suffix(host), exp)
+    end
+
+    -- test that return nil if the host is an IP address or has empty label
+    for _, host in ipairs({
+        '',
+        '.',
+        '127.0.0.1',
+        '[::1]',
+        '.example.com',
+        'www..example.com',
+        'example.com..',
+    }) do
+        assert.is_nil(psl:public_suffix(host))
+    end
+
+    -- test that return nil and the position of the invalid label
+    assert.equal({
+        psl:public_suffix('www.%zz.com'),
+    }, {
+        nil,
+        5,
+    })
+
+    -- test that throws an error if the host is not a string
+    local err = assert.throws(psl.public_suffix, psl, {})
+    assert.match(err, 'string expected')
+end
+
+function testcase.registrable_domain()
+    local psl = load_list()
+
+    -- test that return the public suffix and one more label
+    for host, exp in pairs({
+        ['example.com'] = 'example.com',
+        ['a.b.example.com'] = 'example.com',
+        ['www.example.co.jp'] = 'example.co.jp',
+        ['www.example.test'] = 'example.test',
+        ['foo.bar.kobe.jp'] = 'foo.bar.kobe.jp',
+        ['www.city.kobe.jp'] = 'city.kobe.jp',
+        ['www.ck'] = 'www.ck',
+        ['a.b.foo.github.io'] = 'foo.github.io',
+        ['www.Example.COM.'] = 'example.com',
+        ['www.例え.公司.cn'] = 'xn--r8jz45g.xn--55qx5d.cn',
+        [('a'):rep(63) .. '.' .. ('b'):rep(63) .. '.com'] = ('b'):rep(63) ..
+            '.com',
+    }) do
+        assert.equal(psl:registrable_domain(host), exp)
+    end
+
+    -- test that return nil if the host itself is the public suffix
+    for _, host in ipairs({
+        'com',
+        'co.jp',
+        'bar.kobe.jp',
+        'github.io',
+        'test',
+        '192.168.0.1',
+    }) do
+        assert.is_nil(psl:registrable_domain(host))
+    end
+
+    -- test that return nil if the host is too long
+    assert.is_nil(psl:registrable_domain(('a.'):rep(127) .. 'com'))
+    -- the source that cannot fit in 253 bytes is not converted
+    for _, host in ipairs({
+        ('a.'):rep(1024 * 512),
+        ('%F0%9F%98%80'):rep(254),
+    }) do
+        assert.equal({
+            psl:registrable_domain(host),
+        }, {})
+        assert.equal({
+            psl:public_suffix(host),
+        }, {})
+    end
+    os.remove(TMPFILE)
+end
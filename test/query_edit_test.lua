@@ -0,0 +1,142 @@
+local testcase = require('testcase')
+local query_edit = require('url').query_edit
+
+function testcase.query_edit()
+    local s = 'http://example.com/p?b=2&a=1&c=%20x&a=0#frag'
+
+    -- test that replace the first pair and remove the others of the key
+    assert.equal(query_edit(s, {
+        a = 'new value',
+    }), 'http://example.com/p?b=2&a=new+value&c=%20x#frag')
+
+    -- test that remove the key
+    assert.equal(query_edit(s, {
+        a = false,
+    }), 'http://example.com/p?b=2&c=%20x#frag')
+
+    -- test that replace the key with the multiple values
+    assert.equal(query_edit(s, {
+        b = {
+            1,
+            'x&y',
+            true,
+        },
+    }), 'http://example.com/p?b=1&b=x%26y&b&a=1&c=%20x&a=0#frag')
+
+    -- test that append the new keys in order of the key
+    assert.equal(query_edit(s, {
+        z = 'z',
+        y = true,
+        ['k e=y'] = '=',
+    }), 'http://example.com/p?b=2&a=1&c=%20x&a=0&k+e%3Dy=%3D&y&z=z#frag')
+
+    -- test that match the decoded key
+    assert.equal(query_edit('/?%61=1&a+b=2&a%20b=3', {
+        a = 'x',
+        ['a b'] = false,
+    }), '/?a=x')
+end
+
+function testcase.query_edit_keep_untouched()
+    -- test that return the url as is if not modified
+    local s = '/p?&b=2&&a=%7e&x#f'
+    assert.equal(query_edit(s, {}), s)
+    assert.equal(query_edit(s, {
+        c = false,
+    }), s)
+
+    -- test that the untouched pairs are copied verbatim
+    assert.equal(query_edit(s, {
+        b = false,
+    }), '/p?a=%7e&x#f')
+end
+
+function testcase.query_edit_empty_query()
+    -- test that add the query to the url that has no query
+    assert.equal(query_edit('http://a/p', {
+        x = 1,
+    }), 'http://a/p?x=1')
+    assert.equal(query_edit('http://a/p#f', {
+        x = 1,
+    }), 'http://a/p?x=1#f')
+    assert.equal(query_edit('http://a/p?#f', {
+        x = 1,
+    }), 'http://a/p?x=1#f')
+    assert.equal(query_edit('http://a', {
+        x = 1,
+    }), 'http://a?x=1')
+    assert.equal(query_edit('http://a/p&?&&#f', {
+        x = 1,
+    }), 'http://a/p&?x=1#f')
+
+    -- test that remove the query delimiter if no pairs remain
+    assert.equal(query_edit('http://a/p?x=1&x=2#f', {
+        x = false,
+    }), 'http://a/p#f')
+    assert.equal(query_edit('http://a/p?x=1', {
+        x = {},
+    }), 'http://a/p')
+end
+
+function testcase.query_edit_querystring()
+    -- test that edit the query-string
+    assert.equal(query_edit('a=1&b=2', {
+        a = false,
+        c = 3,
+    }, true), 'b=2&c=3')
+    assert.equal(query_edit('?a=1&b=2', {
+        b = false,
+    }, true), '?a=1')
+    assert.equal(query_edit('?a=1', {
+        a = false,
+    }, true), '')
+    assert.equal(query_edit('', {
+        a = 1,
+    }, true), 'a=1')
+    assert.equal(query_edit('?&&', {
+        a = 1,
+    }, true), '?a=1')
+end
+
+function testcase.query_edit_many_edits()
+    -- test that the edits that exceed the stack buffer
+    local edits = {}
+    local pairs = {}
+    local long = string.rep('\xff', 1024)
+    for i = 1, 100 do
+        local k = string.format('k%03d', i)
+        edits[k] = long
+        pairs[i] = k .. '=' .. string.rep('%FF', 1024)
+    end
+    assert.equal(query_edit('/', edits), '/?' .. table.concat(pairs, '&'))
+end
+
+function testcase.query_edit_error()
+    -- test that return nil and the position of the illegal byte
+    local s, pos = query_edit('http://example.com/?a=1 b', {
+        a = false,
+    })
+    assert.is_nil(s)
+    assert.equal(pos, 24)
+
+    -- test that throw the error if the edits are invalid
+    local err = assert.throws(query_edit, '/', 'a')
+    assert.match(err, 'table expected')
+    err = assert.throws(query_edit, '/', {
+        [1] = 'a',
+    })
+    assert.match(err, 'edits key must be string')
+    err = assert.throws(query_edit, '/', {
+        a = {},
+        b = function()
+        end,
+    })
+    assert.match(err, 'edits.b must be string, number, boolean or table')
+    err = assert.throws(query_edit, '/', {
+        a = {
+            'x',
+            false,
+        },
+    })
+    assert.match(err, 'edits.a#2 must not be false')
+end
@@ -0,0 +1,132 @@
+local testcase = require('testcase')
+local split_path = require('url').split_path
+
+function testcase.split_path()
+    -- test that split the path into segments
+    assert.equal(split_path('/foo/bar/baz'), {
+        'foo',
+        'bar',
+        'baz',
+    })
+    assert.equal(split_path('foo/bar'), {
+        'foo',
+        'bar',
+    })
+
+    -- test that keep empty and dot segments
+    assert.equal(split_path('/foo//./../bar/'), {
+        'foo',
+        '',
+        '.',
+        '..',
+        'bar',
+        '',
+    })
+    assert.equal(split_path('/'), {
+        '',
+    })
+    assert.equal(split_path(''), {})
+
+    -- test that segments are not decoded by default
+    assert.equal(split_path('/foo%2Fbar/b%41z'), {
+        'foo%2Fbar',
+        'b%41z',
+    })
+end
+
+function testcase.split_path_of_url()
+    -- test that split the path of the url
+    assert.equal(split_path(
+                     'http://user@example.com:8080/foo/bar?q=/a/b#/c/d'), {
+        'foo',
+        'bar',
+    })
+    assert.equal(split_path('/foo/bar?q=/a/b'), {
+        'foo',
+        'bar',
+    })
+
+    -- test that returns empty table if url has no path
+    assert.equal(split_path('http://example.com'), {})
+    assert.equal(split_path('?q=/a/b'), {})
+
+    -- test that returns error position if url contains illegal byte
+    local s = '/foo/b r'
+    local segs, err = split_path(s)
+    assert.is_nil(segs)
+    assert.equal(string.sub(s, 1, err), '/foo/b ')
+end
+
+function testcase.split_path_decode()
+    -- test that decode the percent-encoded segments
+    assert.equal(split_path('/foo%2Fbar/b%41z/%E3%81%82', true), {
+        'foo/bar',
+        'bAz',
+        'あ',
+    })
+
+    -- test that returns error position if segment has invalid encoding
+    local s = '/foo/bar%2/baz'
+    local segs, err = split_path(s, true)
+    assert.is_nil(segs)
+    assert.equal(string.sub(s, 1, err), '/foo/bar%')
+end
+
+function testcase.split_path_normalize()
+    -- test that skip empty and "." segments, and ".." removes the previous
+    assert.equal(split_path('//foo/./bar//../baz/', false, true), {
+        'foo',
+        'baz',
+    })
+    assert.equal(split_path('/../../foo/..', false, true), {})
+
+    -- test that dot segments are checked after decoding
+    assert.equal(split_path('/foo/%2e%2E/bar/%2e', true, true), {
+        'bar',
+    })
+    assert.equal(split_path('/foo/%2e%2E/bar/%2e', false, true), {
+        'foo',
+        '%2e%2E',
+        'bar',
+        '%2e',
+    })
+end
+
+function testcase.split_path_reuse_table()
+    -- test that the passed table is reused
+    local segs = {
+        'a',
+        'b',
+        'c',
+        'd',
+    }
+    assert.equal(split_path('/foo/bar', false, false, segs), segs)
+    assert.equal(segs, {
+        'foo',
+        'bar',
+    })
+    assert.equal(split_path('/foo/bar/baz/qux/quux', nil, nil, segs), segs)
+    assert.equal(segs, {
+        'foo',
+        'bar',
+        'baz',
+        'qux',
+        'quux',
+    })
+    assert.equal(split_path('/a/b/../c/..', false, true, segs), segs)
+    assert.equal(segs, {
+        'a',
+    })
+end
+
+function testcase.split_path_invalid_arguments()
+    -- test that throws an error if argument is invalid
+    local err = assert.throws(split_path, {})
+    assert.match(err, 'string expected')
+    err = assert.throws(split_path, '/', 'true')
+    assert.match(err, 'boolean expected')
+    err = assert.throws(split_path, '/', nil, 1)
+    assert.match(err, 'boolean expected')
+    err = assert.throws(split_path, '/', nil, nil, 'segs')
+    assert.match(err, 'table expected')
+end
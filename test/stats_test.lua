@@ -0,0 +1,61 @@
+local testcase = require('testcase')
+local url = require('url')
+
+function testcase.stats()
+    if not url.stats() then
+        -- test that the counters are not available without URL_STATS
+        assert.is_nil(url.stats())
+        url.stats_reset()
+        return
+    end
+
+    -- test that the counters are reset
+    url.stats_reset()
+    local stats = url.stats()
+    for _, name in ipairs({
+        'encode_uri',
+        'encode_form',
+        'encode2396',
+        'encode3986',
+        'decode_uri',
+        'decode_form',
+        'decode',
+        'host_to_ascii',
+        'host_to_unicode',
+        'parse',
+        'parse_query',
+        'decode_data',
+    }) do
+        assert.equal(stats[name], {
+            calls = 0,
+            bytes_in = 0,
+            bytes_out = 0,
+            errors = 0,
+            ns = 0,
+        })
+    end
+
+    -- test that count the calls, bytes and errors
+    url.encode_uri('a b')
+    url.encode_uri('c')
+    url.decode_form('a+%41')
+    url.decode_form('%zz')
+    url.parse('http://example.com/?a=b&c=d', true)
+    url.parse('http://example.com/ tail')
+    stats = url.stats()
+    assert.equal(stats.encode_uri.calls, 2)
+    assert.equal(stats.encode_uri.bytes_in, 4)
+    assert.equal(stats.encode_uri.bytes_out, 6)
+    assert.equal(stats.encode_uri.errors, 0)
+    assert.equal(stats.decode_form.calls, 2)
+    assert.equal(stats.decode_form.bytes_in, 8)
+    assert.equal(stats.decode_form.bytes_out, 3)
+    assert.equal(stats.decode_form.errors, 1)
+    assert.equal(stats.parse.calls, 2)
+    assert.equal(stats.parse.bytes_in, 46)
+    assert.equal(stats.parse.errors, 1)
+    assert.equal(stats.parse_query.calls, 1)
+    assert.equal(stats.parse_query.bytes_in, 8)
+    assert.greater_or_equal(stats.parse.ns, stats.parse_query.ns)
+    assert.equal(stats.decode.calls, 0)
+end
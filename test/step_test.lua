@@ -0,0 +1,198 @@
+local testcase = require('testcase')
+local url = require('url')
+local step = url.step
+
+local INPUTS = {
+    '',
+    'a',
+    'foo bar/ほげ?a=b&c=d#e',
+    '%E3%81%82+%2F%u3042%uD869%uDEB2+%41',
+    string.rep('%E3%81%82%20%2F%3Fabc+', 50),
+    'abc%zz',
+    'a%C3b',
+    '%E3%81',
+    '%F0%9F%98%80%F0%9F%98%80%ED%A0%80',
+}
+
+function testcase.codec()
+    -- test that returns the same results as the url module
+    for _, s in ipairs(INPUTS) do
+        for _, slice in ipairs({
+            1,
+            2,
+            3,
+            7,
+            64,
+        }) do
+            local opts = {
+                slice = slice,
+                yield = false,
+            }
+            for _, name in ipairs({
+                'encode_uri',
+                'encode_form',
+                'encode2396',
+                'encode3986',
+            }) do
+                assert.equal(step[name](s, opts), url[name](s))
+            end
+            for _, name in ipairs({
+                'decode_uri',
+                'decode_form',
+                'decode',
+            }) do
+                assert.equal({
+                    step[name](s, nil, opts),
+                }, {
+                    url[name](s),
+                })
+                assert.equal({
+                    step[name](s, true, opts),
+                }, {
+                    url[name](s, true),
+                })
+            end
+        end
+    end
+
+    -- test that throws an error if argument is invalid
+    local err = assert.throws(step.encode_uri, {})
+    assert.match(err, 'string expected')
+    err = assert.throws(step.decode, 'foo', nil, 'bar')
+    assert.match(err, 'bad argument #3')
+    err = assert.throws(step.decode, 'foo', nil, {
+        slice = 0,
+    })
+    assert.match(err, 'opts.slice must be positive integer')
+    err = assert.throws(step.encode_form, 'foo', {
+        yield = 1,
+    })
+    assert.match(err, 'opts.yield must be function or false')
+end
+
+function testcase.yield()
+    local s = string.rep('%41', 100)
+
+    -- test that call the yield function between the slices
+    local n = 0
+    assert.equal(step.decode(s, nil, {
+        slice = 30,
+        yield = function()
+            n = n + 1
+        end,
+    }), string.rep('A', 100))
+    assert.equal(n, 9)
+
+    -- test that yield the running coroutine by default
+    local co = coroutine.create(function()
+        return step.decode(s, nil, {
+            slice = 150,
+        })
+    end)
+    local ok, res = coroutine.resume(co)
+    assert.is_true(ok)
+    assert.is_nil(res)
+    ok, res = coroutine.resume(co)
+    assert.is_true(ok)
+    assert.equal(res, string.rep('A', 100))
+    assert.equal(coroutine.status(co), 'dead')
+
+    -- test that does not yield on the main thread
+    assert.equal(step.decode(s, nil, {
+        slice = 1,
+    }), string.rep('A', 100))
+end
+
+function testcase.parse()
+    local query = {}
+    for i = 1, 200 do
+        query[#query + 1] = string.format('k%d=v%%20%d', i % 7, i)
+    end
+    query[#query + 1] = '?q=1&&=x&a&%3Fb=c=d&??e'
+    query = table.concat(query, '&')
+
+    -- test that returns the same results as the url module
+    for _, s in ipairs({
+        'http://user@example.com:8080/p/a/t/h?' .. query .. '#frag',
+        'http://example.com/?' .. query .. ' tail',
+        '/p?' .. query,
+        'http://example.com/',
+        'http://example.com/?',
+        'http://example.com/?&&&',
+    }) do
+        for _, slice in ipairs({
+            1,
+            10,
+            100,
+            64 * 1024,
+        }) do
+            assert.equal({
+                step.parse(s, true, 0, false, false, {
+                    slice = slice,
+                    yield = false,
+                }),
+            }, {
+                url.parse(s, true),
+            })
+            assert.equal({
+                step.parse(s, false, nil, nil, nil, {
+                    slice = slice,
+                }),
+            }, {
+                url.parse(s),
+            })
+        end
+    end
+
+    -- test that parse the query-string
+    for _, s in ipairs({
+        query,
+        '?' .. query,
+        '??a=b&?c=d',
+    }) do
+        assert.equal({
+            step.parse(s, true, 0, true, nil, {
+                slice = 5,
+                yield = false,
+            }),
+        }, {
+            url.parse(s, true, 0, true),
+        })
+    end
+
+    -- test that the query-string is validated in slices, and yield is called
+    -- before the parser scans the whole input
+    local parse_url = url.parse
+    local events = {}
+    url.parse = function(str, parse_params, init, ...)
+        events[#events + 1] = #str - (init or 0)
+        return parse_url(str, parse_params, init, ...)
+    end
+    local s = 'http://example.com/p?' .. query .. '#frag'
+    local ok, res = pcall(step.parse, s, true, 0, false, false, {
+        slice = 100,
+        yield = function()
+            events[#events + 1] = 'yield'
+        end,
+    })
+    url.parse = parse_url
+    assert.is_true(ok)
+    assert.equal(res, url.parse(s, true))
+    local nyield = 0
+    for i, v in ipairs(events) do
+        if v == 'yield' then
+            nyield = nyield + 1
+        elseif i > 1 then
+            -- only the first call parses the url before the query-string
+            assert.less(v, 200)
+        end
+    end
+    assert.equal(events[2], 'yield')
+    assert.greater(nyield, #query / 100 - 1)
+
+    -- test that throws an error if the limits of the query-params are passed
+    local err = assert.throws(step.parse, '?a=b', {
+        max_params = 1,
+    })
+    assert.match(err, 'the limits of the query-params are not supported')
+end
@@ -20,6 +20,38 @@
 -- THE SOFTWARE.
 --
 local codec = require('url.codec')
+local parse = require('url.parse')
+local split_path = require('url.split_path')
+local authority = require('url.authority')
+local parse_target = require('url.parse_target')
+local matcher = require('url.matcher')
+local cache = require('url.cache')
+local cache_key = require('url.cache_key')
+local seen_set = require('url.seen_set')
+local psl_load = require('url.psl')
+local query_edit = require('url.query_edit')
+local buffer = require('url.buffer')
+local builder = require('url.builder')
+local step = require('url.step')
+
+-- the counters are available only if the modules are built with URL_STATS
+local stats = codec.stats or function()
+end
+local stats_reset = codec.stats_reset or function()
+end
+-- the data URL decoder returns the table of the parameters, so that it is
+-- not replaced by the FFI front end
+local decode_data = codec.decode_data
+
+-- use the FFI front end on LuaJIT to keep the hot loops JIT-compiled.
+-- the counters are taken in the C bindings, so that the FFI front end is not
+-- used if URL_STATS is enabled.
+if jit and not codec.stats and pcall(require, 'ffi') then
+    codec = require('url.ffi')
+    parse = codec.parse
+    split_path = codec.split_path
+    authority = codec.authority
+end
 
 return {
     encode_uri = codec.encode_uri,
@@ -29,6 +61,23 @@ return {
     decode_uri = codec.decode_uri,
     decode_form = codec.decode_form,
     decode = codec.decode,
-    parse = require('url.parse'),
+    host_to_ascii = codec.host_to_ascii,
+    host_to_unicode = codec.host_to_unicode,
+    decode_data = decode_data,
+    parse = parse,
+    split_path = split_path,
+    authority = authority,
+    parse_target = parse_target,
+    matcher = matcher,
+    cache = cache,
+    cache_key = cache_key,
+    seen_set = seen_set,
+    psl_load = psl_load,
+    query_edit = query_edit,
+    buffer = buffer,
+    builder = builder,
+    step = step,
+    stats = stats,
+    stats_reset = stats_reset,
 }
 
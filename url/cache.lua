@@ -0,0 +1,197 @@
+--
+-- Copyright (C) 2013 Masatoshi Teruya
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+-- bounded LRU cache of the parse results.
+--
+local error = error
+local format = string.format
+local pairs = pairs
+local setmetatable = setmetatable
+local type = type
+local huge = math.huge
+
+-- default maximum length of the url to be cached
+local DEFAULT_MAXLEN = 2048
+
+--- @class url.cache
+--- @field parse_url function
+--- @field size integer
+--- @field maxlen integer
+--- @field entries table<integer, table<string, table>>
+--- @field head table sentinel node of the doubly linked list
+--- @field nentry integer
+--- @field hits integer
+--- @field misses integer
+--- @field evictions integer
+local Cache = {}
+Cache.__index = Cache
+
+--- unlink the node from the list
+--- @param node table
+local function unlink(node)
+    node.prev.next = node.next
+    node.next.prev = node.prev
+end
+
+--- link the node as the most recently used
+--- @param head table
+--- @param node table
+local function push_front(head, node)
+    node.prev = head
+    node.next = head.next
+    head.next.prev = node
+    head.next = node
+end
+
+--- returns a copy of the parse result so that the caller can modify it
+--- without affecting the cached one
+--- @param res table
+--- @return table
+local function copy_result(res)
+    local t = {}
+    for k, v in pairs(res) do
+        t[k] = v
+    end
+
+    local params = res.query_params
+    if params then
+        local qp = {}
+        for k, vals in pairs(params) do
+            local list = {}
+            for i = 1, #vals do
+                list[i] = vals[i]
+            end
+            qp[k] = list
+        end
+        t.query_params = qp
+    end
+    return t
+end
+
+--- parse the url or returns a copy of the cached result.
+--- @param s string
+--- @param parse_params boolean|table?
+--- @param init integer?
+--- @param is_querystring boolean?
+--- @param ascii_host boolean?
+--- @return table res
+--- @return integer cur
+--- @return string? err
+function Cache:parse(s, parse_params, init, is_querystring, ascii_host)
+    if type(s) ~= 'string' or #s > self.maxlen or (init and init ~= 0) or
+        type(parse_params) == 'table' then
+        -- not cacheable
+        return self.parse_url(s, parse_params, init, is_querystring,
+                              ascii_host)
+    end
+
+    -- the options are part of the key
+    local flag = (parse_params and 1 or 0) + (is_querystring and 2 or 0) +
+                     (ascii_host and 4 or 0)
+    local entries = self.entries[flag]
+    local node = entries[s]
+    local head = self.head
+
+    if node then
+        self.hits = self.hits + 1
+        if head.next ~= node then
+            unlink(node)
+            push_front(head, node)
+        end
+        return copy_result(node.res), node.cur, node.err
+    end
+
+    self.misses = self.misses + 1
+    local res, cur, err = self.parse_url(s, parse_params, init, is_querystring,
+                                         ascii_host)
+    if self.nentry < self.size then
+        self.nentry = self.nentry + 1
+        node = {}
+    else
+        -- reuse the least recently used node
+        node = head.prev
+        unlink(node)
+        self.entries[node.flag][node.key] = nil
+        self.evictions = self.evictions + 1
+    end
+    node.key, node.flag = s, flag
+    node.res, node.cur, node.err = res, cur, err
+    entries[s] = node
+    push_front(head, node)
+
+    return copy_result(res), cur, err
+end
+
+--- returns the number of the cached entries and the counters
+--- @return table stats
+function Cache:stats()
+    return {
+        size = self.size,
+        entries = self.nentry,
+        hits = self.hits,
+        misses = self.misses,
+        evictions = self.evictions,
+    }
+end
+
+--- remove all entries and reset the counters
+function Cache:clear()
+    local head = {}
+    head.prev, head.next = head, head
+    self.head = head
+    self.entries = {}
+    for flag = 0, 7 do
+        self.entries[flag] = {}
+    end
+    self.nentry = 0
+    self.hits = 0
+    self.misses = 0
+    self.evictions = 0
+end
+
+--- create a new cache
+--- @param size integer maximum number of entries
+--- @param maxlen integer? maximum length of the url to be cached
+--- @return url.cache
+local function new(size, maxlen)
+    if type(size) ~= 'number' or size < 1 or size % 1 ~= 0 then
+        error(format('bad argument #1 (positive integer expected, got %s)',
+                     type(size) == 'number' and size or type(size)), 2)
+    end
+    if maxlen == nil then
+        maxlen = DEFAULT_MAXLEN
+    elseif type(maxlen) ~= 'number' or maxlen < 0 or
+        (maxlen % 1 ~= 0 and maxlen ~= huge) then
+        error(format('bad argument #2 (non-negative integer expected, got %s)',
+                     type(maxlen) == 'number' and maxlen or type(maxlen)), 2)
+    end
+
+    local c = setmetatable({
+        -- use the parse function of the url module (FFI on LuaJIT)
+        parse_url = require('url').parse,
+        size = size,
+        maxlen = maxlen,
+    }, Cache)
+    c:clear()
+    return c
+end
+
+return new
@@ -0,0 +1,617 @@
+--
+-- Copyright (C) 2013 Masatoshi Teruya
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+-- LuaJIT FFI front end of url.codec, url.parse, url.split_path and
+-- url.authority.
+-- calls the Lua-free entry points declared in src/url.h so that the calls
+-- do not abort the trace compilation.
+--
+local ffi = require('ffi')
+local bit = require('bit')
+local band = bit.band
+local lshift = bit.lshift
+local cast = ffi.cast
+local new = ffi.new
+local tostr = ffi.string
+local error = error
+local format = string.format
+local sub = string.sub
+local tonumber = tonumber
+local tostring = tostring
+local type = type
+local max = math.max
+local huge = math.huge
+local searchpath = package.searchpath
+
+-- keep in sync with src/url.h
+if not pcall(ffi.typeof, 'url_t') then
+    ffi.cdef([[
+typedef struct {
+    size_t head;
+    size_t len;
+} url_span_t;
+
+typedef struct {
+    uint32_t fields;
+    url_span_t span[10];
+    size_t cur;
+} url_t;
+
+typedef struct {
+    size_t cur;
+    url_span_t key;
+    url_span_t val;
+    int key_encoded;
+    int val_encoded;
+} url_param_t;
+
+typedef struct {
+    size_t cur;
+    url_span_t seg;
+    int encoded;
+} url_segment_t;
+
+size_t url_encode(unsigned char *dst, const char *src, size_t len, int type);
+ssize_t url_decode(unsigned char *dst, const char *src, size_t len, int type,
+                   size_t *epos);
+ssize_t url_host_to_ascii(unsigned char *dst, const char *src, size_t len,
+                          size_t *epos);
+ssize_t url_host_to_unicode(unsigned char *dst, const char *src, size_t len,
+                            size_t *epos);
+int url_parse(url_t *u, const char *url, size_t urllen, size_t cur,
+              int is_querystring);
+int url_parse_authority(url_t *u, const char *url, size_t urllen, size_t cur);
+void url_param_init(url_param_t *p, const char *url, const url_span_t *query);
+int url_param_next(url_param_t *p, const char *url, size_t tail);
+void url_segment_init(url_segment_t *s, const char *url,
+                      const url_span_t *path);
+int url_segment_next(url_segment_t *s, const char *url, size_t tail);
+]])
+end
+
+--- load the shared object of the lua module
+--- @param name string
+--- @return ffi.namespace*
+local function load(name)
+    return ffi.load(assert(searchpath(name, package.cpath),
+                           format('module %q not found', name)))
+end
+
+local CODEC = load('url.codec')
+local PARSER = load('url.parse')
+
+-- url_encode_type_e
+local ENCODE_URI = 0
+local ENCODE_FORM = 1
+local ENCODE_2396 = 2
+local ENCODE_3986 = 3
+local ENCODE_PRESERVE = 0x10
+-- url_decode_type_e
+local DECODE_ALL = 0
+local DECODE_URI = 1
+local DECODE_FORM = 2
+local DECODE_UTF8 = 0x10
+local DECODE_LENIENT = 0x20
+-- url_field_e
+local FIELDS = {
+    'scheme',
+    'userinfo',
+    'user',
+    'password',
+    'host',
+    'hostname',
+    'port',
+    'path',
+    'query',
+    'fragment',
+}
+local NFIELD = #FIELDS
+local FIELD_SCHEME = 0
+local FIELD_HOSTNAME = 5
+local FIELD_PORT = 6
+local FIELD_PATH = 7
+local FIELD_QUERY = 8
+
+-- reusable buffers
+local BUF
+local BUFSIZ = 0
+local EPOS = new('size_t[1]')
+local URL = new('url_t')
+local PARAM = new('url_param_t')
+local SEGMENT = new('url_segment_t')
+local NOPATH = new('url_span_t')
+
+--- getbuf returns the reusable buffer that has at least size bytes
+--- @param size integer
+--- @return ffi.cdata* buf
+local function getbuf(size)
+    if size > BUFSIZ then
+        BUFSIZ = max(size, BUFSIZ * 2, 1024)
+        BUF = new('unsigned char[?]', BUFSIZ)
+    end
+    return BUF
+end
+
+--- argerror throws the bad argument error
+--- @param idx integer
+--- @param tname string
+--- @param v any
+local function argerror(idx, tname, v)
+    error(format('bad argument #%d (%s expected, got %s)', idx, tname, type(v)),
+          3)
+end
+
+--- encode
+--- @param s string
+--- @param enctype integer
+--- @param preserve boolean?
+--- @return string
+local function encode(s, enctype, preserve)
+    if type(s) ~= 'string' then
+        argerror(1, 'string', s)
+    elseif preserve then
+        if type(preserve) ~= 'boolean' then
+            argerror(2, 'boolean', preserve)
+        end
+        enctype = enctype + ENCODE_PRESERVE
+    end
+    local len = #s
+    local buf = getbuf(len * 3)
+    return tostr(buf, CODEC.url_encode(buf, s, len, enctype))
+end
+
+--- decode
+--- @param s string
+--- @param dectype integer
+--- @param strict boolean?
+--- @param lenient boolean?
+--- @return string? s
+--- @return integer? err
+local function decode(s, dectype, strict, lenient)
+    if type(s) ~= 'string' then
+        argerror(1, 'string', s)
+    elseif strict then
+        if type(strict) ~= 'boolean' then
+            argerror(2, 'boolean', strict)
+        end
+        dectype = dectype + DECODE_UTF8
+    end
+    if lenient then
+        if type(lenient) ~= 'boolean' then
+            argerror(3, 'boolean', lenient)
+        end
+        dectype = dectype + DECODE_LENIENT
+    end
+    local len = #s
+    local buf = getbuf(len)
+    local n = CODEC.url_decode(buf, s, len, dectype, EPOS)
+    if n < 0 then
+        return nil, tonumber(EPOS[0]) + 1
+    elseif lenient then
+        -- number of the invalid '%'
+        return tostr(buf, n), tonumber(EPOS[0])
+    end
+    return tostr(buf, n)
+end
+
+--- convert the host name
+--- @param s string
+--- @param to_ascii boolean
+--- @return string? s
+--- @return integer? err
+local function convert_host(s, to_ascii)
+    if type(s) ~= 'string' then
+        argerror(1, 'string', s)
+    end
+    local len = #s
+    local buf, n
+    if to_ascii then
+        buf = getbuf(len * 32)
+        n = CODEC.url_host_to_ascii(buf, s, len, EPOS)
+    else
+        buf = getbuf(len * 4)
+        n = CODEC.url_host_to_unicode(buf, s, len, EPOS)
+    end
+    if n < 0 then
+        return nil, tonumber(EPOS[0]) + 1
+    end
+    return tostr(buf, n)
+end
+
+--- unescape the query parameter
+--- @param s string
+--- @param p ffi.cdata*
+--- @param span ffi.cdata*
+--- @param is_encoded integer
+--- @return string
+local function unescape(s, p, span, is_encoded)
+    local head = tonumber(span.head)
+    local len = tonumber(span.len)
+    if is_encoded == 0 then
+        return sub(s, head + 1, head + len)
+    end
+    local buf = getbuf(len)
+    return tostr(buf, CODEC.url_decode(buf, p + head, len, DECODE_FORM, EPOS))
+end
+
+-- limits of the query-params
+local LIMITS = {
+    'max_params',
+    'max_key_len',
+    'max_value_len',
+    'max_values',
+    'max_bytes',
+}
+
+--- check_limits throws the bad argument error if the limits are invalid
+--- @param limits table
+local function check_limits(limits)
+    for _, name in ipairs(LIMITS) do
+        local v = limits[name]
+        if v ~= nil and
+            (type(v) ~= 'number' or not (v >= 0) or (v < 2 ^ 53 and v % 1 ~= 0)) then
+            error(format(
+                      'bad argument #2 (parse_query.%s must be unsigned integer)',
+                      name), 3)
+        end
+    end
+end
+
+--- decoded_len returns the length of the decoded span without decoding it
+--- @param p ffi.cdata*
+--- @param span ffi.cdata*
+--- @param is_encoded integer
+--- @return integer
+local function decoded_len(p, span, is_encoded)
+    local head = tonumber(span.head)
+    local len = tonumber(span.len)
+    if is_encoded ~= 0 then
+        local i = head
+        local tail = head + len
+        while i < tail do
+            if p[i] == 0x25 then
+                -- "%<HEX>" is decoded to a byte
+                len = len - 2
+                i = i + 3
+            else
+                i = i + 1
+            end
+        end
+    end
+    return len
+end
+
+--- parse_query_params
+--- @param s string
+--- @param query ffi.cdata*
+--- @param limits table?
+--- @return table? params
+--- @return string? exceeded
+--- @return integer? pos
+local function parse_query_params(s, query, limits)
+    local p = cast('const char *', s)
+    local tail = query.head + query.len
+    local params
+    local nparam = 0
+    local nbyte = 0
+    local max_params = huge
+    local max_key_len = huge
+    local max_value_len = huge
+    local max_values = huge
+    local max_bytes = huge
+
+    if limits then
+        max_params = limits.max_params or huge
+        max_key_len = limits.max_key_len or huge
+        max_value_len = limits.max_value_len or huge
+        max_values = limits.max_values or huge
+        max_bytes = limits.max_bytes or huge
+    end
+
+    PARSER.url_param_init(PARAM, s, query)
+    while PARSER.url_param_next(PARAM, s, tail) ~= 0 do
+        if limits then
+            -- check the limits before decoding the pair
+            local klen = decoded_len(p, PARAM.key, PARAM.key_encoded)
+            local vlen = decoded_len(p, PARAM.val, PARAM.val_encoded)
+            local exceeded
+
+            nbyte = nbyte + klen + vlen
+            if nparam >= max_params then
+                exceeded = 'max_params'
+            elseif klen > max_key_len then
+                exceeded = 'max_key_len'
+            elseif vlen > max_value_len then
+                exceeded = 'max_value_len'
+            elseif nbyte > max_bytes then
+                exceeded = 'max_bytes'
+            end
+            if exceeded then
+                return nil, exceeded, tonumber(PARAM.key.head)
+            end
+        end
+
+        local key = unescape(s, p, PARAM.key, PARAM.key_encoded)
+        local vals
+
+        if params then
+            vals = params[key]
+        else
+            params = {}
+        end
+        if vals then
+            local n = #vals
+            if n >= max_values then
+                return nil, 'max_values', tonumber(PARAM.key.head)
+            end
+            vals[n + 1] = unescape(s, p, PARAM.val, PARAM.val_encoded)
+        elseif max_values < 1 then
+            return nil, 'max_values', tonumber(PARAM.key.head)
+        else
+            params[key] = {
+                unescape(s, p, PARAM.val, PARAM.val_encoded),
+            }
+        end
+        nparam = nparam + 1
+    end
+
+    return params
+end
+
+--- parse
+--- @param s string
+--- @param parse_params boolean?
+--- @param init integer?
+--- @param is_querystring boolean?
+--- @param ascii_host boolean?
+--- @return table res
+--- @return integer cur
+--- @return string? err
+local function parse(s, parse_params, init, is_querystring, ascii_host)
+    local t = type(s)
+    if t == 'number' then
+        s = tostring(s)
+    elseif t ~= 'string' then
+        argerror(1, 'string', s)
+    end
+    local limits
+    if type(parse_params) == 'table' then
+        check_limits(parse_params)
+        limits = parse_params
+    elseif parse_params ~= nil and type(parse_params) ~= 'boolean' then
+        argerror(2, 'boolean', parse_params)
+    end
+    if init == nil then
+        init = 0
+    elseif type(init) ~= 'number' or init < 0 or init % 1 ~= 0 then
+        argerror(3, 'uint64_t', init)
+    end
+    if is_querystring ~= nil and type(is_querystring) ~= 'boolean' then
+        argerror(4, 'boolean', is_querystring)
+    end
+    if ascii_host ~= nil and type(ascii_host) ~= 'boolean' then
+        argerror(5, 'boolean', ascii_host)
+    end
+
+    local res = {}
+    local len = #s
+    local rv = PARSER.url_parse(URL, s, len, init, is_querystring and 1 or 0)
+    local fields = URL.fields
+    local cur = tonumber(URL.cur)
+
+    if fields ~= 0 then
+        for i = 0, NFIELD - 1 do
+            if band(fields, lshift(1, i)) ~= 0 then
+                local span = URL.span[i]
+                local head = tonumber(span.head)
+                res[FIELDS[i + 1]] = sub(s, head + 1, head + tonumber(span.len))
+            end
+        end
+        if ascii_host and band(fields, lshift(1, FIELD_HOSTNAME)) ~= 0 then
+            local span = URL.span[FIELD_HOSTNAME]
+            local head = tonumber(span.head)
+            local len = tonumber(span.len)
+            local buf = getbuf(len * 32)
+            local n = CODEC.url_host_to_ascii(buf,
+                                              cast('const char *', s) + head,
+                                              len, EPOS)
+            if n >= 0 then
+                res.hostname = tostr(buf, n)
+            elseif rv == 0 then
+                -- invalid label of the hostname
+                rv = 1
+                cur = head + tonumber(EPOS[0])
+            end
+        end
+        if parse_params and band(fields, lshift(1, FIELD_QUERY)) ~= 0 then
+            local params, exceeded, pos =
+                parse_query_params(s, URL.span[FIELD_QUERY], limits)
+            if exceeded then
+                -- the query-params exceeded the limit
+                return res, pos, exceeded
+            end
+            res.query_params = params
+        end
+    end
+
+    if rv ~= 0 then
+        -- illegal byte sequence
+        if cur < len then
+            return res, cur, sub(s, cur + 1, cur + 1)
+        end
+        return res, cur, '\0'
+    end
+    return res, cur
+end
+
+--- field returns the field of the last parsed url, or nil if not found
+--- @param s string
+--- @param i integer
+--- @return string?
+local function field(s, i)
+    if band(URL.fields, lshift(1, i)) ~= 0 then
+        local head = tonumber(URL.span[i].head)
+        return sub(s, head + 1, head + tonumber(URL.span[i].len))
+    end
+end
+
+--- authority
+--- @param s string
+--- @param init integer?
+--- @return string? scheme
+--- @return string? hostname
+--- @return integer? port
+--- @return integer? err
+local function authority(s, init)
+    if type(s) ~= 'string' then
+        argerror(1, 'string', s)
+    end
+    local len = #s
+    if init == nil then
+        init = 0
+    elseif type(init) ~= 'number' or init < 0 or init % 1 ~= 0 then
+        argerror(2, 'uint64_t', init)
+    elseif init > len then
+        init = len
+    end
+
+    if PARSER.url_parse_authority(URL, s, len, init) ~= 0 then
+        -- illegal byte sequence
+        return nil, nil, nil, tonumber(URL.cur) + 1
+    end
+
+    local port = field(s, FIELD_PORT)
+    return field(s, FIELD_SCHEME), field(s, FIELD_HOSTNAME),
+           port and tonumber(port)
+end
+
+--- split_path
+--- @param s string
+--- @param decode_segs boolean?
+--- @param normalize boolean?
+--- @param segs table?
+--- @return table? segs
+--- @return integer? err
+local function split_path(s, decode_segs, normalize, segs)
+    if type(s) ~= 'string' then
+        argerror(1, 'string', s)
+    end
+    if decode_segs ~= nil and type(decode_segs) ~= 'boolean' then
+        argerror(2, 'boolean', decode_segs)
+    end
+    if normalize ~= nil and type(normalize) ~= 'boolean' then
+        argerror(3, 'boolean', normalize)
+    end
+    if segs == nil then
+        segs = {}
+    elseif type(segs) ~= 'table' then
+        argerror(4, 'table', segs)
+    end
+
+    if PARSER.url_parse(URL, s, #s, 0, 0) ~= 0 then
+        -- illegal byte sequence
+        return nil, tonumber(URL.cur) + 1
+    end
+
+    local path = NOPATH
+    if band(URL.fields, lshift(1, FIELD_PATH)) ~= 0 then
+        path = URL.span[FIELD_PATH]
+    end
+    local tail = path.head + path.len
+    local p = cast('const char *', s)
+    local last = #segs
+    local n = 0
+
+    PARSER.url_segment_init(SEGMENT, s, path)
+    while PARSER.url_segment_next(SEGMENT, s, tail) ~= 0 do
+        local head = tonumber(SEGMENT.seg.head)
+        local len = tonumber(SEGMENT.seg.len)
+        local seg
+
+        -- decode only the segments that contain the '%' character
+        if decode_segs and SEGMENT.encoded ~= 0 then
+            local buf = getbuf(len)
+            local rv = CODEC.url_decode(buf, p + head, len, DECODE_ALL, EPOS)
+            if rv < 0 then
+                -- invalid percent-encoded sequence
+                return nil, head + tonumber(EPOS[0]) + 1
+            end
+            seg = tostr(buf, rv)
+        else
+            seg = sub(s, head + 1, head + len)
+        end
+
+        if not normalize or (seg ~= '' and seg ~= '.') then
+            if normalize and seg == '..' then
+                -- ".." removes the previous segment
+                if n > 0 then
+                    n = n - 1
+                end
+            else
+                n = n + 1
+                segs[n] = seg
+                if n > last then
+                    last = n
+                end
+            end
+        end
+    end
+
+    -- remove the rest of the items
+    for i = last, n + 1, -1 do
+        segs[i] = nil
+    end
+
+    return segs
+end
+
+return {
+    encode_uri = function(s, preserve)
+        return encode(s, ENCODE_URI, preserve)
+    end,
+    encode_form = function(s, preserve)
+        return encode(s, ENCODE_FORM, preserve)
+    end,
+    encode2396 = function(s, preserve)
+        return encode(s, ENCODE_2396, preserve)
+    end,
+    encode3986 = function(s, preserve)
+        return encode(s, ENCODE_3986, preserve)
+    end,
+    decode_uri = function(s, strict, lenient)
+        return decode(s, DECODE_URI, strict, lenient)
+    end,
+    decode_form = function(s, strict, lenient)
+        return decode(s, DECODE_FORM, strict, lenient)
+    end,
+    decode = function(s, strict, lenient)
+        return decode(s, DECODE_ALL, strict, lenient)
+    end,
+    host_to_ascii = function(s)
+        return convert_host(s, true)
+    end,
+    host_to_unicode = function(s)
+        return convert_host(s, false)
+    end,
+    parse = parse,
+    split_path = split_path,
+    authority = authority,
+}
@@ -0,0 +1,282 @@
+--
+-- Copyright (C) 2013 Masatoshi Teruya
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+--
+-- step-wise variants of the codec and the parser for very large inputs.
+-- the input is processed in slices of a bounded number of bytes, and the
+-- yield function is called between the slices so that the scheduler can run
+-- other tasks. the results are the same as the functions of the url module.
+--
+local buffer = require('url.buffer')
+local error = error
+local find = string.find
+local format = string.format
+local pairs = pairs
+local sub = string.sub
+local type = type
+local running = coroutine.running
+local yield = coroutine.yield
+
+-- default number of bytes per slice
+local DEFAULT_SLICE = 64 * 1024
+
+--- yield the running coroutine if it is not the main thread
+local function default_yield()
+    local co, ismain = running()
+    if co and not ismain then
+        yield()
+    end
+end
+
+local function noop()
+end
+
+--- check the options
+--- @param opts table?
+--- @param idx integer argument index of the options
+--- @return integer slice
+--- @return function yield
+local function checkopts(opts, idx)
+    if opts == nil then
+        return DEFAULT_SLICE, default_yield
+    elseif type(opts) ~= 'table' then
+        error(format('bad argument #%d (table expected, got %s)', idx,
+                     type(opts)), 3)
+    end
+
+    local slice = opts.slice
+    if slice == nil then
+        slice = DEFAULT_SLICE
+    elseif type(slice) ~= 'number' or slice < 1 or slice % 1 ~= 0 then
+        error(format('bad argument #%d (opts.slice must be positive integer)',
+                     idx), 3)
+    end
+
+    local fn = opts.yield
+    if fn == nil then
+        fn = default_yield
+    elseif fn == false then
+        fn = noop
+    elseif type(fn) ~= 'function' then
+        error(format('bad argument #%d (opts.yield must be function or false)',
+                     idx), 3)
+    end
+
+    return slice, fn
+end
+
+--- encode or decode s in slices
+--- @param op string name of the codec function
+--- @param s string
+--- @param strict boolean?
+--- @param opts table?
+--- @param idx integer argument index of the options
+--- @return string? s
+--- @return integer? err
+local function codec(op, s, strict, opts, idx)
+    if type(s) ~= 'string' then
+        error(format('bad argument #1 (string expected, got %s)', type(s)), 3)
+    end
+    local slice, fn = checkopts(opts, idx)
+    local b = buffer()
+    local len = #s
+    local cur = 0
+
+    while true do
+        local err
+        cur, err = b:step(op, s, cur, slice, strict)
+        if not cur then
+            return nil, err
+        elseif cur >= len then
+            return b:tostring()
+        end
+        fn()
+    end
+end
+
+--- merge the query-params of the slice into params
+--- @param params table?
+--- @param t table?
+--- @return table? params
+local function merge_params(params, t)
+    if not params then
+        return t
+    elseif t then
+        for k, vals in pairs(t) do
+            local list = params[k]
+            if list then
+                for i = 1, #vals do
+                    list[#list + 1] = vals[i]
+                end
+            else
+                params[k] = vals
+            end
+        end
+    end
+    return params
+end
+
+--- validate the query-string from the head position in slices that are split
+--- at the "&" characters, and parse the query-params of each slice in the
+--- same pass.
+--- @param parse_url function
+--- @param s string
+--- @param head integer 1-based position of the query-string
+--- @param parse_params boolean?
+--- @param slice integer
+--- @param fn function
+--- @return integer? tail 1-based end position of the query-string
+--- @return boolean has_query
+--- @return table? params
+--- @return string? err
+local function parse_query(parse_url, s, head, parse_params, slice, fn)
+    local len = #s
+    local qhead = head
+    local has_query = false
+    local params
+
+    while head <= len do
+        local tail = len
+        if head + slice - 1 < len then
+            -- a key-value pair must not be split
+            tail = (find(s, '&', head + slice - 1, true) or len + 1) - 1
+        end
+
+        local str = sub(s, head, tail)
+        local offset = head - 1
+        if head > qhead and sub(str, 1, 1) == '?' then
+            -- keep the leading "?" of the key
+            str = '&' .. str
+            offset = offset - 1
+        end
+        local res, cur, err = parse_url(str, parse_params, 0, true)
+        has_query = has_query or res.query ~= nil
+        params = merge_params(params, res.query_params)
+        if res.fragment or err then
+            local pos = find(str, '#', 1, true)
+            if pos and (not err or pos <= cur) then
+                -- the query-string ends at the "#"
+                return offset + pos - 1, has_query, params
+            end
+            -- the query-string ends at the illegal byte
+            return offset + cur, has_query, params, err
+        end
+
+        head = tail + 2
+        if head <= len then
+            fn()
+        end
+    end
+
+    return len, has_query, params
+end
+
+--- parse the url, and validate and parse the query-string in slices
+--- @param s string
+--- @param parse_params boolean?
+--- @param init integer?
+--- @param is_querystring boolean?
+--- @param ascii_host boolean?
+--- @param opts table?
+--- @return table res
+--- @return integer cur
+--- @return string? err
+local function parse(s, parse_params, init, is_querystring, ascii_host, opts)
+    local slice, fn = checkopts(opts, 6)
+    if type(parse_params) == 'table' then
+        -- the limits are counted over the whole query-string
+        error('bad argument #2 (the limits of the query-params are not ' ..
+                  'supported)', 2)
+    end
+    -- use the parse function of the url module (FFI on LuaJIT)
+    local parse_url = require('url').parse
+    init = init or 0
+    if type(s) ~= 'string' or type(init) ~= 'number' or init < 0 or init >
+        #s or init % 1 ~= 0 then
+        -- let the parse function handle the arguments
+        return parse_url(s, parse_params, init, is_querystring, ascii_host)
+    end
+
+    local res = {}
+    local qhead = init + 1
+    if not is_querystring then
+        qhead = find(s, '?', init + 1, true)
+        if not qhead then
+            -- no query-string
+            return parse_url(s, parse_params, init, false, ascii_host)
+        end
+
+        -- parse the url before the query-string
+        local cur, err
+        res, cur, err = parse_url(sub(s, 1, qhead - 1), false, init, false,
+                                  ascii_host)
+        if err then
+            -- the byte at the end of the substring is the "?"
+            return res, cur, sub(s, cur + 1, cur + 1)
+        elseif res.fragment then
+            -- the "?" is a part of the fragment
+            return parse_url(s, parse_params, init, false, ascii_host)
+        end
+        fn()
+    end
+
+    local tail, has_query, params, err = parse_query(parse_url, s, qhead,
+                                                     parse_params, slice, fn)
+    if has_query then
+        res.query = sub(s, qhead, tail)
+        if parse_params then
+            res.query_params = params
+        end
+    end
+    if err or tail == #s then
+        return res, tail, err
+    end
+
+    -- the fragment is parsed at once
+    local frag, cur
+    frag, cur, err = parse_url(s, false, tail, true)
+    res.fragment = frag.fragment
+    return res, cur, err
+end
+
+return {
+    encode_uri = function(s, opts)
+        return codec('encode_uri', s, nil, opts, 2)
+    end,
+    encode_form = function(s, opts)
+        return codec('encode_form', s, nil, opts, 2)
+    end,
+    encode2396 = function(s, opts)
+        return codec('encode2396', s, nil, opts, 2)
+    end,
+    encode3986 = function(s, opts)
+        return codec('encode3986', s, nil, opts, 2)
+    end,
+    decode_uri = function(s, strict, opts)
+        return codec('decode_uri', s, strict, opts, 3)
+    end,
+    decode_form = function(s, strict, opts)
+        return codec('decode_form', s, strict, opts, 3)
+    end,
+    decode = function(s, strict, opts)
+        return codec('decode', s, strict, opts, 3)
+    end,
+    parse = parse,
+}